@@ -558,8 +558,8 @@ template<typename data_source_t>
 bool mk::bag::parse_records(data_source_t& data_source, callback_t const callback, void* const callback_ctx)
 {
 	assert(callback);
-	std::uint64_t const end_position = data_source.get_input_size();
-	while(data_source.get_input_position() != end_position)
+	// Size of piped input is known only once its end is reached, ask every time.
+	while(data_source.get_input_position() != data_source.get_input_size())
 	{
 		record_t record;
 		bool const record_parsed = detail::parse_record(data_source, &record);
@@ -675,14 +675,83 @@ bool mk::bag::parse_connection_data(field_t const* const& fields, int const& fie
 	return true;
 }
 
+bool mk::bag::parse_index_data_data(record_t const& record, std::uint32_t const& idx, data::index_data_ver_1_t* const& out_index_data_data)
+{
+	static constexpr std::uint64_t const s_entry_len = sizeof(std::uint64_t) + sizeof(std::uint32_t);
+
+	assert(std::visit(make_overload([](header::index_data_t const&) -> bool { return true; }, [](...) -> bool { return false; }), record.m_header));
+	assert(out_index_data_data);
+	header::index_data_t const& header = std::get<header::index_data_t>(record.m_header);
+	data::index_data_ver_1_t& index_data_data = *out_index_data_data;
+
+	CHECK_RET_F(header.m_ver == 1);
+	CHECK_RET_F(idx < header.m_count);
+	std::uint64_t const len = static_cast<std::uint64_t>(record.m_data.m_len);
+	CHECK_RET_F(len == header.m_count * s_entry_len);
+
+	std::uint64_t pos = idx * s_entry_len;
+	index_data_data.m_time = detail::read<std::uint64_t>(record.m_data.m_begin, len, pos);
+	index_data_data.m_offset = detail::read<std::uint32_t>(record.m_data.m_begin, len, pos);
+
+	return true;
+}
+
+bool mk::bag::parse_chunk_info_data(record_t const& record, std::uint32_t const& idx, data::chunk_info_ver_1_t* const& out_chunk_info_data)
+{
+	static constexpr std::uint64_t const s_entry_len = sizeof(std::uint32_t) + sizeof(std::uint32_t);
+
+	assert(std::visit(make_overload([](header::chunk_info_t const&) -> bool { return true; }, [](...) -> bool { return false; }), record.m_header));
+	assert(out_chunk_info_data);
+	header::chunk_info_t const& header = std::get<header::chunk_info_t>(record.m_header);
+	data::chunk_info_ver_1_t& chunk_info_data = *out_chunk_info_data;
+
+	CHECK_RET_F(header.m_ver == 1);
+	CHECK_RET_F(idx < header.m_count);
+	std::uint64_t const len = static_cast<std::uint64_t>(record.m_data.m_len);
+	CHECK_RET_F(len == header.m_count * s_entry_len);
 
+	std::uint64_t pos = idx * s_entry_len;
+	chunk_info_data.m_conn = detail::read<std::uint32_t>(record.m_data.m_begin, len, pos);
+	chunk_info_data.m_count = detail::read<std::uint32_t>(record.m_data.m_begin, len, pos);
+
+	return true;
+}
+
+std::uint64_t mk::bag::get_time_ns(std::uint64_t const& time)
+{
+	// Stored as seconds followed by nanoseconds, the raw 64 bit value does not order by time.
+	std::uint64_t const sec = time & 0xFFFFFFFFull;
+	std::uint64_t const nsec = time >> 32;
+	return sec * 1'000'000'000ull + nsec;
+}
+
+
+#include "data_source_direct.h"
 #include "data_source_mem.h"
+#include "data_source_pipe.h"
 #include "data_source_rommf.h"
+#ifndef _MSC_VER
+	#include "data_source_uring.h"
+#endif
 
 template bool mk::bag::is_bag_file<mk::data_source_mem_t>(mk::data_source_mem_t&);
 template bool mk::bag::parse_records<mk::data_source_mem_t>(mk::data_source_mem_t& data_source, callback_t const callback, void* const callback_ctx);
 template bool mk::bag::parse_fields<mk::data_source_mem_t>(mk::data_source_mem_t& data_source, callback_t const callback, void* const callback_ctx);
 
+template bool mk::bag::is_bag_file<mk::data_source_pipe_t>(mk::data_source_pipe_t&);
+template bool mk::bag::parse_records<mk::data_source_pipe_t>(mk::data_source_pipe_t& data_source, callback_t const callback, void* const callback_ctx);
+template bool mk::bag::parse_fields<mk::data_source_pipe_t>(mk::data_source_pipe_t& data_source, callback_t const callback, void* const callback_ctx);
+
 template bool mk::bag::is_bag_file<mk::data_source_rommf_t>(mk::data_source_rommf_t&);
 template bool mk::bag::parse_records<mk::data_source_rommf_t>(mk::data_source_rommf_t& data_source, callback_t const callback, void* const callback_ctx);
 template bool mk::bag::parse_fields<mk::data_source_rommf_t>(mk::data_source_rommf_t& data_source, callback_t const callback, void* const callback_ctx);
+
+template bool mk::bag::is_bag_file<mk::data_source_direct_t>(mk::data_source_direct_t&);
+template bool mk::bag::parse_records<mk::data_source_direct_t>(mk::data_source_direct_t& data_source, callback_t const callback, void* const callback_ctx);
+template bool mk::bag::parse_fields<mk::data_source_direct_t>(mk::data_source_direct_t& data_source, callback_t const callback, void* const callback_ctx);
+
+#ifndef _MSC_VER
+template bool mk::bag::is_bag_file<mk::data_source_uring_t>(mk::data_source_uring_t&);
+template bool mk::bag::parse_records<mk::data_source_uring_t>(mk::data_source_uring_t& data_source, callback_t const callback, void* const callback_ctx);
+template bool mk::bag::parse_fields<mk::data_source_uring_t>(mk::data_source_uring_t& data_source, callback_t const callback, void* const callback_ctx);
+#endif
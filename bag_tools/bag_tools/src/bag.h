@@ -147,6 +147,9 @@ namespace mk
 		template<typename data_source_t>
 		bool parse_fields(data_source_t& data_source, callback_t const callback, void* const callback_ctx);
 		bool parse_connection_data(field_t const* const& fields, int const& fields_count, data::connection_data_t* const& out_connection_data);
+		bool parse_index_data_data(record_t const& record, std::uint32_t const& idx, data::index_data_ver_1_t* const& out_index_data_data);
+		bool parse_chunk_info_data(record_t const& record, std::uint32_t const& idx, data::chunk_info_ver_1_t* const& out_chunk_info_data);
+		std::uint64_t get_time_ns(std::uint64_t const& time);
 
 
 	}
@@ -0,0 +1,331 @@
+#include "bag_index.h"
+
+#include "utils.h"
+
+#include <algorithm> // std::sort
+#include <cassert>
+#include <cstring> // std::memcmp
+#include <utility> // std::swap
+
+
+namespace mk
+{
+	namespace detail
+	{
+
+
+		struct bag_index_row_t
+		{
+			std::uint64_t m_time;
+			std::uint32_t m_chunk;
+			std::uint32_t m_offset;
+			std::uint32_t m_connection;
+		};
+
+
+		template<typename key_t>
+		std::uint64_t bag_index_lower_bound(std::uint64_t const count, std::uint64_t const value, key_t const& key);
+
+
+	}
+}
+
+
+template<typename key_t>
+std::uint64_t mk::detail::bag_index_lower_bound(std::uint64_t const count, std::uint64_t const value, key_t const& key)
+{
+	// Halves the range without a data dependent branch, the compare turns into a conditional move.
+	// Lookups at random times would otherwise mispredict on every step.
+	if(count == 0)
+	{
+		return 0;
+	}
+	std::uint64_t base = 0;
+	std::uint64_t len = count;
+	while(len > 1)
+	{
+		std::uint64_t const half = len / 2;
+		base += key(base + half - 1) < value ? half : 0;
+		len -= half;
+	}
+	return base + (key(base) < value ? 1 : 0);
+}
+
+
+mk::bag_index_t::bag_index_t() noexcept :
+	m_valid(),
+	m_times(),
+	m_connections(),
+	m_chunks(),
+	m_offsets(),
+	m_connection_ids(),
+	m_connection_topics(),
+	m_chunk_positions(),
+	m_topics(),
+	m_topic_rows(),
+	m_strings()
+{
+}
+
+mk::bag_index_t mk::bag_index_t::make(mk::bag_index_file_t const& index_file)
+{
+	bag_index_t index;
+	CHECK_RET(index_file, index);
+
+	std::uint32_t const connections_count = index_file.get_connections_count();
+	std::uint32_t const chunks_count = index_file.get_chunks_count();
+	std::uint64_t const messages_count = index_file.get_messages_count();
+
+	// Connections sharing one topic (several publishers) make one topic.
+	index.m_connection_ids.resize(connections_count);
+	index.m_connection_topics.resize(connections_count);
+	for(std::uint32_t i = 0; i != connections_count; ++i)
+	{
+		index.m_connection_ids[i] = index_file.get_connection(i).m_conn;
+		mk::bag::string_t const topic = index_file.get_topic(i);
+		std::uint32_t topic_idx;
+		bool const found = index.find_topic(topic, &topic_idx);
+		if(!found)
+		{
+			topic_idx = static_cast<std::uint32_t>(index.m_topics.size());
+			index.m_topics.push_back(topic_t{index.m_strings.size(), static_cast<std::uint32_t>(topic.m_len), 0, 0});
+			index.m_strings.insert(index.m_strings.end(), topic.m_begin, topic.m_begin + topic.m_len);
+		}
+		index.m_connection_topics[i] = topic_idx;
+	}
+
+	index.m_chunk_positions.resize(chunks_count);
+	for(std::uint32_t i = 0; i != chunks_count; ++i)
+	{
+		index.m_chunk_positions[i] = index_file.get_chunk(i).m_chunk_pos;
+	}
+
+	// Sidecar has messages grouped by connection, order them by time once and split them into columns.
+	std::uint64_t const* const message_times = index_file.get_message_times();
+	std::uint32_t const* const message_chunks = index_file.get_message_chunks();
+	std::uint32_t const* const message_offsets = index_file.get_message_offsets();
+	std::vector<detail::bag_index_row_t> rows;
+	rows.reserve(static_cast<std::size_t>(messages_count));
+	for(std::uint32_t i = 0; i != connections_count; ++i)
+	{
+		mk::bag_index_file_connection_t const& connection = index_file.get_connection(i);
+		for(std::uint64_t j = 0; j != connection.m_messages_count; ++j)
+		{
+			std::uint64_t const message_idx = connection.m_first_message + j;
+			CHECK_RET(message_chunks[message_idx] < chunks_count, bag_index_t{});
+			rows.push_back(detail::bag_index_row_t{mk::bag::get_time_ns(message_times[message_idx]), message_chunks[message_idx], message_offsets[message_idx], i});
+		}
+	}
+	// Equal times keep the order in which the messages are stored in the bag.
+	std::sort(rows.begin(), rows.end(), [](detail::bag_index_row_t const& a, detail::bag_index_row_t const& b) -> bool
+	{
+		if(a.m_time != b.m_time)
+		{
+			return a.m_time < b.m_time;
+		}
+		if(a.m_chunk != b.m_chunk)
+		{
+			return a.m_chunk < b.m_chunk;
+		}
+		return a.m_offset < b.m_offset;
+	});
+
+	index.m_times.resize(rows.size());
+	index.m_connections.resize(rows.size());
+	index.m_chunks.resize(rows.size());
+	index.m_offsets.resize(rows.size());
+	for(std::size_t i = 0; i != rows.size(); ++i)
+	{
+		index.m_times[i] = rows[i].m_time;
+		index.m_connections[i] = rows[i].m_connection;
+		index.m_chunks[i] = rows[i].m_chunk;
+		index.m_offsets[i] = rows[i].m_offset;
+	}
+
+	for(std::uint32_t const connection_idx : index.m_connections)
+	{
+		++index.m_topics[index.m_connection_topics[connection_idx]].m_rows_count;
+	}
+	std::uint64_t first_row = 0;
+	for(topic_t& topic : index.m_topics)
+	{
+		topic.m_first_row = first_row;
+		first_row += topic.m_rows_count;
+		topic.m_rows_count = 0;
+	}
+	index.m_topic_rows.resize(rows.size());
+	for(std::uint64_t i = 0; i != rows.size(); ++i)
+	{
+		topic_t& topic = index.m_topics[index.m_connection_topics[index.m_connections[i]]];
+		index.m_topic_rows[topic.m_first_row + topic.m_rows_count] = i;
+		++topic.m_rows_count;
+	}
+
+	index.m_valid = true;
+	return index;
+}
+
+mk::bag_index_t mk::bag_index_t::open(native_char_t const* const bag_path)
+{
+	mk::bag_index_file_t const index_file = mk::bag_index_file_t::open(bag_path);
+	CHECK_RET(index_file, bag_index_t{});
+	return make(index_file);
+}
+
+mk::bag_index_t::bag_index_t(bag_index_t&& other) noexcept :
+	bag_index_t()
+{
+	swap(other);
+}
+
+mk::bag_index_t& mk::bag_index_t::operator=(bag_index_t&& other) noexcept
+{
+	swap(other);
+	return *this;
+}
+
+mk::bag_index_t::~bag_index_t() noexcept
+{
+}
+
+void mk::bag_index_t::swap(bag_index_t& other) noexcept
+{
+	using std::swap;
+	swap(m_valid, other.m_valid);
+	swap(m_times, other.m_times);
+	swap(m_connections, other.m_connections);
+	swap(m_chunks, other.m_chunks);
+	swap(m_offsets, other.m_offsets);
+	swap(m_connection_ids, other.m_connection_ids);
+	swap(m_connection_topics, other.m_connection_topics);
+	swap(m_chunk_positions, other.m_chunk_positions);
+	swap(m_topics, other.m_topics);
+	swap(m_topic_rows, other.m_topic_rows);
+	swap(m_strings, other.m_strings);
+}
+
+mk::bag_index_t::operator bool() const
+{
+	return m_valid;
+}
+
+void mk::bag_index_t::reset()
+{
+	*this = bag_index_t{};
+}
+
+
+std::uint64_t mk::bag_index_t::get_messages_count() const
+{
+	return m_times.size();
+}
+
+std::uint64_t const* mk::bag_index_t::get_times() const
+{
+	return m_times.data();
+}
+
+std::uint32_t const* mk::bag_index_t::get_connections() const
+{
+	return m_connections.data();
+}
+
+std::uint32_t const* mk::bag_index_t::get_chunks() const
+{
+	return m_chunks.data();
+}
+
+std::uint32_t const* mk::bag_index_t::get_offsets() const
+{
+	return m_offsets.data();
+}
+
+std::uint32_t mk::bag_index_t::get_connections_count() const
+{
+	return static_cast<std::uint32_t>(m_connection_ids.size());
+}
+
+std::uint32_t mk::bag_index_t::get_connection_id(std::uint32_t const connection_idx) const
+{
+	assert(connection_idx < m_connection_ids.size());
+	return m_connection_ids[connection_idx];
+}
+
+std::uint32_t mk::bag_index_t::get_connection_topic(std::uint32_t const connection_idx) const
+{
+	assert(connection_idx < m_connection_topics.size());
+	return m_connection_topics[connection_idx];
+}
+
+std::uint32_t mk::bag_index_t::get_chunks_count() const
+{
+	return static_cast<std::uint32_t>(m_chunk_positions.size());
+}
+
+std::uint64_t mk::bag_index_t::get_chunk_pos(std::uint32_t const chunk_idx) const
+{
+	assert(chunk_idx < m_chunk_positions.size());
+	return m_chunk_positions[chunk_idx];
+}
+
+std::uint32_t mk::bag_index_t::get_topics_count() const
+{
+	return static_cast<std::uint32_t>(m_topics.size());
+}
+
+mk::bag::string_t mk::bag_index_t::get_topic_name(std::uint32_t const topic_idx) const
+{
+	assert(topic_idx < m_topics.size());
+	topic_t const& topic = m_topics[topic_idx];
+	return mk::bag::string_t{m_strings.data() + topic.m_name_offset, static_cast<int>(topic.m_name_len)};
+}
+
+std::uint64_t mk::bag_index_t::get_topic_messages_count(std::uint32_t const topic_idx) const
+{
+	assert(topic_idx < m_topics.size());
+	return m_topics[topic_idx].m_rows_count;
+}
+
+
+std::uint64_t mk::bag_index_t::seek_time(std::uint64_t const time_ns) const
+{
+	std::uint64_t const* const times = m_times.data();
+	return detail::bag_index_lower_bound(m_times.size(), time_ns, [&](std::uint64_t const row){ return times[row]; });
+}
+
+bool mk::bag_index_t::find_topic(mk::bag::string_t const& topic, std::uint32_t* const out_topic_idx) const
+{
+	assert(out_topic_idx);
+	std::uint32_t& topic_idx = *out_topic_idx;
+
+	for(std::uint32_t i = 0; i != m_topics.size(); ++i)
+	{
+		mk::bag::string_t const name = get_topic_name(i);
+		if(name.m_len == topic.m_len && std::memcmp(name.m_begin, topic.m_begin, topic.m_len) == 0)
+		{
+			topic_idx = i;
+			return true;
+		}
+	}
+	return false;
+}
+
+std::uint64_t mk::bag_index_t::seek_topic_message(std::uint32_t const topic_idx, std::uint64_t const message_idx) const
+{
+	assert(topic_idx < m_topics.size());
+	topic_t const& topic = m_topics[topic_idx];
+	if(message_idx >= topic.m_rows_count)
+	{
+		return get_messages_count();
+	}
+	return m_topic_rows[topic.m_first_row + message_idx];
+}
+
+std::uint64_t mk::bag_index_t::seek_topic_time(std::uint32_t const topic_idx, std::uint64_t const time_ns) const
+{
+	assert(topic_idx < m_topics.size());
+	topic_t const& topic = m_topics[topic_idx];
+	std::uint64_t const* const times = m_times.data();
+	std::uint64_t const* const rows = m_topic_rows.data() + topic.m_first_row;
+	return detail::bag_index_lower_bound(topic.m_rows_count, time_ns, [&](std::uint64_t const idx){ return times[rows[idx]]; });
+}
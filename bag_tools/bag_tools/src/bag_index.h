@@ -0,0 +1,76 @@
+#pragma once
+
+
+#include "bag.h"
+#include "bag_index_file.h"
+#include "cross_platform.h"
+
+#include <cstdint>
+#include <vector>
+
+
+namespace mk
+{
+
+
+	// Every message of the bag as one row of plain columns, rows ordered by time.
+	// Answers "where is the message at time T" or "where is the Nth message of topic X" without touching the bag.
+	class bag_index_t
+	{
+	private:
+		struct topic_t
+		{
+			std::uint64_t m_name_offset; // into m_strings
+			std::uint32_t m_name_len;
+			std::uint64_t m_first_row; // into m_topic_rows
+			std::uint64_t m_rows_count;
+		};
+	public:
+		bag_index_t() noexcept;
+		static bag_index_t make(mk::bag_index_file_t const& index_file);
+		static bag_index_t open(native_char_t const* const bag_path);
+		bag_index_t(bag_index_t const&) = delete;
+		bag_index_t(bag_index_t&& other) noexcept;
+		bag_index_t& operator=(bag_index_t const&) = delete;
+		bag_index_t& operator=(bag_index_t&& other) noexcept;
+		~bag_index_t() noexcept;
+		void swap(bag_index_t& other) noexcept;
+		explicit operator bool() const;
+		void reset();
+	public:
+		std::uint64_t get_messages_count() const;
+		std::uint64_t const* get_times() const; // nanoseconds, ascending
+		std::uint32_t const* get_connections() const; // connection index, not the ID
+		std::uint32_t const* get_chunks() const; // chunk number, chunks are numbered in order of the file
+		std::uint32_t const* get_offsets() const; // of the message data record inside of uncompressed chunk
+		std::uint32_t get_connections_count() const;
+		std::uint32_t get_connection_id(std::uint32_t const connection_idx) const;
+		std::uint32_t get_connection_topic(std::uint32_t const connection_idx) const;
+		std::uint32_t get_chunks_count() const;
+		std::uint64_t get_chunk_pos(std::uint32_t const chunk_idx) const;
+		std::uint32_t get_topics_count() const;
+		mk::bag::string_t get_topic_name(std::uint32_t const topic_idx) const;
+		std::uint64_t get_topic_messages_count(std::uint32_t const topic_idx) const;
+	public:
+		std::uint64_t seek_time(std::uint64_t const time_ns) const; // first row at or after the time, messages count when there is none
+		bool find_topic(mk::bag::string_t const& topic, std::uint32_t* const out_topic_idx) const;
+		std::uint64_t seek_topic_message(std::uint32_t const topic_idx, std::uint64_t const message_idx) const; // row of Nth message of the topic, messages count when there is none
+		std::uint64_t seek_topic_time(std::uint32_t const topic_idx, std::uint64_t const time_ns) const; // N of first message of the topic at or after the time
+	private:
+		bool m_valid;
+		std::vector<std::uint64_t> m_times;
+		std::vector<std::uint32_t> m_connections;
+		std::vector<std::uint32_t> m_chunks;
+		std::vector<std::uint32_t> m_offsets;
+		std::vector<std::uint32_t> m_connection_ids;
+		std::vector<std::uint32_t> m_connection_topics;
+		std::vector<std::uint64_t> m_chunk_positions;
+		std::vector<topic_t> m_topics;
+		std::vector<std::uint64_t> m_topic_rows; // rows of each topic next to each other, in time order
+		std::vector<char> m_strings;
+	};
+
+	inline void swap(bag_index_t& a, bag_index_t& b) noexcept { a.swap(b); }
+
+
+}
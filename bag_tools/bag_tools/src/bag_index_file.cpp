@@ -0,0 +1,654 @@
+// 64 bit off_t and file offsets on 32 bit Linux too, bags are way over 2 GiB. Has to come before any system header.
+#if !defined(_MSC_VER) && !defined(_FILE_OFFSET_BITS)
+	#define _FILE_OFFSET_BITS 64
+#endif
+
+#include "bag_index_file.h"
+
+#include "data_source_mem.h"
+#include "data_source_rommf.h"
+#include "overload.h"
+#include "scope_exit.h"
+#include "utils.h"
+#include "write_only_file.h"
+
+#include <algorithm> // std::sort, std::find_if, std::all_of
+#include <cassert>
+#include <cstring> // std::memcmp, std::memcpy
+#include <string> // std::basic_string, std::to_string, std::to_wstring
+#include <utility> // std::swap, std::move
+
+#ifdef _MSC_VER
+	#include <windows.h>
+#else
+	#include <cstdio> // std::rename, std::remove
+
+	// stat
+	#include <sys/types.h>
+	#include <sys/stat.h>
+	#include <unistd.h> // getpid
+
+	static_assert(sizeof(off_t) == sizeof(std::uint64_t));
+#endif
+
+
+namespace mk
+{
+	namespace detail
+	{
+
+
+		static constexpr unsigned char const s_bag_index_file_magic[8] = {'M', 'K', 'B', 'A', 'G', 'I', 'D', 'X'};
+		static constexpr native_char_t const s_bag_index_file_extension[] = MK_TEXT(".bagidx");
+		static constexpr native_char_t const s_bag_index_file_tmp_extension[] = MK_TEXT(".tmp");
+		static constexpr std::uint64_t const s_bag_index_file_max_count = 1ull << 48; // keeps the layout math far away from overflow
+
+		struct bag_index_file_layout_t
+		{
+			std::uint64_t m_connections;
+			std::uint64_t m_chunks;
+			std::uint64_t m_bitmaps;
+			std::uint64_t m_message_times;
+			std::uint64_t m_message_chunks;
+			std::uint64_t m_message_offsets;
+			std::uint64_t m_strings;
+			std::uint64_t m_size;
+		};
+
+		struct bag_index_file_message_t
+		{
+			std::uint64_t m_time;
+			std::uint32_t m_chunk;
+			std::uint32_t m_offset;
+		};
+
+		struct bag_index_file_chunk_entry_t
+		{
+			bag_index_file_chunk_t m_chunk;
+			std::vector<mk::bag::data::chunk_info_ver_1_t> m_connections;
+		};
+
+		struct bag_index_file_builder_t
+		{
+			std::uint64_t m_index_pos;
+			std::vector<bag_index_file_connection_t> m_connections;
+			std::vector<char> m_strings;
+			std::vector<bag_index_file_chunk_entry_t> m_chunks;
+			std::vector<std::vector<bag_index_file_message_t>> m_messages; // per connection
+			std::uint32_t m_chunk_idx;
+			bool m_chunk_seen;
+		};
+
+
+		bool get_bag_index_file_layout(bag_index_file_header_t const& header, bag_index_file_layout_t* const out_layout);
+		bool get_bag_index_file_stamp(native_char_t const* const file_path, std::uint64_t* const out_size, std::uint64_t* const out_mtime);
+		std::basic_string<native_char_t> get_bag_index_file_path(native_char_t const* const bag_path);
+		bool find_bag_index_file_connection(bag_index_file_builder_t const& builder, std::uint32_t const conn, std::uint32_t* const out_connection_idx);
+		template<typename data_source_t>
+		bool build_bag_index_file(data_source_t& data_source, std::uint64_t const bag_size, std::uint64_t const bag_mtime, std::vector<unsigned char>* const out_image);
+		template<typename data_source_t>
+		bool build_bag_index_file_chunk(data_source_t& data_source, bag_index_file_builder_t& builder);
+		bool save_bag_index_file(native_char_t const* const bag_path, std::vector<unsigned char> const& image);
+
+
+	}
+}
+
+
+bool mk::detail::get_bag_index_file_layout(bag_index_file_header_t const& header, bag_index_file_layout_t* const out_layout)
+{
+	assert(out_layout);
+	bag_index_file_layout_t& layout = *out_layout;
+
+	if(!(header.m_bitmap_words == (header.m_connections_count + 63) / 64))
+	{
+		return false;
+	}
+	if(!(header.m_messages_count < s_bag_index_file_max_count && header.m_strings_size < s_bag_index_file_max_count))
+	{
+		return false;
+	}
+
+	std::uint64_t const messages_count = header.m_messages_count;
+	layout.m_connections = sizeof(bag_index_file_header_t);
+	layout.m_chunks = layout.m_connections + header.m_connections_count * sizeof(bag_index_file_connection_t);
+	layout.m_bitmaps = layout.m_chunks + header.m_chunks_count * sizeof(bag_index_file_chunk_t);
+	layout.m_message_times = layout.m_bitmaps + static_cast<std::uint64_t>(header.m_chunks_count) * header.m_bitmap_words * sizeof(std::uint64_t);
+	layout.m_message_chunks = layout.m_message_times + messages_count * sizeof(std::uint64_t);
+	layout.m_message_offsets = layout.m_message_chunks + messages_count * sizeof(std::uint32_t);
+	layout.m_strings = layout.m_message_offsets + messages_count * sizeof(std::uint32_t);
+	layout.m_size = (layout.m_strings + header.m_strings_size + 7) / 8 * 8;
+
+	return true;
+}
+
+bool mk::detail::get_bag_index_file_stamp(native_char_t const* const file_path, std::uint64_t* const out_size, std::uint64_t* const out_mtime)
+{
+	assert(file_path);
+	assert(out_size);
+	assert(out_mtime);
+	std::uint64_t& size = *out_size;
+	std::uint64_t& mtime = *out_mtime;
+
+	#ifdef _MSC_VER
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+	BOOL const got_attributes = GetFileAttributesExW(file_path, GetFileExInfoStandard, &attributes);
+	if(!(got_attributes != 0))
+	{
+		return false;
+	}
+	size = (static_cast<std::uint64_t>(attributes.nFileSizeHigh) << 32) | static_cast<std::uint64_t>(attributes.nFileSizeLow);
+	mtime = (static_cast<std::uint64_t>(attributes.ftLastWriteTime.dwHighDateTime) << 32) | static_cast<std::uint64_t>(attributes.ftLastWriteTime.dwLowDateTime);
+	#else
+	struct stat stat_buff;
+	int const stated = stat(file_path, &stat_buff);
+	if(!(stated == 0))
+	{
+		return false;
+	}
+	size = static_cast<std::uint64_t>(stat_buff.st_size);
+	mtime = static_cast<std::uint64_t>(stat_buff.st_mtim.tv_sec) * 1'000'000'000ull + static_cast<std::uint64_t>(stat_buff.st_mtim.tv_nsec);
+	#endif
+
+	return true;
+}
+
+std::basic_string<native_char_t> mk::detail::get_bag_index_file_path(native_char_t const* const bag_path)
+{
+	assert(bag_path);
+	std::basic_string<native_char_t> path = bag_path;
+	path += s_bag_index_file_extension;
+	return path;
+}
+
+bool mk::detail::find_bag_index_file_connection(bag_index_file_builder_t const& builder, std::uint32_t const conn, std::uint32_t* const out_connection_idx)
+{
+	assert(out_connection_idx);
+	std::uint32_t& connection_idx = *out_connection_idx;
+
+	auto const it = std::find_if(builder.m_connections.cbegin(), builder.m_connections.cend(), [&](bag_index_file_connection_t const& connection){ return connection.m_conn == conn; });
+	CHECK_RET_F(it != builder.m_connections.cend());
+	connection_idx = static_cast<std::uint32_t>(it - builder.m_connections.cbegin());
+
+	return true;
+}
+
+template<typename data_source_t>
+bool mk::detail::build_bag_index_file(data_source_t& data_source, std::uint64_t const bag_size, std::uint64_t const bag_mtime, std::vector<unsigned char>* const out_image)
+{
+	static constexpr auto const s_bag_callback = [](void* const ctx, void* const data, bool& keep_iterating) -> bool
+	{
+		bag_index_file_builder_t& builder = *static_cast<bag_index_file_builder_t*>(ctx);
+		mk::bag::record_t const& record = *static_cast<mk::bag::record_t const*>(data);
+
+		bool const is_bag = std::visit(mk::make_overload([](mk::bag::header::bag_t const&) -> bool { return true; }, [](...) -> bool { return false; }), record.m_header);
+		CHECK_RET_F(is_bag);
+		builder.m_index_pos = std::get<mk::bag::header::bag_t>(record.m_header).m_index_pos;
+
+		keep_iterating = false;
+		return true;
+	};
+	static constexpr auto const s_index_callback = [](void* const ctx, void* const data, [[maybe_unused]] bool& keep_iterating) -> bool
+	{
+		bag_index_file_builder_t& builder = *static_cast<bag_index_file_builder_t*>(ctx);
+		mk::bag::record_t const& record = *static_cast<mk::bag::record_t const*>(data);
+
+		bool const is_connection = std::visit(mk::make_overload([](mk::bag::header::connection_t const&) -> bool { return true; }, [](...) -> bool { return false; }), record.m_header);
+		if(is_connection)
+		{
+			mk::bag::header::connection_t const& connection = std::get<mk::bag::header::connection_t>(record.m_header);
+			bag_index_file_connection_t entry{};
+			entry.m_conn = connection.m_conn;
+			entry.m_topic_len = static_cast<std::uint32_t>(connection.m_topic.m_len);
+			entry.m_topic_offset = builder.m_strings.size();
+			builder.m_strings.insert(builder.m_strings.end(), connection.m_topic.m_begin, connection.m_topic.m_begin + connection.m_topic.m_len);
+			builder.m_connections.push_back(entry);
+			return true;
+		}
+
+		bool const is_chunk_info = std::visit(mk::make_overload([](mk::bag::header::chunk_info_t const&) -> bool { return true; }, [](...) -> bool { return false; }), record.m_header);
+		if(is_chunk_info)
+		{
+			mk::bag::header::chunk_info_t const& chunk_info = std::get<mk::bag::header::chunk_info_t>(record.m_header);
+			bag_index_file_chunk_entry_t entry;
+			entry.m_chunk.m_chunk_pos = chunk_info.m_chunk_pos;
+			entry.m_chunk.m_start_time = chunk_info.m_start_time;
+			entry.m_chunk.m_end_time = chunk_info.m_end_time;
+			entry.m_chunk.m_ver = chunk_info.m_ver;
+			entry.m_chunk.m_count = chunk_info.m_count;
+			entry.m_connections.resize(chunk_info.m_count);
+			for(std::uint32_t i = 0; i != chunk_info.m_count; ++i)
+			{
+				bool const parsed = mk::bag::parse_chunk_info_data(record, i, &entry.m_connections[i]);
+				CHECK_RET_F(parsed);
+			}
+			builder.m_chunks.push_back(std::move(entry));
+			return true;
+		}
+
+		return true;
+	};
+
+	assert(out_image);
+	std::vector<unsigned char>& image = *out_image;
+
+	CHECK_RET_F(mk::bag::is_bag_file(data_source));
+	data_source.consume(mk::bag::bag_file_header_len());
+
+	bag_index_file_builder_t builder{};
+	bool const bag_parsed = mk::bag::parse_records(data_source, s_bag_callback, &builder);
+	CHECK_RET_F(bag_parsed);
+	CHECK_RET_F(builder.m_index_pos >= static_cast<std::uint64_t>(mk::bag::bag_file_header_len()) && builder.m_index_pos < data_source.get_input_size());
+	data_source.move_to(builder.m_index_pos, 1);
+	bool const index_parsed = mk::bag::parse_records(data_source, s_index_callback, &builder);
+	CHECK_RET_F(index_parsed);
+	CHECK_RET_F(builder.m_connections.size() < s_bag_index_file_max_count && builder.m_chunks.size() < s_bag_index_file_max_count);
+
+	std::sort(builder.m_chunks.begin(), builder.m_chunks.end(), [](bag_index_file_chunk_entry_t const& a, bag_index_file_chunk_entry_t const& b) -> bool { return a.m_chunk.m_chunk_pos < b.m_chunk.m_chunk_pos; });
+	CHECK_RET_F(std::all_of(builder.m_chunks.cbegin(), builder.m_chunks.cend(), [&](bag_index_file_chunk_entry_t const& chunk) -> bool { return chunk.m_chunk.m_chunk_pos >= static_cast<std::uint64_t>(mk::bag::bag_file_header_len()) && chunk.m_chunk.m_chunk_pos < builder.m_index_pos; }));
+
+	// Index data records right behind each chunk tell time and offset of every message in it.
+	builder.m_messages.resize(builder.m_connections.size());
+	for(std::uint32_t i = 0; i != builder.m_chunks.size(); ++i)
+	{
+		builder.m_chunk_idx = i;
+		builder.m_chunk_seen = false;
+		data_source.move_to(builder.m_chunks[i].m_chunk.m_chunk_pos, 1);
+		bool const chunk_built = build_bag_index_file_chunk(data_source, builder);
+		CHECK_RET_F(chunk_built);
+	}
+
+	bag_index_file_header_t header{};
+	std::memcpy(header.m_magic, s_bag_index_file_magic, sizeof(header.m_magic));
+	header.m_version = bag_index_file_t::s_version;
+	header.m_connections_count = static_cast<std::uint32_t>(builder.m_connections.size());
+	header.m_chunks_count = static_cast<std::uint32_t>(builder.m_chunks.size());
+	header.m_bitmap_words = (header.m_connections_count + 63) / 64;
+	header.m_messages_count = 0;
+	for(std::size_t i = 0; i != builder.m_connections.size(); ++i)
+	{
+		std::vector<bag_index_file_message_t> const& messages = builder.m_messages[i];
+		bag_index_file_connection_t& connection = builder.m_connections[i];
+		connection.m_first_message = header.m_messages_count;
+		connection.m_messages_count = messages.size();
+		connection.m_start_time = messages.empty() ? 0 : std::min_element(messages.cbegin(), messages.cend(), [](bag_index_file_message_t const& a, bag_index_file_message_t const& b){ return mk::bag::get_time_ns(a.m_time) < mk::bag::get_time_ns(b.m_time); })->m_time;
+		connection.m_end_time = messages.empty() ? 0 : std::max_element(messages.cbegin(), messages.cend(), [](bag_index_file_message_t const& a, bag_index_file_message_t const& b){ return mk::bag::get_time_ns(a.m_time) < mk::bag::get_time_ns(b.m_time); })->m_time;
+		header.m_messages_count += messages.size();
+	}
+	header.m_strings_size = builder.m_strings.size();
+	header.m_bag_size = bag_size;
+	header.m_bag_mtime = bag_mtime;
+
+	bag_index_file_layout_t layout;
+	bool const got_layout = get_bag_index_file_layout(header, &layout);
+	CHECK_RET_F(got_layout);
+	header.m_size = layout.m_size;
+
+	image.assign(static_cast<std::size_t>(layout.m_size), 0);
+	unsigned char* const data = image.data();
+	std::memcpy(data, &header, sizeof(header));
+	if(!builder.m_connections.empty())
+	{
+		std::memcpy(data + layout.m_connections, builder.m_connections.data(), builder.m_connections.size() * sizeof(bag_index_file_connection_t));
+	}
+	for(std::size_t i = 0; i != builder.m_chunks.size(); ++i)
+	{
+		bag_index_file_chunk_entry_t const& chunk = builder.m_chunks[i];
+		std::memcpy(data + layout.m_chunks + i * sizeof(bag_index_file_chunk_t), &chunk.m_chunk, sizeof(bag_index_file_chunk_t));
+		std::uint64_t* const bitmap = reinterpret_cast<std::uint64_t*>(data + layout.m_bitmaps) + i * header.m_bitmap_words;
+		for(mk::bag::data::chunk_info_ver_1_t const& chunk_connection : chunk.m_connections)
+		{
+			if(chunk_connection.m_count == 0)
+			{
+				continue;
+			}
+			std::uint32_t connection_idx;
+			bool const found = find_bag_index_file_connection(builder, chunk_connection.m_conn, &connection_idx);
+			CHECK_RET_F(found);
+			bitmap[connection_idx / 64] |= 1ull << (connection_idx % 64);
+		}
+	}
+	std::uint64_t* const message_times = reinterpret_cast<std::uint64_t*>(data + layout.m_message_times);
+	std::uint32_t* const message_chunks = reinterpret_cast<std::uint32_t*>(data + layout.m_message_chunks);
+	std::uint32_t* const message_offsets = reinterpret_cast<std::uint32_t*>(data + layout.m_message_offsets);
+	std::uint64_t message_idx = 0;
+	for(std::vector<bag_index_file_message_t> const& messages : builder.m_messages)
+	{
+		for(bag_index_file_message_t const& message : messages)
+		{
+			message_times[message_idx] = message.m_time;
+			message_chunks[message_idx] = message.m_chunk;
+			message_offsets[message_idx] = message.m_offset;
+			++message_idx;
+		}
+	}
+	if(!builder.m_strings.empty())
+	{
+		std::memcpy(data + layout.m_strings, builder.m_strings.data(), builder.m_strings.size());
+	}
+
+	return true;
+}
+
+template<typename data_source_t>
+bool mk::detail::build_bag_index_file_chunk(data_source_t& data_source, bag_index_file_builder_t& builder)
+{
+	static constexpr auto const s_record_callback = [](void* const ctx, void* const data, bool& keep_iterating) -> bool
+	{
+		bag_index_file_builder_t& builder = *static_cast<bag_index_file_builder_t*>(ctx);
+		mk::bag::record_t const& record = *static_cast<mk::bag::record_t const*>(data);
+
+		if(!builder.m_chunk_seen)
+		{
+			bool const is_chunk = std::visit(mk::make_overload([](mk::bag::header::chunk_t const&) -> bool { return true; }, [](...) -> bool { return false; }), record.m_header);
+			CHECK_RET_F(is_chunk);
+			builder.m_chunk_seen = true;
+			return true;
+		}
+
+		bool const is_index_data = std::visit(mk::make_overload([](mk::bag::header::index_data_t const&) -> bool { return true; }, [](...) -> bool { return false; }), record.m_header);
+		if(!is_index_data)
+		{
+			keep_iterating = false;
+			return true;
+		}
+		mk::bag::header::index_data_t const& index_data = std::get<mk::bag::header::index_data_t>(record.m_header);
+
+		std::uint32_t connection_idx;
+		bool const found = find_bag_index_file_connection(builder, index_data.m_conn, &connection_idx);
+		CHECK_RET_F(found);
+		std::vector<bag_index_file_message_t>& messages = builder.m_messages[connection_idx];
+		for(std::uint32_t i = 0; i != index_data.m_count; ++i)
+		{
+			mk::bag::data::index_data_ver_1_t entry;
+			bool const parsed = mk::bag::parse_index_data_data(record, i, &entry);
+			CHECK_RET_F(parsed);
+			messages.push_back(bag_index_file_message_t{entry.m_time, builder.m_chunk_idx, entry.m_offset});
+		}
+
+		return true;
+	};
+	mk::bag::callback_t const callback = s_record_callback;
+
+	bool const parsed = mk::bag::parse_records(data_source, callback, &builder);
+	CHECK_RET_F(parsed);
+
+	return true;
+}
+
+bool mk::detail::save_bag_index_file(native_char_t const* const bag_path, std::vector<unsigned char> const& image)
+{
+	// Written aside and renamed over, so a reader never maps a half written sidecar.
+	// Several first runs on one bag at once each write a temporary of their own, named after the process, the last rename wins.
+	std::basic_string<native_char_t> const path = get_bag_index_file_path(bag_path);
+	#ifdef _MSC_VER
+	std::basic_string<native_char_t> const pid = std::to_wstring(GetCurrentProcessId());
+	#else
+	std::basic_string<native_char_t> const pid = std::to_string(getpid());
+	#endif
+	std::basic_string<native_char_t> const tmp_path = path + MK_TEXT(".") + pid + s_bag_index_file_tmp_extension;
+	auto remove_tmp = mk::make_scope_exit([&]()
+	{
+		#ifdef _MSC_VER
+		[[maybe_unused]] BOOL const deleted = DeleteFileW(tmp_path.c_str());
+		#else
+		[[maybe_unused]] int const removed = std::remove(tmp_path.c_str());
+		#endif
+	});
+	{
+		mk::write_only_file_t file{tmp_path.c_str()};
+		if(!file)
+		{
+			return false;
+		}
+		bool const written = file.write_at(0, image.data(), image.size());
+		CHECK_RET_F(written);
+	}
+	#ifdef _MSC_VER
+	BOOL const moved = MoveFileExW(tmp_path.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING);
+	CHECK_RET_F(moved != 0);
+	#else
+	int const renamed = std::rename(tmp_path.c_str(), path.c_str());
+	CHECK_RET_F(renamed == 0);
+	#endif
+	remove_tmp.reset();
+
+	return true;
+}
+
+
+mk::bag_index_file_t::bag_index_file_t() noexcept :
+	m_file(),
+	m_image(),
+	m_header(),
+	m_connections(),
+	m_chunks(),
+	m_bitmaps(),
+	m_message_times(),
+	m_message_chunks(),
+	m_message_offsets(),
+	m_strings()
+{
+}
+
+mk::bag_index_file_t mk::bag_index_file_t::open(native_char_t const* const bag_path)
+{
+	bag_index_file_t index_file = load(bag_path);
+	if(index_file)
+	{
+		return index_file;
+	}
+
+	std::uint64_t bag_size;
+	std::uint64_t bag_mtime;
+	bool const stamped = detail::get_bag_index_file_stamp(bag_path, &bag_size, &bag_mtime);
+	CHECK_RET(stamped, index_file);
+
+	// Only headers of chunks and the index records get touched, chunk data is never paged in.
+	std::vector<unsigned char> image;
+	mk::read_only_memory_mapped_file_t const rommf{bag_path};
+	if(rommf)
+	{
+		mk::data_source_mem_t data_source_mem = mk::data_source_mem_t::make(rommf.get_data(), static_cast<std::size_t>(rommf.get_size()));
+		CHECK_RET(data_source_mem, index_file);
+		bool const built = detail::build_bag_index_file(data_source_mem, bag_size, bag_mtime, &image);
+		CHECK_RET(built, index_file);
+	}
+	else
+	{
+		mk::data_source_rommf_t data_source_rommf = mk::data_source_rommf_t::make(bag_path);
+		CHECK_RET(data_source_rommf, index_file);
+		bool const built = detail::build_bag_index_file(data_source_rommf, bag_size, bag_mtime, &image);
+		CHECK_RET(built, index_file);
+	}
+
+	// Bags on read only storage simply go without a sidecar.
+	[[maybe_unused]] bool const saved = detail::save_bag_index_file(bag_path, image);
+
+	index_file.m_image = std::move(image);
+	bool const attached = index_file.attach(index_file.m_image.data(), index_file.m_image.size(), bag_size, bag_mtime);
+	CHECK_RET(attached, bag_index_file_t{});
+
+	return index_file;
+}
+
+mk::bag_index_file_t mk::bag_index_file_t::load(native_char_t const* const bag_path)
+{
+	bag_index_file_t index_file;
+
+	std::uint64_t bag_size;
+	std::uint64_t bag_mtime;
+	bool const stamped = detail::get_bag_index_file_stamp(bag_path, &bag_size, &bag_mtime);
+	if(!stamped)
+	{
+		return index_file;
+	}
+
+	std::basic_string<native_char_t> const path = detail::get_bag_index_file_path(bag_path);
+	index_file.m_file = mk::read_only_memory_mapped_file_t{path.c_str()};
+	if(!index_file.m_file)
+	{
+		return bag_index_file_t{};
+	}
+	bool const attached = index_file.attach(static_cast<unsigned char const*>(index_file.m_file.get_data()), index_file.m_file.get_size(), bag_size, bag_mtime);
+	if(!attached)
+	{
+		return bag_index_file_t{};
+	}
+
+	return index_file;
+}
+
+mk::bag_index_file_t::bag_index_file_t(bag_index_file_t&& other) noexcept :
+	bag_index_file_t()
+{
+	swap(other);
+}
+
+mk::bag_index_file_t& mk::bag_index_file_t::operator=(bag_index_file_t&& other) noexcept
+{
+	swap(other);
+	return *this;
+}
+
+mk::bag_index_file_t::~bag_index_file_t() noexcept
+{
+}
+
+void mk::bag_index_file_t::swap(bag_index_file_t& other) noexcept
+{
+	using std::swap;
+	swap(m_file, other.m_file);
+	swap(m_image, other.m_image);
+	swap(m_header, other.m_header);
+	swap(m_connections, other.m_connections);
+	swap(m_chunks, other.m_chunks);
+	swap(m_bitmaps, other.m_bitmaps);
+	swap(m_message_times, other.m_message_times);
+	swap(m_message_chunks, other.m_message_chunks);
+	swap(m_message_offsets, other.m_message_offsets);
+	swap(m_strings, other.m_strings);
+}
+
+mk::bag_index_file_t::operator bool() const
+{
+	return m_header != nullptr;
+}
+
+void mk::bag_index_file_t::reset()
+{
+	*this = bag_index_file_t{};
+}
+
+
+std::uint32_t mk::bag_index_file_t::get_connections_count() const
+{
+	assert(*this);
+	return m_header->m_connections_count;
+}
+
+mk::bag_index_file_connection_t const& mk::bag_index_file_t::get_connection(std::uint32_t const connection_idx) const
+{
+	assert(*this);
+	assert(connection_idx < m_header->m_connections_count);
+	return m_connections[connection_idx];
+}
+
+mk::bag::string_t mk::bag_index_file_t::get_topic(std::uint32_t const connection_idx) const
+{
+	bag_index_file_connection_t const& connection = get_connection(connection_idx);
+	return mk::bag::string_t{m_strings + connection.m_topic_offset, static_cast<int>(connection.m_topic_len)};
+}
+
+std::uint32_t mk::bag_index_file_t::get_chunks_count() const
+{
+	assert(*this);
+	return m_header->m_chunks_count;
+}
+
+mk::bag_index_file_chunk_t const& mk::bag_index_file_t::get_chunk(std::uint32_t const chunk_idx) const
+{
+	assert(*this);
+	assert(chunk_idx < m_header->m_chunks_count);
+	return m_chunks[chunk_idx];
+}
+
+bool mk::bag_index_file_t::has_connection(std::uint32_t const chunk_idx, std::uint32_t const connection_idx) const
+{
+	assert(*this);
+	assert(chunk_idx < m_header->m_chunks_count);
+	assert(connection_idx < m_header->m_connections_count);
+	std::uint64_t const word = m_bitmaps[static_cast<std::uint64_t>(chunk_idx) * m_header->m_bitmap_words + connection_idx / 64];
+	return ((word >> (connection_idx % 64)) & 1) != 0;
+}
+
+std::uint64_t mk::bag_index_file_t::get_messages_count() const
+{
+	assert(*this);
+	return m_header->m_messages_count;
+}
+
+std::uint64_t const* mk::bag_index_file_t::get_message_times() const
+{
+	assert(*this);
+	return m_message_times;
+}
+
+std::uint32_t const* mk::bag_index_file_t::get_message_chunks() const
+{
+	assert(*this);
+	return m_message_chunks;
+}
+
+std::uint32_t const* mk::bag_index_file_t::get_message_offsets() const
+{
+	assert(*this);
+	return m_message_offsets;
+}
+
+
+bool mk::bag_index_file_t::attach(unsigned char const* const data, std::uint64_t const size, std::uint64_t const bag_size, std::uint64_t const bag_mtime)
+{
+	// Missing, stale or damaged sidecar is not an error, it just gets built again.
+	if(!(size >= sizeof(bag_index_file_header_t)))
+	{
+		return false;
+	}
+	bag_index_file_header_t const* const header = reinterpret_cast<bag_index_file_header_t const*>(data);
+	if(!(std::memcmp(header->m_magic, detail::s_bag_index_file_magic, sizeof(header->m_magic)) == 0 && header->m_version == s_version))
+	{
+		return false;
+	}
+	if(!(header->m_bag_size == bag_size && header->m_bag_mtime == bag_mtime))
+	{
+		return false;
+	}
+	detail::bag_index_file_layout_t layout;
+	bool const got_layout = detail::get_bag_index_file_layout(*header, &layout);
+	if(!(got_layout && layout.m_size == header->m_size && layout.m_size == size))
+	{
+		return false;
+	}
+	bag_index_file_connection_t const* const connections = reinterpret_cast<bag_index_file_connection_t const*>(data + layout.m_connections);
+	bool const connections_valid = std::all_of(connections, connections + header->m_connections_count, [&](bag_index_file_connection_t const& connection)
+	{
+		return
+			connection.m_topic_offset <= header->m_strings_size && connection.m_topic_len <= header->m_strings_size - connection.m_topic_offset &&
+			connection.m_first_message <= header->m_messages_count && connection.m_messages_count <= header->m_messages_count - connection.m_first_message;
+	});
+	if(!connections_valid)
+	{
+		return false;
+	}
+
+	m_header = header;
+	m_connections = connections;
+	m_chunks = reinterpret_cast<bag_index_file_chunk_t const*>(data + layout.m_chunks);
+	m_bitmaps = reinterpret_cast<std::uint64_t const*>(data + layout.m_bitmaps);
+	m_message_times = reinterpret_cast<std::uint64_t const*>(data + layout.m_message_times);
+	m_message_chunks = reinterpret_cast<std::uint32_t const*>(data + layout.m_message_chunks);
+	m_message_offsets = reinterpret_cast<std::uint32_t const*>(data + layout.m_message_offsets);
+	m_strings = reinterpret_cast<char const*>(data + layout.m_strings);
+
+	return true;
+}
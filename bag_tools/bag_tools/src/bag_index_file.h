@@ -0,0 +1,99 @@
+#pragma once
+
+
+#include "bag.h"
+#include "cross_platform.h"
+#include "read_only_memory_mapped_file.h"
+
+#include <cstdint>
+#include <vector>
+
+
+namespace mk
+{
+
+
+	// Sidecar file "input.bag.bagidx" lives next to the bag. Fixed size records and plain columns, each aligned to its element size (8 bytes for the 64 bit ones, 4 bytes for message chunks and offsets), so a mapping of it is usable as is.
+	// Layout: header, connections, chunks, chunk bitmaps, message times, message chunks, message offsets, topic strings.
+
+	struct bag_index_file_header_t
+	{
+		unsigned char m_magic[8];
+		std::uint32_t m_version;
+		std::uint32_t m_connections_count;
+		std::uint32_t m_chunks_count;
+		std::uint32_t m_bitmap_words; // per chunk, bit N is set when the chunk has messages of connection N
+		std::uint64_t m_messages_count;
+		std::uint64_t m_strings_size;
+		std::uint64_t m_bag_size; // the bag the sidecar was made from, it is stale once these do not match
+		std::uint64_t m_bag_mtime;
+		std::uint64_t m_size; // of the whole sidecar, catches truncated files
+	};
+
+	struct bag_index_file_connection_t
+	{
+		std::uint32_t m_conn; // connection ID as in the bag
+		std::uint32_t m_topic_len;
+		std::uint64_t m_topic_offset; // into topic strings
+		std::uint64_t m_first_message; // messages of one connection are next to each other in the message columns, ordered by chunk
+		std::uint64_t m_messages_count;
+		std::uint64_t m_start_time;
+		std::uint64_t m_end_time;
+	};
+
+	struct bag_index_file_chunk_t
+	{
+		std::uint64_t m_chunk_pos;
+		std::uint64_t m_start_time;
+		std::uint64_t m_end_time;
+		std::uint32_t m_ver;
+		std::uint32_t m_count; // number of connections in the chunk
+	};
+
+
+	class bag_index_file_t
+	{
+	public:
+		static constexpr std::uint32_t const s_version = 1;
+	public:
+		bag_index_file_t() noexcept;
+		static bag_index_file_t open(native_char_t const* const bag_path);
+		static bag_index_file_t load(native_char_t const* const bag_path);
+		bag_index_file_t(bag_index_file_t const&) = delete;
+		bag_index_file_t(bag_index_file_t&& other) noexcept;
+		bag_index_file_t& operator=(bag_index_file_t const&) = delete;
+		bag_index_file_t& operator=(bag_index_file_t&& other) noexcept;
+		~bag_index_file_t() noexcept;
+		void swap(bag_index_file_t& other) noexcept;
+		explicit operator bool() const;
+		void reset();
+	public:
+		std::uint32_t get_connections_count() const;
+		bag_index_file_connection_t const& get_connection(std::uint32_t const connection_idx) const;
+		mk::bag::string_t get_topic(std::uint32_t const connection_idx) const;
+		std::uint32_t get_chunks_count() const;
+		bag_index_file_chunk_t const& get_chunk(std::uint32_t const chunk_idx) const;
+		bool has_connection(std::uint32_t const chunk_idx, std::uint32_t const connection_idx) const;
+		std::uint64_t get_messages_count() const;
+		std::uint64_t const* get_message_times() const;
+		std::uint32_t const* get_message_chunks() const;
+		std::uint32_t const* get_message_offsets() const;
+	private:
+		bool attach(unsigned char const* const data, std::uint64_t const size, std::uint64_t const bag_size, std::uint64_t const bag_mtime);
+	private:
+		mk::read_only_memory_mapped_file_t m_file; // sidecar loaded from disk
+		std::vector<unsigned char> m_image; // or sidecar built just now
+		bag_index_file_header_t const* m_header;
+		bag_index_file_connection_t const* m_connections;
+		bag_index_file_chunk_t const* m_chunks;
+		std::uint64_t const* m_bitmaps;
+		std::uint64_t const* m_message_times;
+		std::uint32_t const* m_message_chunks;
+		std::uint32_t const* m_message_offsets;
+		char const* m_strings;
+	};
+
+	inline void swap(bag_index_file_t& a, bag_index_file_t& b) noexcept { a.swap(b); }
+
+
+}
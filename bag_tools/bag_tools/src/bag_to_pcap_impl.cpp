@@ -1,39 +1,409 @@
 #include "bag_to_pcap_impl.h"
 
+#include "command_line.h"
+#include "data_source_direct.h"
 #include "data_source_mem.h"
+#include "data_source_pipe.h"
 #include "data_source_rommf.h"
 #include "overload.h"
 #include "read_only_memory_mapped_file.h"
-#include "scope_exit.h"
 #include "utils.h"
+#include "worker_pool.h"
+#include "write_only_file.h"
 
+#include <algorithm> // std::sort, std::all_of, std::any_of, std::none_of, std::find, std::find_if, std::count_if, std::equal, std::transform, std::min, std::remove_if
+#include <array>
 #include <cassert>
 #include <chrono>
-#include <fstream>
-#include <optional>
+#include <cstring> // std::memcpy, std::memset
+#include <iterator> // std::size
+#include <limits>
+#include <string> // std::to_string
+#include <thread>
+#include <utility> // std::move
 
-#include <lz4frame.h>
+#include <bzlib.h>
 
 
-static std::chrono::milliseconds g_time;
-static std::ofstream g_ofs;
+namespace mk
+{
+	namespace bag_tool
+	{
+		namespace detail
+		{
+			struct pcap_hdr_t
+			{
+				std::uint32_t magic_number; /* magic number */
+				std::uint16_t version_major; /* major version number */
+				std::uint16_t version_minor; /* minor version number */
+				std::int32_t thiszone; /* GMT to local correction */
+				std::uint32_t sigfigs; /* accuracy of timestamps */
+				std::uint32_t snaplen; /* max length of captured packets, in octets */
+				std::uint32_t network; /* data link type */
+			};
+			static_assert(sizeof(pcap_hdr_t) == 24);
+			struct pcaprec_hdr_t
+			{
+				std::uint32_t ts_sec; /* timestamp seconds */
+				std::uint32_t ts_usec; /* timestamp microseconds */
+				std::uint32_t incl_len; /* number of octets of packet saved in file */
+				std::uint32_t orig_len; /* actual length of packet */
+			};
+			static_assert(sizeof(pcaprec_hdr_t) == 16);
+			struct brutal_header_t
+			{
+				unsigned char eth_ig_1[3];
+				unsigned char eth_addr_1[3];
+				unsigned char eth_ig_2[3];
+				unsigned char eth_addr_2[3];
+				unsigned char eth_type[2];
+				unsigned char ip_hdr_len[1];
+				unsigned char ip_dsfield_enc[1];
+				unsigned char ip_len[2];
+				unsigned char ip_id[2];
+				unsigned char ip_frag_offset[2];
+				unsigned char ip_ttl[1];
+				unsigned char ip_proto[1];
+				unsigned char ip_checksum[2];
+				unsigned char ip_src[4];
+				unsigned char ip_dst[4];
+				unsigned char udp_src_port[2];
+				unsigned char udp_dst_port[2];
+				unsigned char udp_len[2];
+				unsigned char udp_checksum[2];
+			};
+			static_assert(sizeof(brutal_header_t) == 42);
+			static constexpr int const s_ouster_payload_len = 12608;
+			static constexpr int const s_ouster_bag_payload_len = 12613;
+			static constexpr int const s_ouster_header_len = static_cast<int>(sizeof(pcaprec_hdr_t)) + static_cast<int>(sizeof(brutal_header_t));
+			static constexpr int const s_ouster_packet_len = s_ouster_header_len + s_ouster_payload_len;
+			static constexpr std::size_t const s_direct_block_size = 4 * 1024;
+			static constexpr std::size_t const s_direct_staging_size = 8 * 1024 * 1024;
+			struct ouster_chunk_job_t
+			{
+				std::vector<char> m_compression;
+				std::uint32_t m_size;
+				std::vector<unsigned char> m_chunk_data;
+				std::vector<mk::bag::data::index_data_ver_1_t> m_index_entries;
+				bool m_indexed;
+				bool m_placed; // packets are cut out and counted, m_first_packets_idx is set, next run of the job writes them
+				std::vector<std::uint64_t> m_first_packets_idx; // per lidar
+				chunk_decompressor_t m_decompressor; // per job, payloads of m_packets point into its buffer until the job is committed
+				std::vector<ouster_packets_t> m_packets; // per lidar
+				std::vector<mk::write_only_file_buffer_t> m_buffers;
+			};
+			struct ouster_workers_ctx_t
+			{
+				std::vector<std::uint32_t> m_ouster_channels;
+				time_window_t m_window;
+				std::vector<mk::write_only_file_t*> m_output_files; // per lidar, empty unless threads write by themselves
+			};
+		}
+	}
+}
 
 
 bool mk::bag_tool::detail::bag_to_pcap(int const argc, native_char_t const* const* const argv)
 {
-	CHECK_RET_F(argc == 4);
-	return bag_to_pcap(argv[2], argv[3]);
+	CHECK_RET_F(argc >= 4);
+	pcap_options_t options;
+	bool const options_parsed = parse_pcap_options(argc - 4, argv + 4, &options);
+	CHECK_RET_F(options_parsed);
+	return bag_to_pcap(argv[2], argv[3], options);
 }
 
+bool mk::bag_tool::detail::parse_pcap_options(int const argc, native_char_t const* const* const argv, pcap_options_t* const out_options)
+{
+	static constexpr native_char_t const s_option_threads_name[] = MK_TEXT("-j");
+	static constexpr int const s_option_threads_name_len = static_cast<int>(std::size(s_option_threads_name)) - 1;
+	static constexpr native_char_t const s_option_pwrite_name[] = MK_TEXT("--pwrite");
+	static constexpr int const s_option_pwrite_name_len = static_cast<int>(std::size(s_option_pwrite_name)) - 1;
+	static constexpr native_char_t const s_option_huge_pages_name[] = MK_TEXT("--huge-pages");
+	static constexpr int const s_option_huge_pages_name_len = static_cast<int>(std::size(s_option_huge_pages_name)) - 1;
+	static constexpr native_char_t const s_option_copy_file_range_name[] = MK_TEXT("--copy-file-range");
+	static constexpr int const s_option_copy_file_range_name_len = static_cast<int>(std::size(s_option_copy_file_range_name)) - 1;
+	static constexpr native_char_t const s_option_stream_name[] = MK_TEXT("--stream");
+	static constexpr int const s_option_stream_name_len = static_cast<int>(std::size(s_option_stream_name)) - 1;
+	static constexpr native_char_t const s_option_uring_name[] = MK_TEXT("--uring");
+	static constexpr int const s_option_uring_name_len = static_cast<int>(std::size(s_option_uring_name)) - 1;
+	static constexpr native_char_t const s_option_direct_name[] = MK_TEXT("--direct");
+	static constexpr int const s_option_direct_name_len = static_cast<int>(std::size(s_option_direct_name)) - 1;
+	static constexpr native_char_t const s_option_no_index_name[] = MK_TEXT("--no-index");
+	static constexpr int const s_option_no_index_name_len = static_cast<int>(std::size(s_option_no_index_name)) - 1;
+	static constexpr native_char_t const s_option_start_name[] = MK_TEXT("--start");
+	static constexpr int const s_option_start_name_len = static_cast<int>(std::size(s_option_start_name)) - 1;
+	static constexpr native_char_t const s_option_end_name[] = MK_TEXT("--end");
+	static constexpr int const s_option_end_name_len = static_cast<int>(std::size(s_option_end_name)) - 1;
+	static constexpr native_char_t const s_option_topic_name[] = MK_TEXT("--topic");
+	static constexpr int const s_option_topic_name_len = static_cast<int>(std::size(s_option_topic_name)) - 1;
+	static constexpr native_char_t const s_option_all_lidars_name[] = MK_TEXT("--all-lidars");
+	static constexpr int const s_option_all_lidars_name_len = static_cast<int>(std::size(s_option_all_lidars_name)) - 1;
+	static constexpr int const s_max_threads_count = 1024;
+
+	assert(out_options);
+	pcap_options_t& options = *out_options;
+
+	options.m_threads_count = 0;
+	options.m_pwrite = false;
+	options.m_huge_pages = false;
+	options.m_copy_file_range = false;
+	options.m_stream = false;
+	options.m_uring = false;
+	options.m_direct = false;
+	options.m_index = true;
+	options.m_window.m_start = 0;
+	options.m_window.m_end = std::numeric_limits<std::uint64_t>::max();
+	options.m_topics.clear();
+	options.m_all_lidars = false;
+	for(int i = 0; i != argc; ++i)
+	{
+		if(mk::command_line::is_equal(argv[i], s_option_threads_name, s_option_threads_name_len))
+		{
+			CHECK_RET_F(i + 1 != argc);
+			++i;
+			bool const parsed = mk::command_line::parse_int(argv[i], 1, s_max_threads_count, &options.m_threads_count);
+			CHECK_RET_F(parsed);
+		}
+		else if(mk::command_line::is_equal(argv[i], s_option_pwrite_name, s_option_pwrite_name_len))
+		{
+			options.m_pwrite = true;
+		}
+		else if(mk::command_line::is_equal(argv[i], s_option_huge_pages_name, s_option_huge_pages_name_len))
+		{
+			options.m_huge_pages = true;
+		}
+		else if(mk::command_line::is_equal(argv[i], s_option_copy_file_range_name, s_option_copy_file_range_name_len))
+		{
+			options.m_copy_file_range = true;
+		}
+		else if(mk::command_line::is_equal(argv[i], s_option_stream_name, s_option_stream_name_len))
+		{
+			options.m_stream = true;
+		}
+		else if(mk::command_line::is_equal(argv[i], s_option_uring_name, s_option_uring_name_len))
+		{
+			#ifndef _MSC_VER
+			options.m_uring = true;
+			#else
+			return false;
+			#endif
+		}
+		else if(mk::command_line::is_equal(argv[i], s_option_direct_name, s_option_direct_name_len))
+		{
+			options.m_direct = true;
+		}
+		else if(mk::command_line::is_equal(argv[i], s_option_no_index_name, s_option_no_index_name_len))
+		{
+			options.m_index = false;
+		}
+		else if(mk::command_line::is_equal(argv[i], s_option_start_name, s_option_start_name_len))
+		{
+			CHECK_RET_F(i + 1 != argc);
+			++i;
+			bool const parsed = mk::command_line::parse_time(argv[i], &options.m_window.m_start);
+			CHECK_RET_F(parsed);
+		}
+		else if(mk::command_line::is_equal(argv[i], s_option_end_name, s_option_end_name_len))
+		{
+			CHECK_RET_F(i + 1 != argc);
+			++i;
+			bool const parsed = mk::command_line::parse_time(argv[i], &options.m_window.m_end);
+			CHECK_RET_F(parsed);
+		}
+		else if(mk::command_line::is_equal(argv[i], s_option_topic_name, s_option_topic_name_len))
+		{
+			CHECK_RET_F(i + 1 != argc);
+			++i;
+			options.m_topics.push_back(argv[i]);
+		}
+		else if(mk::command_line::is_equal(argv[i], s_option_all_lidars_name, s_option_all_lidars_name_len))
+		{
+			options.m_all_lidars = true;
+		}
+		else
+		{
+			return false;
+		}
+	}
+	// Direct output is written in whole blocks from one staging buffer, it can not be scattered by threads.
+	CHECK_RET_F(!(options.m_direct && options.m_pwrite));
+	CHECK_RET_F(!(options.m_direct && options.m_uring));
+	// Packets of chunks on the edge of the time window are not known until the chunk is decompressed, there is nothing to lay out up front.
+	CHECK_RET_F(options.m_window.m_start <= options.m_window.m_end);
+	CHECK_RET_F(!(is_time_window_set(options.m_window) && options.m_pwrite));
+	CHECK_RET_F(!(options.m_all_lidars && !options.m_topics.empty()));
+
+	return true;
+}
+
+bool mk::bag_tool::detail::is_time_window_set(time_window_t const& window)
+{
+	return window.m_start != 0 || window.m_end != std::numeric_limits<std::uint64_t>::max();
+}
+
+bool mk::bag_tool::detail::is_in_time_window(time_window_t const& window, std::uint64_t const time)
+{
+	std::uint64_t const time_ns = mk::bag::get_time_ns(time);
+	return time_ns >= window.m_start && time_ns <= window.m_end;
+}
+
+void mk::bag_tool::detail::drop_chunks_outside_time_window(time_window_t const& window, std::vector<chunk_entry_t>& chunk_entries)
+{
+	if(!is_time_window_set(window))
+	{
+		return;
+	}
+	// Chunk info tells time span of each chunk, chunks wholly outside of the window are never read nor decompressed.
+	auto const it = std::remove_if(chunk_entries.begin(), chunk_entries.end(), [&](chunk_entry_t const& chunk_entry)
+	{
+		return mk::bag::get_time_ns(chunk_entry.m_chunk_info.m_end_time) < window.m_start || mk::bag::get_time_ns(chunk_entry.m_chunk_info.m_start_time) > window.m_end;
+	});
+	chunk_entries.erase(it, chunk_entries.end());
+}
+
+bool mk::bag_tool::detail::is_fan_out(pcap_options_t const& options)
+{
+	return options.m_all_lidars || options.m_topics.size() > 1;
+}
 
-bool mk::bag_tool::detail::bag_to_pcap(native_char_t const* const input_bag, native_char_t const* const output_pcap)
+bool mk::bag_tool::detail::is_topic_equal(mk::bag::string_t const& topic, native_char_t const* const name)
 {
+	assert(name);
+
+	std::size_t const name_len = native_strlen(name);
+	if(static_cast<std::size_t>(topic.m_len) != name_len)
+	{
+		return false;
+	}
+	return std::equal(topic.m_begin, topic.m_begin + topic.m_len, name, [](char const a, native_char_t const b){ return static_cast<native_char_t>(static_cast<unsigned char>(a)) == b; });
+}
+
+bool mk::bag_tool::detail::is_lidar_topic_selected(mk::bag::string_t const& topic, pcap_options_t const& options, std::size_t const lidars_count, bool* const out_selected)
+{
+	assert(out_selected);
+	bool& selected = *out_selected;
+
+	if(!options.m_topics.empty())
+	{
+		selected = std::any_of(options.m_topics.cbegin(), options.m_topics.cend(), [&](native_char_t const* const name){ return is_topic_equal(topic, name); });
+		return true;
+	}
+	bool is_ouster;
+	bool const filtered = is_topic_ouster_lidar_packets(topic, &is_ouster);
+	CHECK_RET_F(filtered);
+	// Without being told otherwise the first lidar wins, packets of any other one are skipped.
+	selected = is_ouster && (options.m_all_lidars || lidars_count == 0);
+
+	return true;
+}
+
+bool mk::bag_tool::detail::add_lidar(std::uint32_t const conn, mk::bag::string_t const& topic, native_char_t const* const output_pcap, pcap_options_t const& options, std::vector<lidar_t>* const out_lidars)
+{
+	assert(out_lidars);
+	std::vector<lidar_t>& lidars = *out_lidars;
+
+	lidar_t lidar;
+	lidar.m_conn = conn;
+	lidar.m_output_pcap = get_lidar_pcap_path(output_pcap, topic, options);
+	auto const is_taken = [&](){ return std::any_of(lidars.cbegin(), lidars.cend(), [&](lidar_t const& e){ return e.m_output_pcap == lidar.m_output_pcap; }); };
+	if(is_fan_out(options) && is_taken())
+	{
+		// "/os1_node/lidar_packets" and "os1_node/lidar_packets" make the same name, tell them apart by connection.
+		std::string const unique_topic = std::string{topic.m_begin, topic.m_begin + topic.m_len} + "_" + std::to_string(conn);
+		lidar.m_output_pcap = get_lidar_pcap_path(output_pcap, mk::bag::string_t{unique_topic.c_str(), static_cast<int>(unique_topic.size())}, options);
+	}
+	// Single output can not take two lidars.
+	CHECK_RET_F(!is_taken());
+	CHECK_RET_F(std::none_of(lidars.cbegin(), lidars.cend(), [&](lidar_t const& e){ return e.m_conn == lidar.m_conn; }));
+	lidars.push_back(std::move(lidar));
+
+	return true;
+}
+
+std::basic_string<native_char_t> mk::bag_tool::detail::get_lidar_pcap_path(native_char_t const* const output_pcap, mk::bag::string_t const& topic, pcap_options_t const& options)
+{
+	if(!is_fan_out(options))
+	{
+		return output_pcap;
+	}
+	return get_topic_output_path(output_pcap, topic);
+}
+
+std::basic_string<native_char_t> mk::bag_tool::detail::get_topic_output_path(native_char_t const* const output, mk::bag::string_t const& topic)
+{
+	// "out.pcap" and "/os_node_1/lidar_packets" make "out.os_node_1_lidar_packets.pcap".
+	std::basic_string<native_char_t> path = output;
+	std::basic_string<native_char_t> name;
+	for(int i = 0; i != topic.m_len; ++i)
+	{
+		char const c = topic.m_begin[i];
+		bool const is_plain = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '-' || c == '_';
+		if(!is_plain && name.empty())
+		{
+			continue;
+		}
+		name.push_back(is_plain ? static_cast<native_char_t>(c) : MK_TEXT('_'));
+	}
+	std::size_t const separator_pos = path.find_last_of(MK_TEXT("/\\"));
+	std::size_t const dot_pos = path.find_last_of(MK_TEXT('.'));
+	bool const has_extension = dot_pos != path.npos && (separator_pos == path.npos || dot_pos > separator_pos);
+	std::size_t const insert_pos = has_extension ? dot_pos : path.size();
+	path.insert(insert_pos, MK_TEXT(".") + name);
+
+	return path;
+}
+
+
+bool mk::bag_tool::detail::bag_to_pcap(native_char_t const* const input_bag, native_char_t const* const output_pcap, pcap_options_t const& options)
+{
+	// Compressed bags are unpacked on the fly, the record parser sees them as a forward only stream.
+	bool compressed;
+	bool const sniffed = mk::data_source_pipe_t::is_compressed(input_bag, &compressed);
+	CHECK_RET_F(sniffed);
+	if(mk::data_source_pipe_t::is_stdin(input_bag) || compressed)
+	{
+		mk::data_source_pipe_t data_source_pipe = mk::data_source_pipe_t::make(input_bag);
+		CHECK_RET_F(data_source_pipe);
+		bool const converted = bag_to_pcap_pipe(data_source_pipe, output_pcap, options);
+		CHECK_RET_F(converted);
+		CHECK_RET_F(!data_source_pipe.get_input_failed());
+		return true;
+	}
+
+	// Sidecar index spares the walk over the index section and over index data of every chunk, it is made on the first run.
+	// Making it maps the bag and pages it in, which --direct is there to avoid, direct reads only use the sidecar when there already is one.
+	mk::bag_index_file_t index_file;
+	if(options.m_index)
+	{
+		index_file = options.m_direct ? mk::bag_index_file_t::load(input_bag) : mk::bag_index_file_t::open(input_bag);
+	}
+
+	#ifndef _MSC_VER
+	if(options.m_uring)
+	{
+		mk::data_source_uring_t data_source_uring = mk::data_source_uring_t::make(input_bag);
+		CHECK_RET_F(data_source_uring);
+		bool const converted = bag_to_pcap(data_source_uring, nullptr, index_file, output_pcap, options);
+		CHECK_RET_F(converted);
+		return true;
+	}
+	#endif
+
+	if(options.m_direct)
+	{
+		mk::data_source_direct_t data_source_direct = mk::data_source_direct_t::make(input_bag);
+		CHECK_RET_F(data_source_direct);
+		bool const converted = bag_to_pcap(data_source_direct, nullptr, index_file, output_pcap, options);
+		CHECK_RET_F(converted);
+		return true;
+	}
+
 	mk::read_only_memory_mapped_file_t const rommf{input_bag};
 	if(rommf)
 	{
 		mk::data_source_mem_t data_source_mem = mk::data_source_mem_t::make(rommf.get_data(), static_cast<std::size_t>(rommf.get_size()));
 		CHECK_RET_F(data_source_mem);
-		bool const converted = bag_to_pcap(data_source_mem, output_pcap);
+		bool const converted = bag_to_pcap(data_source_mem, &rommf, index_file, output_pcap, options);
 		CHECK_RET_F(converted);
 		return true;
 	}
@@ -41,36 +411,94 @@ bool mk::bag_tool::detail::bag_to_pcap(native_char_t const* const input_bag, nat
 	{
 		mk::data_source_rommf_t data_source_rommf = mk::data_source_rommf_t::make(input_bag);
 		CHECK_RET_F(data_source_rommf);
-		bool const converted = bag_to_pcap(data_source_rommf, output_pcap);
+		bool const converted = bag_to_pcap(data_source_rommf, nullptr, index_file, output_pcap, options);
 		CHECK_RET_F(converted);
 		return true;
 	}
 }
 
 template<typename data_source_t>
-bool mk::bag_tool::detail::bag_to_pcap(data_source_t& data_source, native_char_t const* const output_pcap)
+bool mk::bag_tool::detail::bag_to_pcap(data_source_t& data_source, mk::read_only_memory_mapped_file_t const* const input_file, mk::bag_index_file_t const& index_file, native_char_t const* const output_pcap, pcap_options_t const& options)
 {
 	CHECK_RET_F(mk::bag::is_bag_file(data_source));
 	data_source.consume(mk::bag::bag_file_header_len());
 
-	std::uint32_t ouster_channel;
-	bool const got_ouster_channel = get_ouster_channel(data_source, &ouster_channel);
-	CHECK_RET_F(got_ouster_channel);
+	std::vector<lidar_t> lidars;
+	std::vector<chunk_entry_t> chunk_entries;
+	if(index_file)
+	{
+		bool const got_chunk_entries = get_indexed_chunk_entries(index_file, output_pcap, options, &lidars, &chunk_entries);
+		CHECK_RET_F(got_chunk_entries);
+	}
+	else
+	{
+		bool const got_lidars = get_lidars(data_source, output_pcap, options, &lidars);
+		CHECK_RET_F(got_lidars);
 
-	g_time = std::chrono::milliseconds{0};
-	g_ofs = std::ofstream{output_pcap, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc};
+		data_source.move_to(0, mk::bag::bag_file_header_len());
+		data_source.consume(mk::bag::bag_file_header_len());
+		bool const got_chunk_entries = get_chunk_entries(data_source, &chunk_entries);
+		CHECK_RET_F(got_chunk_entries);
+	}
+	std::vector<std::uint32_t> ouster_channels(lidars.size());
+	std::transform(lidars.cbegin(), lidars.cend(), ouster_channels.begin(), [](lidar_t const& lidar){ return lidar.m_conn; });
+	drop_chunks_outside_time_window(options.m_window, chunk_entries);
+	schedule_chunk_reads(data_source, chunk_entries, ouster_channels);
+
+	bool is_bz2;
+	bool const got_is_bz2 = is_ouster_chunk_bz2(data_source, chunk_entries, ouster_channels, &is_bz2);
+	CHECK_RET_F(got_is_bz2);
+	int const threads_count = get_threads_count(options, is_bz2);
+
+	// Every lidar gets its own output, all of them are filled in one pass over the bag.
+	std::vector<pcap_sink_t> sinks(lidars.size());
+	for(std::size_t i = 0; i != lidars.size(); ++i)
+	{
+		bool const opened = open_pcap_sink(lidars[i].m_output_pcap.c_str(), input_file, options, &sinks[i]);
+		CHECK_RET_F(opened);
+	}
 
-	struct pcap_hdr_t
+	if(options.m_pwrite)
 	{
-		std::uint32_t magic_number; /* magic number */
-		std::uint16_t version_major; /* major version number */
-		std::uint16_t version_minor; /* minor version number */
-		std::int32_t thiszone; /* GMT to local correction */
-		std::uint32_t sigfigs; /* accuracy of timestamps */
-		std::uint32_t snaplen; /* max length of captured packets, in octets */
-		std::uint32_t network; /* data link type */
-	};
-	static_assert(sizeof(pcap_hdr_t) == 24);
+		// Index counts every message of the lidar, packets of unexpected size among them are not written, the file is cut to its real size at the end.
+		for(std::size_t i = 0; i != lidars.size(); ++i)
+		{
+			std::uint64_t packets_count = 0;
+			for(chunk_entry_t const& chunk_entry : chunk_entries)
+			{
+				packets_count += get_chunk_connection_count(chunk_entry, ouster_channels[i]);
+			}
+			bool const preallocated = sinks[i].m_file.preallocate(sizeof(pcap_hdr_t) + packets_count * s_ouster_packet_len);
+			CHECK_RET_F(preallocated);
+		}
+	}
+
+	if(threads_count == 1 && !options.m_pwrite)
+	{
+		bool const ouster_records_processed = process_ouster_records(data_source, chunk_entries, ouster_channels, options.m_window, options.m_huge_pages, sinks);
+		CHECK_RET_F(ouster_records_processed);
+	}
+	else
+	{
+		bool const ouster_records_processed = process_ouster_records_parallel(data_source, chunk_entries, ouster_channels, options.m_window, threads_count, options.m_huge_pages, options.m_pwrite, sinks);
+		CHECK_RET_F(ouster_records_processed);
+	}
+	for(pcap_sink_t& sink : sinks)
+	{
+		bool const flushed = flush_output(sink);
+		CHECK_RET_F(flushed);
+		if(options.m_pwrite)
+		{
+			bool const truncated = sink.m_file.truncate(sizeof(pcap_hdr_t) + sink.m_packets_count * s_ouster_packet_len);
+			CHECK_RET_F(truncated);
+		}
+	}
+
+	return true;
+}
+
+bool mk::bag_tool::detail::open_pcap_sink(native_char_t const* const output_pcap, mk::read_only_memory_mapped_file_t const* const input_file, pcap_options_t const& options, pcap_sink_t* const out_sink)
+{
 	pcap_hdr_t pcap_hdr;
 	pcap_hdr.magic_number = 0xa1b2c3d4;
 	pcap_hdr.version_major = 2;
@@ -79,23 +507,242 @@ bool mk::bag_tool::detail::bag_to_pcap(data_source_t& data_source, native_char_t
 	pcap_hdr.sigfigs = 0;
 	pcap_hdr.snaplen = 64 * 1024;
 	pcap_hdr.network = 1;
-	g_ofs.write(reinterpret_cast<char const*>(&pcap_hdr), sizeof(pcap_hdr));
 
-	data_source.move_to(0, mk::bag::bag_file_header_len());
+	assert(out_sink);
+	pcap_sink_t& sink = *out_sink;
+
+	sink.m_file = mk::write_only_file_t{output_pcap, options.m_direct};
+	CHECK_RET_F(sink.m_file);
+	sink.m_input_file = input_file;
+	sink.m_copy_file_range = options.m_copy_file_range;
+	sink.m_stream = options.m_stream;
+	sink.m_packets_count = 0;
+	sink.m_input_dropped = 0;
+	sink.m_output_flushed = 0;
+	sink.m_output_dropped = 0;
+	sink.m_direct = options.m_direct;
+	sink.m_staged = 0;
+	sink.m_staging_offset = 0;
+	if(sink.m_direct)
+	{
+		sink.m_staging = mk::raw_buffer_t{options.m_huge_pages};
+		bool const reserved = sink.m_staging.reserve(s_direct_staging_size);
+		CHECK_RET_F(reserved);
+	}
+	if(sink.m_stream && sink.m_input_file != nullptr)
+	{
+		bool const advised = sink.m_input_file->advise_sequential();
+		CHECK_RET_F(advised);
+	}
+
+	mk::write_only_file_buffer_t const pcap_hdr_buffer{&pcap_hdr, sizeof(pcap_hdr)};
+	bool const written = sink.m_direct ? stage_output(sink, &pcap_hdr_buffer, 1) : sink.m_file.write_at(0, &pcap_hdr, sizeof(pcap_hdr));
+	CHECK_RET_F(written);
+
+	return true;
+}
+
+bool mk::bag_tool::detail::bag_to_pcap_pipe(mk::data_source_pipe_t& data_source, native_char_t const* const output_pcap, pcap_options_t const& options)
+{
+	static constexpr auto const s_record_callback = [](void* const ctx_, void* const data, [[maybe_unused]] bool& keep_iterating) -> bool
+	{
+		pipe_ctx_t& ctx = *static_cast<pipe_ctx_t*>(ctx_);
+		mk::bag::record_t const& record = *static_cast<mk::bag::record_t const*>(data);
+
+		bool const is_index_data = std::visit(mk::make_overload([](mk::bag::header::index_data_t const&) -> bool { return true; }, [](...) -> bool { return false; }), record.m_header);
+		if(is_index_data)
+		{
+			mk::bag::header::index_data_t const& index_data = std::get<mk::bag::header::index_data_t>(record.m_header);
+			if(!ctx.m_chunk.m_pending)
+			{
+				return true;
+			}
+			ctx.m_chunk.m_index_seen = true;
+			if(ctx.m_chunk.m_indexed)
+			{
+				return true;
+			}
+			bool const is_known = std::find(ctx.m_connections.cbegin(), ctx.m_connections.cend(), index_data.m_conn) != ctx.m_connections.cend();
+			if(!is_known)
+			{
+				// Its connection record is inside of the chunk, whether it is a lidar we are after is not known until then.
+				pcap_options_t const& options = ctx.m_options;
+				ctx.m_chunk.m_indexed = options.m_all_lidars || (options.m_topics.empty() ? ctx.m_lidars.empty() : ctx.m_lidars.size() < options.m_topics.size());
+				return true;
+			}
+			bool const is_lidar = std::find(ctx.m_ouster_channels.cbegin(), ctx.m_ouster_channels.cend(), index_data.m_conn) != ctx.m_ouster_channels.cend();
+			if(!is_lidar)
+			{
+				return true;
+			}
+			for(std::uint32_t i = 0; i != index_data.m_count; ++i)
+			{
+				mk::bag::data::index_data_ver_1_t index_entry;
+				bool const parsed = mk::bag::parse_index_data_data(record, i, &index_entry);
+				CHECK_RET_F(parsed);
+				if(is_in_time_window(ctx.m_options.m_window, index_entry.m_time))
+				{
+					ctx.m_chunk.m_indexed = true;
+					break;
+				}
+			}
+			return true;
+		}
+
+		// Anything else than index_data means all index_data of the held chunk went by.
+		bool const processed = process_pipe_chunk(ctx);
+		CHECK_RET_F(processed);
+
+		bool const is_chunk = std::visit(mk::make_overload([](mk::bag::header::chunk_t const&) -> bool { return true; }, [](...) -> bool { return false; }), record.m_header);
+		if(!is_chunk)
+		{
+			return true;
+		}
+		mk::bag::header::chunk_t const& chunk = std::get<mk::bag::header::chunk_t>(record.m_header);
+
+		// The view moves on with the next record, keep a copy.
+		ctx.m_chunk.m_pending = true;
+		ctx.m_chunk.m_index_seen = false;
+		ctx.m_chunk.m_indexed = false;
+		ctx.m_chunk.m_compression.assign(chunk.m_compression.m_begin, chunk.m_compression.m_begin + chunk.m_compression.m_len);
+		ctx.m_chunk.m_size = chunk.m_size;
+		ctx.m_chunk.m_chunk_data.assign(record.m_data.m_begin, record.m_data.m_begin + record.m_data.m_len);
+
+		return true;
+	};
+	mk::bag::callback_t const callback = s_record_callback;
+
+	// Packets count is not known up front and chunks are decompressed in the order they flow in.
+	CHECK_RET_F(!options.m_pwrite);
+	CHECK_RET_F(options.m_threads_count <= 1);
+
+	CHECK_RET_F(mk::bag::is_bag_file(data_source));
 	data_source.consume(mk::bag::bag_file_header_len());
-	bool const ouster_records_processed = process_ouster_records(data_source, ouster_channel);
-	CHECK_RET_F(ouster_records_processed);
 
-	g_ofs.close();
+	pipe_ctx_t ctx{output_pcap, options, {}, {}, {}, {}, pipe_chunk_t{}, chunk_decompressor_t{}, {}};
+	ctx.m_chunk.m_pending = false;
+	ctx.m_decompressor.m_buffer = mk::raw_buffer_t{options.m_huge_pages};
+	bool const parsed = mk::bag::parse_records(data_source, callback, &ctx);
+	CHECK_RET_F(parsed);
+	// Bag without index section ends with a chunk.
+	bool const processed = process_pipe_chunk(ctx);
+	CHECK_RET_F(processed);
+	CHECK_RET_F(!ctx.m_lidars.empty());
+	CHECK_RET_F(options.m_topics.empty() || ctx.m_lidars.size() == options.m_topics.size());
+
+	for(pcap_sink_t& sink : ctx.m_sinks)
+	{
+		bool const flushed = flush_output(sink);
+		CHECK_RET_F(flushed);
+	}
+
+	return true;
+}
+
+bool mk::bag_tool::detail::process_pipe_chunk(pipe_ctx_t& ctx)
+{
+	static constexpr auto const s_record_callback = [](void* const ctx_, void* const data, [[maybe_unused]] bool& keep_iterating) -> bool
+	{
+		pipe_ctx_t& ctx = *static_cast<pipe_ctx_t*>(ctx_);
+		mk::bag::record_t const& record = *static_cast<mk::bag::record_t const*>(data);
+
+		// There is no seeking to the index section, connection records stored inside of chunks have to do.
+		bool const is_connection = std::visit(mk::make_overload([](mk::bag::header::connection_t const&) -> bool { return true; }, [](...) -> bool { return false; }), record.m_header);
+		if(is_connection)
+		{
+			bool const processed = process_pipe_connection(ctx, record);
+			CHECK_RET_F(processed);
+			return true;
+		}
+
+		if(ctx.m_lidars.empty())
+		{
+			return true;
+		}
+		bool const processed = process_inner_ouster_record(record, ctx.m_ouster_channels, ctx.m_options.m_window, &ctx.m_packets);
+		CHECK_RET_F(processed);
+
+		return true;
+	};
+	mk::bag::callback_t const callback = s_record_callback;
+
+	pipe_chunk_t& pipe_chunk = ctx.m_chunk;
+	if(!pipe_chunk.m_pending)
+	{
+		return true;
+	}
+	pipe_chunk.m_pending = false;
+	// Index says there is nothing of ours in this chunk, do not bother decompressing it.
+	if(pipe_chunk.m_index_seen && !pipe_chunk.m_indexed)
+	{
+		return true;
+	}
+
+	mk::bag::record_t record;
+	mk::bag::header::chunk_t chunk;
+	chunk.m_compression.m_begin = pipe_chunk.m_compression.data();
+	chunk.m_compression.m_len = static_cast<int>(pipe_chunk.m_compression.size());
+	chunk.m_size = pipe_chunk.m_size;
+	record.m_header = chunk;
+	record.m_data.m_begin = pipe_chunk.m_chunk_data.data();
+	record.m_data.m_len = static_cast<int>(pipe_chunk.m_chunk_data.size());
+
+	void const* decompressed_data;
+	bool const decompressed = decompress_record_chunk_data(record, ctx.m_decompressor, &decompressed_data);
+	CHECK_RET_F(decompressed);
+
+	for(ouster_packets_t& packets : ctx.m_packets)
+	{
+		packets.m_headers.clear();
+		packets.m_payloads.clear();
+		packets.m_count = 0;
+	}
+	mk::data_source_mem_t data_source = mk::data_source_mem_t::make(decompressed_data, chunk.m_size);
+	bool const parsed = mk::bag::parse_records(data_source, callback, &ctx);
+	CHECK_RET_F(parsed);
+	bool const committed = commit_lidars_packets(ctx.m_sinks, ctx.m_packets);
+	CHECK_RET_F(committed);
+
+	return true;
+}
+
+bool mk::bag_tool::detail::process_pipe_connection(pipe_ctx_t& ctx, mk::bag::record_t const& record)
+{
+	assert(std::visit(mk::make_overload([](mk::bag::header::connection_t const&) -> bool { return true; }, [](...) -> bool { return false; }), record.m_header));
+	mk::bag::header::connection_t const& connection = std::get<mk::bag::header::connection_t>(record.m_header);
+
+	bool const is_known = std::find(ctx.m_connections.cbegin(), ctx.m_connections.cend(), connection.m_conn) != ctx.m_connections.cend();
+	if(is_known)
+	{
+		return true;
+	}
+	ctx.m_connections.push_back(connection.m_conn);
+
+	bool is_selected;
+	bool const filtered = is_lidar_topic_selected(connection.m_topic, ctx.m_options, ctx.m_lidars.size(), &is_selected);
+	CHECK_RET_F(filtered);
+	if(!is_selected)
+	{
+		return true;
+	}
+	bool const added = add_lidar(connection.m_conn, connection.m_topic, ctx.m_output_pcap, ctx.m_options, &ctx.m_lidars);
+	CHECK_RET_F(added);
+	ctx.m_ouster_channels.push_back(connection.m_conn);
+
+	// Outputs are opened as their lidars show up.
+	ctx.m_sinks.emplace_back();
+	bool const opened = open_pcap_sink(ctx.m_lidars.back().m_output_pcap.c_str(), nullptr, ctx.m_options, &ctx.m_sinks.back());
+	CHECK_RET_F(opened);
+	ctx.m_packets.emplace_back();
 
 	return true;
 }
 
 template<typename data_source_t>
-bool mk::bag_tool::detail::get_ouster_channel(data_source_t& data_source, std::uint32_t* const out_ouster_channel)
+bool mk::bag_tool::detail::get_lidars(data_source_t& data_source, native_char_t const* const output_pcap, pcap_options_t const& options, std::vector<lidar_t>* const out_lidars)
 {
-	assert(out_ouster_channel);
-	std::uint32_t& ouster_channel = *out_ouster_channel;
+	assert(out_lidars);
+	std::vector<lidar_t>& lidars = *out_lidars;
 
 	std::uint64_t connections_offset;
 	bool const got_connections_offset = get_connections_offset(data_source, &connections_offset);
@@ -103,9 +750,16 @@ bool mk::bag_tool::detail::get_ouster_channel(data_source_t& data_source, std::u
 	CHECK_RET_F(connections_offset < data_source.get_input_size());
 	data_source.move_to(connections_offset, 1);
 
+	struct helper_struct_t
+	{
+		native_char_t const* m_output_pcap;
+		pcap_options_t const& m_options;
+		std::vector<lidar_t>& m_lidars;
+	};
+
 	static constexpr auto const s_record_callback = [](void* const ctx, void* const data, bool& keep_iterating) -> bool
 	{
-		std::optional<std::uint32_t>& ouster_channel_opt = *static_cast<std::optional<std::uint32_t>*>(ctx);
+		helper_struct_t& helper = *static_cast<helper_struct_t*>(ctx);
 		mk::bag::record_t const& record = *static_cast<mk::bag::record_t const*>(data);
 
 		bool const is_connection = std::visit(mk::make_overload([](mk::bag::header::connection_t const&) -> bool { return true; }, [](...) -> bool { return false; }), record.m_header);
@@ -114,185 +768,715 @@ bool mk::bag_tool::detail::get_ouster_channel(data_source_t& data_source, std::u
 			keep_iterating = false;
 			return true;
 		}
+		mk::bag::header::connection_t const& connection = std::get<mk::bag::header::connection_t>(record.m_header);
+
+		bool is_selected;
+		bool const filtered = is_lidar_topic_selected(connection.m_topic, helper.m_options, helper.m_lidars.size(), &is_selected);
+		CHECK_RET_F(filtered);
+		if(!is_selected)
+		{
+			return true;
+		}
+		bool const added = add_lidar(connection.m_conn, connection.m_topic, helper.m_output_pcap, helper.m_options, &helper.m_lidars);
+		CHECK_RET_F(added);
+
+		return true;
+	};
+	mk::bag::callback_t const callback = s_record_callback;
+
+	lidars.clear();
+	helper_struct_t helper{output_pcap, options, lidars};
+	bool const file_parsed = mk::bag::parse_records(data_source, callback, &helper);
+	CHECK_RET_F(file_parsed);
+
+	CHECK_RET_F(!lidars.empty());
+	CHECK_RET_F(options.m_topics.empty() || lidars.size() == options.m_topics.size());
+
+	return true;
+}
+
+template<typename data_source_t>
+bool mk::bag_tool::detail::get_connections_offset(data_source_t& data_source, std::uint64_t* const out_connections_offset)
+{
+	assert(out_connections_offset);
+	std::uint64_t& connections_offset = *out_connections_offset;
+
+	static constexpr auto const s_record_callback = [](void* const ctx, void* const data, bool& keep_iterating) -> bool
+	{
+		assert(ctx);
+		assert(data);
+
+		std::uint64_t& connections_offset = *static_cast<std::uint64_t*>(ctx);
+		mk::bag::record_t const& record = *static_cast<mk::bag::record_t const*>(data);
+
+		bool const is_bag = std::visit(mk::make_overload([](mk::bag::header::bag_t const&) -> bool { return true; }, [](...) -> bool { return false; }), record.m_header);
+		CHECK_RET_F(is_bag);
+		mk::bag::header::bag_t const& bag = std::get<mk::bag::header::bag_t>(record.m_header);
+
+		connections_offset = bag.m_index_pos;
+		keep_iterating = false;
+
+		return true;
+	};
+	mk::bag::callback_t const callback = s_record_callback;
+
+	bool const file_parsed = mk::bag::parse_records(data_source, callback, &connections_offset);
+	CHECK_RET_F(file_parsed);
+
+	return true;
+}
+
+template<typename data_source_t>
+bool mk::bag_tool::detail::get_chunk_entries(data_source_t& data_source, std::vector<chunk_entry_t>* const out_chunk_entries)
+{
+	assert(out_chunk_entries);
+	std::vector<chunk_entry_t>& chunk_entries = *out_chunk_entries;
+
+	std::uint64_t connections_offset;
+	bool const got_connections_offset = get_connections_offset(data_source, &connections_offset);
+	CHECK_RET_F(got_connections_offset);
+	CHECK_RET_F(connections_offset < data_source.get_input_size());
+	data_source.move_to(connections_offset, 1);
+
+	static constexpr auto const s_record_callback = [](void* const ctx, void* const data, [[maybe_unused]] bool& keep_iterating) -> bool
+	{
+		std::vector<chunk_entry_t>& chunk_entries = *static_cast<std::vector<chunk_entry_t>*>(ctx);
+		mk::bag::record_t const& record = *static_cast<mk::bag::record_t const*>(data);
+
+		bool const is_chunk_info = std::visit(mk::make_overload([](mk::bag::header::chunk_info_t const&) -> bool { return true; }, [](...) -> bool { return false; }), record.m_header);
+		if(!is_chunk_info)
+		{
+			return true;
+		}
+
+		chunk_entry_t chunk_entry;
+		bool const got_chunk_entry = get_chunk_entry(record, &chunk_entry);
+		CHECK_RET_F(got_chunk_entry);
+		chunk_entries.push_back(std::move(chunk_entry));
+
+		return true;
+	};
+	mk::bag::callback_t const callback = s_record_callback;
+
+	chunk_entries.clear();
+	bool const file_parsed = mk::bag::parse_records(data_source, callback, &chunk_entries);
+	CHECK_RET_F(file_parsed);
+
+	std::sort(chunk_entries.begin(), chunk_entries.end(), [](chunk_entry_t const& a, chunk_entry_t const& b) -> bool { return a.m_chunk_info.m_chunk_pos < b.m_chunk_info.m_chunk_pos; });
+	CHECK_RET_F(std::all_of(chunk_entries.cbegin(), chunk_entries.cend(), [&](chunk_entry_t const& chunk_entry) -> bool { return chunk_entry.m_chunk_info.m_chunk_pos >= static_cast<std::uint64_t>(mk::bag::bag_file_header_len()) && chunk_entry.m_chunk_info.m_chunk_pos < connections_offset; }));
+
+	return true;
+}
+
+bool mk::bag_tool::detail::get_chunk_entry(mk::bag::record_t const& record, chunk_entry_t* const out_chunk_entry)
+{
+	assert(std::visit(mk::make_overload([](mk::bag::header::chunk_info_t const&) -> bool { return true; }, [](...) -> bool { return false; }), record.m_header));
+	assert(out_chunk_entry);
+	chunk_entry_t& chunk_entry = *out_chunk_entry;
+
+	mk::bag::header::chunk_info_t const& chunk_info = std::get<mk::bag::header::chunk_info_t>(record.m_header);
+	chunk_entry.m_chunk_info = chunk_info;
+	chunk_entry.m_connections.resize(chunk_info.m_count);
+	for(std::uint32_t i = 0; i != chunk_info.m_count; ++i)
+	{
+		bool const parsed = mk::bag::parse_chunk_info_data(record, i, &chunk_entry.m_connections[i]);
+		CHECK_RET_F(parsed);
+	}
+	chunk_entry.m_index_entries.clear();
+	chunk_entry.m_indexed = false;
+
+	return true;
+}
+
+bool mk::bag_tool::detail::get_indexed_chunk_entries(mk::bag_index_file_t const& index_file, native_char_t const* const output_pcap, pcap_options_t const& options, std::vector<lidar_t>* const out_lidars, std::vector<chunk_entry_t>* const out_chunk_entries)
+{
+	assert(index_file);
+	assert(out_lidars);
+	assert(out_chunk_entries);
+	std::vector<lidar_t>& lidars = *out_lidars;
+	std::vector<chunk_entry_t>& chunk_entries = *out_chunk_entries;
+
+	// Same pick as get_lidars, in order of the index section.
+	std::vector<std::uint32_t> lidar_connection_idxs;
+	lidars.clear();
+	for(std::uint32_t i = 0; i != index_file.get_connections_count(); ++i)
+	{
+		bool is_selected;
+		bool const filtered = is_lidar_topic_selected(index_file.get_topic(i), options, lidars.size(), &is_selected);
+		CHECK_RET_F(filtered);
+		if(!is_selected)
+		{
+			continue;
+		}
+		bool const added = add_lidar(index_file.get_connection(i).m_conn, index_file.get_topic(i), output_pcap, options, &lidars);
+		CHECK_RET_F(added);
+		lidar_connection_idxs.push_back(i);
+	}
+	CHECK_RET_F(!lidars.empty());
+	CHECK_RET_F(options.m_topics.empty() || lidars.size() == options.m_topics.size());
+
+	bool const got_chunk_entries = get_indexed_chunk_entries(index_file, lidar_connection_idxs, &chunk_entries);
+	CHECK_RET_F(got_chunk_entries);
+
+	return true;
+}
+
+bool mk::bag_tool::detail::get_indexed_chunk_entries(mk::bag_index_file_t const& index_file, std::vector<std::uint32_t> const& connection_idxs, std::vector<chunk_entry_t>* const out_chunk_entries)
+{
+	assert(index_file);
+	assert(out_chunk_entries);
+	std::vector<chunk_entry_t>& chunk_entries = *out_chunk_entries;
+
+	std::uint32_t const chunks_count = index_file.get_chunks_count();
+	chunk_entries.resize(chunks_count);
+	for(std::uint32_t i = 0; i != chunks_count; ++i)
+	{
+		mk::bag_index_file_chunk_t const& chunk = index_file.get_chunk(i);
+		chunk_entry_t& chunk_entry = chunk_entries[i];
+		chunk_entry.m_chunk_info.m_ver = chunk.m_ver;
+		chunk_entry.m_chunk_info.m_chunk_pos = chunk.m_chunk_pos;
+		chunk_entry.m_chunk_info.m_start_time = chunk.m_start_time;
+		chunk_entry.m_chunk_info.m_end_time = chunk.m_end_time;
+		chunk_entry.m_chunk_info.m_count = chunk.m_count;
+		chunk_entry.m_connections.clear();
+		chunk_entry.m_index_entries.clear();
+		chunk_entry.m_indexed = true;
+	}
+
+	// Only the given connections are ever asked about, so only their messages are spread over the chunks.
+	std::uint64_t const* const message_times = index_file.get_message_times();
+	std::uint32_t const* const message_chunks = index_file.get_message_chunks();
+	std::uint32_t const* const message_offsets = index_file.get_message_offsets();
+	for(std::uint32_t const connection_idx : connection_idxs)
+	{
+		CHECK_RET_F(connection_idx < index_file.get_connections_count());
+		mk::bag_index_file_connection_t const& connection = index_file.get_connection(connection_idx);
+		for(std::uint64_t i = 0; i != connection.m_messages_count; ++i)
+		{
+			std::uint64_t const message_idx = connection.m_first_message + i;
+			CHECK_RET_F(message_chunks[message_idx] < chunks_count);
+			chunk_entry_t& chunk_entry = chunk_entries[message_chunks[message_idx]];
+			chunk_entry.m_index_entries.push_back(mk::bag::data::index_data_ver_1_t{message_times[message_idx], message_offsets[message_idx]});
+			if(chunk_entry.m_connections.empty() || chunk_entry.m_connections.back().m_conn != connection.m_conn)
+			{
+				chunk_entry.m_connections.push_back(mk::bag::data::chunk_info_ver_1_t{connection.m_conn, 0});
+			}
+			++chunk_entry.m_connections.back().m_count;
+		}
+	}
+	for(chunk_entry_t& chunk_entry : chunk_entries)
+	{
+		std::sort(chunk_entry.m_index_entries.begin(), chunk_entry.m_index_entries.end(), [](mk::bag::data::index_data_ver_1_t const& a, mk::bag::data::index_data_ver_1_t const& b) -> bool { return a.m_offset < b.m_offset; });
+	}
+
+	return true;
+}
+
+template<typename data_source_t>
+void mk::bag_tool::detail::schedule_chunk_reads([[maybe_unused]] data_source_t& data_source, [[maybe_unused]] std::vector<chunk_entry_t> const& chunk_entries, [[maybe_unused]] std::vector<std::uint32_t> const& ouster_channels)
+{
+	// Mapped sources fault pages in on demand, they have nothing to schedule.
+}
+
+#ifndef _MSC_VER
+void mk::bag_tool::detail::schedule_chunk_reads(mk::data_source_uring_t& data_source, std::vector<chunk_entry_t> const& chunk_entries, std::vector<std::uint32_t> const& ouster_channels)
+{
+	// Each read spans the chunk record together with its index data records, that is everything up to the next chunk.
+	// Without sidecar index the index data records are read until the record past them, the next chunk. When that one is not read anyway, it is read here too.
+	std::vector<mk::data_source_uring_range_t> schedule;
+	auto const chunk_end = [&](std::size_t const idx){ return idx < chunk_entries.size() ? chunk_entries[idx].m_chunk_info.m_chunk_pos : data_source.get_input_size(); };
+	for(std::size_t i = 0; i != chunk_entries.size(); ++i)
+	{
+		if(get_chunk_messages_count(chunk_entries[i], ouster_channels) == 0)
+		{
+			continue;
+		}
+		bool const peeks_past = !chunk_entries[i].m_indexed && i + 1 != chunk_entries.size() && get_chunk_messages_count(chunk_entries[i + 1], ouster_channels) == 0;
+		std::uint64_t const begin = chunk_entries[i].m_chunk_info.m_chunk_pos;
+		std::uint64_t const end = chunk_end(peeks_past ? i + 2 : i + 1);
+		schedule.push_back(mk::data_source_uring_range_t{begin, end});
+	}
+	data_source.set_schedule(std::move(schedule));
+}
+#endif
+
+std::uint32_t mk::bag_tool::detail::get_chunk_connection_count(chunk_entry_t const& chunk_entry, std::uint32_t const connection)
+{
+	auto const it = std::find_if(chunk_entry.m_connections.cbegin(), chunk_entry.m_connections.cend(), [&](mk::bag::data::chunk_info_ver_1_t const& e){ return e.m_conn == connection; });
+	if(it == chunk_entry.m_connections.cend())
+	{
+		return 0;
+	}
+	return it->m_count;
+}
+
+std::uint64_t mk::bag_tool::detail::get_chunk_messages_count(chunk_entry_t const& chunk_entry, std::vector<std::uint32_t> const& connections)
+{
+	std::uint64_t count = 0;
+	for(std::uint32_t const connection : connections)
+	{
+		count += get_chunk_connection_count(chunk_entry, connection);
+	}
+	return count;
+}
+
+bool mk::bag_tool::detail::is_topic_ouster_lidar_packets(mk::bag::string_t const& topic, bool* const out_satisfies)
+{
+	static constexpr char const s_topic_ouster_0_lidar_packets_name[] = "/os_node/lidar_packets";
+	static constexpr int const s_topic_ouster_0_lidar_packets_name_len = static_cast<int>(std::size(s_topic_ouster_0_lidar_packets_name)) - 1;
+	static constexpr char const s_topic_ouster_1a_lidar_packets_name[] = "/os1_node/lidar_packets";
+	static constexpr int const s_topic_ouster_1a_lidar_packets_name_len = static_cast<int>(std::size(s_topic_ouster_1a_lidar_packets_name)) - 1;
+	static constexpr char const s_topic_ouster_1b_lidar_packets_name[] = "os1_node/lidar_packets";
+	static constexpr int const s_topic_ouster_1b_lidar_packets_name_len = static_cast<int>(std::size(s_topic_ouster_1b_lidar_packets_name)) - 1;
+
+	assert(out_satisfies);
+	bool& satisfies = *out_satisfies;
+
+	bool const is_ouster_0 = topic.m_len == s_topic_ouster_0_lidar_packets_name_len && std::memcmp(topic.m_begin, s_topic_ouster_0_lidar_packets_name, s_topic_ouster_0_lidar_packets_name_len) == 0;
+	if(is_ouster_0)
+	{
+		satisfies = true;
+		return true;
+	}
+	bool const is_ouster_1a = topic.m_len == s_topic_ouster_1a_lidar_packets_name_len && std::memcmp(topic.m_begin, s_topic_ouster_1a_lidar_packets_name, s_topic_ouster_1a_lidar_packets_name_len) == 0;
+	if(is_ouster_1a)
+	{
+		satisfies = true;
+		return true;
+	}
+	bool const is_ouster_1b = topic.m_len == s_topic_ouster_1b_lidar_packets_name_len && std::memcmp(topic.m_begin, s_topic_ouster_1b_lidar_packets_name, s_topic_ouster_1b_lidar_packets_name_len) == 0;
+	if(is_ouster_1b)
+	{
+		satisfies = true;
+		return true;
+	}
+
+	satisfies = false;
+	return true;
+}
+
+template<typename data_source_t>
+bool mk::bag_tool::detail::is_ouster_chunk_bz2(data_source_t& data_source, std::vector<chunk_entry_t> const& chunk_entries, std::vector<std::uint32_t> const& ouster_channels, bool* const out_is_bz2)
+{
+	static constexpr char const s_compression_bz2_name[] = "bz2";
+	static constexpr int const s_compression_bz2_name_len = static_cast<int>(std::size(s_compression_bz2_name)) - 1;
+
+	assert(out_is_bz2);
+	bool& is_bz2 = *out_is_bz2;
+
+	static constexpr auto const s_record_callback = [](void* const ctx, void* const data, bool& keep_iterating) -> bool
+	{
+		bool& is_bz2 = *static_cast<bool*>(ctx);
+		mk::bag::record_t const& record = *static_cast<mk::bag::record_t const*>(data);
+
+		bool const is_chunk = std::visit(mk::make_overload([](mk::bag::header::chunk_t const&) -> bool { return true; }, [](...) -> bool { return false; }), record.m_header);
+		CHECK_RET_F(is_chunk);
+		mk::bag::header::chunk_t const& chunk = std::get<mk::bag::header::chunk_t>(record.m_header);
+		is_bz2 = chunk.m_compression.m_len == s_compression_bz2_name_len && std::memcmp(chunk.m_compression.m_begin, s_compression_bz2_name, s_compression_bz2_name_len) == 0;
+
+		keep_iterating = false;
+		return true;
+	};
+	mk::bag::callback_t const callback = s_record_callback;
+
+	// Bags are recorded with a single compression, the first chunk with lidar packets speaks for all of them.
+	is_bz2 = false;
+	auto const it = std::find_if(chunk_entries.begin(), chunk_entries.end(), [&](chunk_entry_t const& chunk_entry){ return get_chunk_messages_count(chunk_entry, ouster_channels) != 0; });
+	if(it == chunk_entries.end())
+	{
+		return true;
+	}
+	data_source.move_to(it->m_chunk_info.m_chunk_pos, 1);
+	bool const parsed = mk::bag::parse_records(data_source, callback, &is_bz2);
+	CHECK_RET_F(parsed);
+
+	return true;
+}
+
+int mk::bag_tool::detail::get_threads_count(pcap_options_t const& options, bool const is_bz2)
+{
+	if(options.m_threads_count != 0)
+	{
+		return options.m_threads_count;
+	}
+	if(!is_bz2)
+	{
+		return 1;
+	}
+	// bz2 decompression is the bottleneck by far, spread the chunks over all cores unless told otherwise.
+	unsigned const hardware_threads_count = std::thread::hardware_concurrency();
+	return hardware_threads_count == 0 ? 1 : static_cast<int>(hardware_threads_count);
+}
+
+template<typename data_source_t>
+bool mk::bag_tool::detail::process_ouster_records(data_source_t& data_source, std::vector<chunk_entry_t> const& chunk_entries, std::vector<std::uint32_t> const& ouster_channels, time_window_t const& window, bool const huge_pages, std::vector<pcap_sink_t>& sinks)
+{
+	struct helper_struct_t
+	{
+		std::vector<std::uint32_t> const& m_ouster_channels;
+		time_window_t m_window;
+		std::vector<mk::bag::data::index_data_ver_1_t> m_index_entries;
+		bool m_indexed;
+		chunk_decompressor_t m_decompressor;
+		std::vector<ouster_packets_t> m_packets;
+		std::vector<pcap_sink_t>& m_sinks;
+	};
+
+	static constexpr auto const s_record_callback = [](void* const ctx, void* const data, bool& keep_iterating) -> bool
+	{
+		helper_struct_t& helper = *static_cast<helper_struct_t*>(ctx);
+		mk::bag::record_t const& record = *static_cast<mk::bag::record_t const*>(data);
 
-		bool const processed = get_ouster_channel_record(record, &ouster_channel_opt);
+		bool const is_chunk = std::visit(mk::make_overload([](mk::bag::header::chunk_t const&) -> bool { return true; }, [](...) -> bool { return false; }), record.m_header);
+		CHECK_RET_F(is_chunk);
+
+		std::vector<mk::bag::data::index_data_ver_1_t> const* const index_entries = helper.m_indexed ? &helper.m_index_entries : nullptr;
+		bool const processed = process_record_ouster_chunk(record, helper.m_ouster_channels, helper.m_window, index_entries, helper.m_decompressor, &helper.m_packets);
 		CHECK_RET_F(processed);
-		if(ouster_channel_opt.has_value())
-		{
-			keep_iterating = false;
-			return true;
-		}
+		bool const committed = commit_lidars_packets(helper.m_sinks, helper.m_packets);
+		CHECK_RET_F(committed);
 
+		keep_iterating = false;
 		return true;
 	};
 	mk::bag::callback_t const callback = s_record_callback;
 
-	std::optional<std::uint32_t> ouster_channel_opt = std::nullopt;
-	bool const file_parsed = mk::bag::parse_records(data_source, callback, &ouster_channel_opt);
-	CHECK_RET_F(file_parsed);
-
-	CHECK_RET_F(ouster_channel_opt.has_value());
-	ouster_channel = *ouster_channel_opt;
+	assert(sinks.size() == ouster_channels.size());
+	helper_struct_t helper{ouster_channels, window, {}, false, {}, std::vector<ouster_packets_t>(ouster_channels.size()), sinks};
+	helper.m_decompressor.m_buffer = mk::raw_buffer_t{huge_pages};
+	for(chunk_entry_t const& chunk_entry : chunk_entries)
+	{
+		if(get_chunk_messages_count(chunk_entry, ouster_channels) == 0)
+		{
+			continue;
+		}
+		// Input is shared by all of the outputs, the first one takes care of it.
+		bool const streamed = stream_input(sinks.front(), chunk_entry.m_chunk_info.m_chunk_pos);
+		CHECK_RET_F(streamed);
+		bool const got_index_entries = get_chunk_index_entries(data_source, chunk_entry, ouster_channels, &helper.m_index_entries, &helper.m_indexed);
+		CHECK_RET_F(got_index_entries);
+		data_source.move_to(chunk_entry.m_chunk_info.m_chunk_pos, 1);
+		bool const parsed = mk::bag::parse_records(data_source, callback, &helper);
+		CHECK_RET_F(parsed);
+	}
 
 	return true;
 }
 
 template<typename data_source_t>
-bool mk::bag_tool::detail::get_connections_offset(data_source_t& data_source, std::uint64_t* const out_connections_offset)
+bool mk::bag_tool::detail::process_ouster_records_parallel(data_source_t& data_source, std::vector<chunk_entry_t> const& chunk_entries, std::vector<std::uint32_t> const& ouster_channels, time_window_t const& window, int const threads_count, bool const huge_pages, bool const pwrite, std::vector<pcap_sink_t>& sinks)
 {
-	assert(out_connections_offset);
-	std::uint64_t& connections_offset = *out_connections_offset;
-
 	static constexpr auto const s_record_callback = [](void* const ctx, void* const data, bool& keep_iterating) -> bool
 	{
-		assert(ctx);
-		assert(data);
-
-		std::uint64_t& connections_offset = *static_cast<std::uint64_t*>(ctx);
+		ouster_chunk_job_t& job = *static_cast<ouster_chunk_job_t*>(ctx);
 		mk::bag::record_t const& record = *static_cast<mk::bag::record_t const*>(data);
 
-		bool const is_bag = std::visit(mk::make_overload([](mk::bag::header::bag_t const&) -> bool { return true; }, [](...) -> bool { return false; }), record.m_header);
-		CHECK_RET_F(is_bag);
-		mk::bag::header::bag_t const& bag = std::get<mk::bag::header::bag_t>(record.m_header);
+		bool const is_chunk = std::visit(mk::make_overload([](mk::bag::header::chunk_t const&) -> bool { return true; }, [](...) -> bool { return false; }), record.m_header);
+		CHECK_RET_F(is_chunk);
+		mk::bag::header::chunk_t const& chunk = std::get<mk::bag::header::chunk_t>(record.m_header);
 
-		connections_offset = bag.m_index_pos;
-		keep_iterating = false;
+		job.m_compression.assign(chunk.m_compression.m_begin, chunk.m_compression.m_begin + chunk.m_compression.m_len);
+		job.m_size = chunk.m_size;
+		job.m_chunk_data.assign(record.m_data.m_begin, record.m_data.m_begin + record.m_data.m_len);
 
+		keep_iterating = false;
 		return true;
 	};
 	mk::bag::callback_t const callback = s_record_callback;
 
-	bool const file_parsed = mk::bag::parse_records(data_source, callback, &connections_offset);
-	CHECK_RET_F(file_parsed);
-
-	return true;
-}
+	static constexpr auto const s_task = [](void* const ctx, [[maybe_unused]] int const thread_idx, void* const job_) -> bool
+	{
+		ouster_workers_ctx_t& workers_ctx = *static_cast<ouster_workers_ctx_t*>(ctx);
+		ouster_chunk_job_t& job = *static_cast<ouster_chunk_job_t*>(job_);
+
+		mk::bag::record_t record;
+		mk::bag::header::chunk_t chunk;
+		chunk.m_compression.m_begin = job.m_compression.data();
+		chunk.m_compression.m_len = static_cast<int>(job.m_compression.size());
+		chunk.m_size = job.m_size;
+		record.m_header = chunk;
+		record.m_data.m_begin = job.m_chunk_data.data();
+		record.m_data.m_len = static_cast<int>(job.m_chunk_data.size());
+
+		if(!job.m_placed)
+		{
+			std::vector<mk::bag::data::index_data_ver_1_t> const* const index_entries = job.m_indexed ? &job.m_index_entries : nullptr;
+			bool const processed = process_record_ouster_chunk(record, workers_ctx.m_ouster_channels, workers_ctx.m_window, index_entries, job.m_decompressor, &job.m_packets);
+			CHECK_RET_F(processed);
+			return true;
+		}
 
-bool mk::bag_tool::detail::get_ouster_channel_record(mk::bag::record_t const& record, std::optional<std::uint32_t>* const out_ouster_channel_opt)
-{
-	assert(out_ouster_channel_opt);
-	std::optional<std::uint32_t>& ouster_channel_opt = *out_ouster_channel_opt;
+		for(std::size_t i = 0; i != workers_ctx.m_output_files.size(); ++i)
+		{
+			stamp_ouster_packets(job.m_packets[i], job.m_first_packets_idx[i]);
+			std::uint64_t const offset = sizeof(pcap_hdr_t) + job.m_first_packets_idx[i] * s_ouster_packet_len;
+			bool const written = write_ouster_packets(*workers_ctx.m_output_files[i], offset, job.m_packets[i], nullptr, job.m_buffers);
+			CHECK_RET_F(written);
+		}
 
-	bool is_my_topic;
-	bool const filtered = is_topic_ouster_lidar_packets(record, &is_my_topic);
-	CHECK_RET_F(filtered);
-	if(!is_my_topic)
-	{
 		return true;
+	};
+	mk::worker_pool_t::task_t const task = s_task;
+
+	assert(sinks.size() == ouster_channels.size());
+	int const max_jobs_count = threads_count * 2;
+	std::vector<ouster_chunk_job_t> jobs(max_jobs_count);
+	std::vector<ouster_chunk_job_t*> free_jobs(max_jobs_count);
+	std::transform(jobs.begin(), jobs.end(), free_jobs.begin(), [](ouster_chunk_job_t& job){ return &job; });
+	for(ouster_chunk_job_t& job : jobs)
+	{
+		job.m_decompressor.m_buffer = mk::raw_buffer_t{huge_pages};
+		job.m_first_packets_idx.resize(ouster_channels.size());
+		job.m_packets.resize(ouster_channels.size());
 	}
 
-	CHECK_RET_F(!ouster_channel_opt.has_value());
-	ouster_channel_opt = std::get<mk::bag::header::connection_t>(record.m_header).m_conn;
-
-	return true;
-}
-
-bool mk::bag_tool::detail::is_topic_ouster_lidar_packets(mk::bag::record_t const& record, bool* const out_satisfies)
-{
-	static constexpr char const s_topic_ouster_0_lidar_packets_name[] = "/os_node/lidar_packets";
-	static constexpr int const s_topic_ouster_0_lidar_packets_name_len = static_cast<int>(std::size(s_topic_ouster_0_lidar_packets_name)) - 1;
-	static constexpr char const s_topic_ouster_1a_lidar_packets_name[] = "/os1_node/lidar_packets";
-	static constexpr int const s_topic_ouster_1a_lidar_packets_name_len = static_cast<int>(std::size(s_topic_ouster_1a_lidar_packets_name)) - 1;
-	static constexpr char const s_topic_ouster_1b_lidar_packets_name[] = "os1_node/lidar_packets";
-	static constexpr int const s_topic_ouster_1b_lidar_packets_name_len = static_cast<int>(std::size(s_topic_ouster_1b_lidar_packets_name)) - 1;
-
-	assert(out_satisfies);
-	bool& satisfies = *out_satisfies;
-
-	assert(std::visit(mk::make_overload([](mk::bag::header::connection_t const&) -> bool { return true; }, [](...) -> bool { return false; }), record.m_header));
-	mk::bag::header::connection_t const& connection = std::get<mk::bag::header::connection_t>(record.m_header);
-
-	bool const is_ouster_0 = connection.m_topic.m_len == s_topic_ouster_0_lidar_packets_name_len && std::memcmp(connection.m_topic.m_begin, s_topic_ouster_0_lidar_packets_name, s_topic_ouster_0_lidar_packets_name_len) == 0;
-	if(is_ouster_0)
+	ouster_workers_ctx_t workers_ctx;
+	workers_ctx.m_ouster_channels = ouster_channels;
+	workers_ctx.m_window = window;
+	if(pwrite)
 	{
-		satisfies = true;
-		return true;
+		for(pcap_sink_t& sink : sinks)
+		{
+			workers_ctx.m_output_files.push_back(&sink.m_file);
+		}
 	}
-	bool const is_ouster_1a = connection.m_topic.m_len == s_topic_ouster_1a_lidar_packets_name_len && std::memcmp(connection.m_topic.m_begin, s_topic_ouster_1a_lidar_packets_name, s_topic_ouster_1a_lidar_packets_name_len) == 0;
-	if(is_ouster_1a)
+
+	mk::worker_pool_t worker_pool{threads_count, task, &workers_ctx};
+	static constexpr auto const s_commit = [](mk::worker_pool_t& worker_pool, std::vector<ouster_chunk_job_t*>& free_jobs, std::vector<pcap_sink_t>& sinks, bool const pwrite) -> bool
 	{
-		satisfies = true;
+		void* job_;
+		bool const processed = worker_pool.pop(&job_);
+		ouster_chunk_job_t& job = *static_cast<ouster_chunk_job_t*>(job_);
+		if(pwrite && !job.m_placed && processed)
+		{
+			// Packets are counted only once the chunk is cut, not taken from the index, messages of unexpected size are skipped.
+			// Jobs come back in order, so the job goes right after everything placed before it and threads then write it by themselves.
+			for(std::size_t i = 0; i != sinks.size(); ++i)
+			{
+				job.m_first_packets_idx[i] = sinks[i].m_packets_count;
+				sinks[i].m_packets_count += job.m_packets[i].m_count;
+			}
+			job.m_placed = true;
+			worker_pool.push(&job);
+			return true;
+		}
+		free_jobs.push_back(&job);
+		CHECK_RET_F(processed);
+		if(!pwrite)
+		{
+			bool const committed = commit_lidars_packets(sinks, job.m_packets);
+			CHECK_RET_F(committed);
+		}
+		else
+		{
+			// Jobs finish in order, so everything up to the end of this one is written already.
+			for(std::size_t i = 0; i != sinks.size(); ++i)
+			{
+				bool const streamed = stream_output(sinks[i], sizeof(pcap_hdr_t) + (job.m_first_packets_idx[i] + job.m_packets[i].m_count) * s_ouster_packet_len);
+				CHECK_RET_F(streamed);
+			}
+		}
 		return true;
+	};
+
+	for(chunk_entry_t const& chunk_entry : chunk_entries)
+	{
+		if(get_chunk_messages_count(chunk_entry, ouster_channels) == 0)
+		{
+			continue;
+		}
+		while(free_jobs.empty())
+		{
+			bool const committed = s_commit(worker_pool, free_jobs, sinks, pwrite);
+			CHECK_RET_F(committed);
+		}
+		ouster_chunk_job_t& job = *free_jobs.back();
+		free_jobs.pop_back();
+		job.m_placed = false;
+		// Input is shared by all of the outputs, the first one takes care of it.
+		bool const streamed = stream_input(sinks.front(), chunk_entry.m_chunk_info.m_chunk_pos);
+		CHECK_RET_F(streamed);
+		bool const got_index_entries = get_chunk_index_entries(data_source, chunk_entry, ouster_channels, &job.m_index_entries, &job.m_indexed);
+		CHECK_RET_F(got_index_entries);
+		data_source.move_to(chunk_entry.m_chunk_info.m_chunk_pos, 1);
+		bool const parsed = mk::bag::parse_records(data_source, callback, &job);
+		CHECK_RET_F(parsed);
+		worker_pool.push(&job);
 	}
-	bool const is_ouster_1b = connection.m_topic.m_len == s_topic_ouster_1b_lidar_packets_name_len && std::memcmp(connection.m_topic.m_begin, s_topic_ouster_1b_lidar_packets_name, s_topic_ouster_1b_lidar_packets_name_len) == 0;
-	if(is_ouster_1b)
+	while(worker_pool.get_jobs_count() != 0)
 	{
-		satisfies = true;
-		return true;
+		bool const committed = s_commit(worker_pool, free_jobs, sinks, pwrite);
+		CHECK_RET_F(committed);
 	}
 
-	satisfies = false;
 	return true;
 }
 
 template<typename data_source_t>
-bool mk::bag_tool::detail::process_ouster_records(data_source_t& data_source, std::uint32_t const ouster_channel)
+bool mk::bag_tool::detail::get_chunk_index_entries(data_source_t& data_source, chunk_entry_t const& chunk_entry, std::vector<std::uint32_t> const& connections, std::vector<mk::bag::data::index_data_ver_1_t>* const out_index_entries, bool* const out_found)
 {
 	struct helper_struct_t
 	{
-		std::uint32_t m_ouster_channel;
-		std::vector<unsigned char> m_helper_buffer;
+		std::vector<std::uint32_t> const& m_connections;
+		std::vector<mk::bag::data::index_data_ver_1_t>& m_index_entries;
+		std::vector<std::uint32_t> m_found_connections;
+		bool m_chunk_seen;
 	};
 
-	static constexpr auto const s_record_callback = [](void* const ctx, void* const data, [[maybe_unused]] bool& keep_iterating) -> bool
+	static constexpr auto const s_record_callback = [](void* const ctx, void* const data, bool& keep_iterating) -> bool
 	{
 		helper_struct_t& helper = *static_cast<helper_struct_t*>(ctx);
 		mk::bag::record_t const& record = *static_cast<mk::bag::record_t const*>(data);
 
-		bool const processed = process_record_ouster_chunk(record, helper.m_ouster_channel, helper.m_helper_buffer);
-		CHECK_RET_F(processed);
+		if(!helper.m_chunk_seen)
+		{
+			bool const is_chunk = std::visit(mk::make_overload([](mk::bag::header::chunk_t const&) -> bool { return true; }, [](...) -> bool { return false; }), record.m_header);
+			CHECK_RET_F(is_chunk);
+			helper.m_chunk_seen = true;
+			return true;
+		}
+
+		bool const is_index_data = std::visit(mk::make_overload([](mk::bag::header::index_data_t const&) -> bool { return true; }, [](...) -> bool { return false; }), record.m_header);
+		if(!is_index_data)
+		{
+			keep_iterating = false;
+			return true;
+		}
+		mk::bag::header::index_data_t const& index_data = std::get<mk::bag::header::index_data_t>(record.m_header);
+		if(std::find(helper.m_connections.cbegin(), helper.m_connections.cend(), index_data.m_conn) == helper.m_connections.cend())
+		{
+			return true;
+		}
+
+		CHECK_RET_F(std::find(helper.m_found_connections.cbegin(), helper.m_found_connections.cend(), index_data.m_conn) == helper.m_found_connections.cend());
+		std::size_t const first_entry = helper.m_index_entries.size();
+		helper.m_index_entries.resize(first_entry + index_data.m_count);
+		for(std::uint32_t i = 0; i != index_data.m_count; ++i)
+		{
+			bool const parsed = mk::bag::parse_index_data_data(record, i, &helper.m_index_entries[first_entry + i]);
+			CHECK_RET_F(parsed);
+		}
+		helper.m_found_connections.push_back(index_data.m_conn);
 
 		return true;
 	};
 	mk::bag::callback_t const callback = s_record_callback;
 
-	helper_struct_t helper;
-	helper.m_ouster_channel = ouster_channel;
+	assert(out_index_entries);
+	assert(out_found);
+	std::vector<mk::bag::data::index_data_ver_1_t>& index_entries = *out_index_entries;
+	bool& found = *out_found;
+
+	if(chunk_entry.m_indexed)
+	{
+		assert(std::all_of(chunk_entry.m_connections.cbegin(), chunk_entry.m_connections.cend(), [&](mk::bag::data::chunk_info_ver_1_t const& e){ return std::find(connections.cbegin(), connections.cend(), e.m_conn) != connections.cend(); }));
+		index_entries = chunk_entry.m_index_entries;
+		found = true;
+		return true;
+	}
+
+	index_entries.clear();
+	helper_struct_t helper{connections, index_entries, {}, false};
+	data_source.move_to(chunk_entry.m_chunk_info.m_chunk_pos, 1);
 	bool const parsed = mk::bag::parse_records(data_source, callback, &helper);
 	CHECK_RET_F(parsed);
+	// Index of any lidar of the chunk missing means the whole chunk has to be walked.
+	std::size_t const expected_count = std::count_if(connections.cbegin(), connections.cend(), [&](std::uint32_t const connection){ return get_chunk_connection_count(chunk_entry, connection) != 0; });
+	found = helper.m_found_connections.size() >= expected_count;
+
+	// Messages must be emitted in the order in which they are stored in the chunk.
+	std::sort(index_entries.begin(), index_entries.end(), [](mk::bag::data::index_data_ver_1_t const& a, mk::bag::data::index_data_ver_1_t const& b) -> bool { return a.m_offset < b.m_offset; });
 
 	return true;
 }
 
-bool mk::bag_tool::detail::process_record_ouster_chunk(mk::bag::record_t const& record, std::uint32_t const ouster_channel, std::vector<unsigned char>& helper_buffer)
+bool mk::bag_tool::detail::process_record_ouster_chunk(mk::bag::record_t const& record, std::vector<std::uint32_t> const& ouster_channels, time_window_t const& window, std::vector<mk::bag::data::index_data_ver_1_t> const* const index_entries, chunk_decompressor_t& decompressor, std::vector<ouster_packets_t>* const out_packets)
 {
-	bool const is_chunk = std::visit(mk::make_overload([](mk::bag::header::chunk_t const&) -> bool { return true; }, [](...) -> bool { return false; }), record.m_header);
-	if(!is_chunk)
-	{
-		return true;
-	}
+	assert(std::visit(mk::make_overload([](mk::bag::header::chunk_t const&) -> bool { return true; }, [](...) -> bool { return false; }), record.m_header));
+	assert(out_packets);
 	mk::bag::header::chunk_t const& chunk = std::get<mk::bag::header::chunk_t>(record.m_header);
+	std::vector<ouster_packets_t>& packets = *out_packets;
+	assert(packets.size() == ouster_channels.size());
 
 	void const* decompressed_data;
-	bool const decompressed = decompress_record_chunk_data(record, helper_buffer, &decompressed_data);
+	bool const decompressed = decompress_record_chunk_data(record, decompressor, &decompressed_data);
 	CHECK_RET_F(decompressed);
 
+	struct inner_ctx_t
+	{
+		std::vector<std::uint32_t> const& m_ouster_channels;
+		time_window_t m_window;
+		std::vector<ouster_packets_t>& m_packets;
+	};
+
 	static constexpr auto const s_record_callback = [](void* const ctx, void* const data, [[maybe_unused]] bool& keep_iterating) -> bool
 	{
-		std::uint32_t const& ouster_channel = *static_cast<std::uint32_t const*>(ctx);
+		inner_ctx_t& inner_ctx = *static_cast<inner_ctx_t*>(ctx);
 		mk::bag::record_t const& record = *static_cast<mk::bag::record_t const*>(data);
 
-		bool const processed = process_inner_ouster_record(record, ouster_channel);
+		bool const processed = process_inner_ouster_record(record, inner_ctx.m_ouster_channels, inner_ctx.m_window, &inner_ctx.m_packets);
 		CHECK_RET_F(processed);
 
 		return true;
 	};
 	mk::bag::callback_t const callback = s_record_callback;
 
-	std::uint32_t ouster_channel_ = ouster_channel;
+	static constexpr auto const s_indexed_record_callback = [](void* const ctx, void* const data, bool& keep_iterating) -> bool
+	{
+		inner_ctx_t& inner_ctx = *static_cast<inner_ctx_t*>(ctx);
+		mk::bag::record_t const& record = *static_cast<mk::bag::record_t const*>(data);
+
+		bool const is_message_data = std::visit(mk::make_overload([](mk::bag::header::message_data_t const&) -> bool { return true; }, [](...) -> bool { return false; }), record.m_header);
+		CHECK_RET_F(is_message_data);
+		std::uint32_t const conn = std::get<mk::bag::header::message_data_t>(record.m_header).m_conn;
+		CHECK_RET_F(std::find(inner_ctx.m_ouster_channels.cbegin(), inner_ctx.m_ouster_channels.cend(), conn) != inner_ctx.m_ouster_channels.cend());
+
+		bool const processed = process_inner_ouster_record(record, inner_ctx.m_ouster_channels, inner_ctx.m_window, &inner_ctx.m_packets);
+		CHECK_RET_F(processed);
+
+		keep_iterating = false;
+		return true;
+	};
+	mk::bag::callback_t const indexed_callback = s_indexed_record_callback;
+
+	for(ouster_packets_t& lidar_packets : packets)
+	{
+		lidar_packets.m_headers.clear();
+		lidar_packets.m_payloads.clear();
+		lidar_packets.m_count = 0;
+	}
+	inner_ctx_t inner_ctx{ouster_channels, window, packets};
 	mk::data_source_mem_t data_source = mk::data_source_mem_t::make(decompressed_data, chunk.m_size);
-	bool const parsed = mk::bag::parse_records(data_source, callback, &ouster_channel_);
-	CHECK_RET_F(parsed);
+	if(index_entries == nullptr)
+	{
+		bool const parsed = mk::bag::parse_records(data_source, callback, &inner_ctx);
+		CHECK_RET_F(parsed);
+		return true;
+	}
+
+	for(mk::bag::data::index_data_ver_1_t const& index_entry : *index_entries)
+	{
+		CHECK_RET_F(index_entry.m_offset < chunk.m_size);
+		if(!is_in_time_window(window, index_entry.m_time))
+		{
+			continue;
+		}
+		data_source.move_to(index_entry.m_offset, 1);
+		bool const parsed = mk::bag::parse_records(data_source, indexed_callback, &inner_ctx);
+		CHECK_RET_F(parsed);
+	}
 
 	return true;
 }
 
-bool mk::bag_tool::detail::decompress_record_chunk_data(mk::bag::record_t const& record, std::vector<unsigned char>& helper_buffer, void const** out_decompressed_data)
+bool mk::bag_tool::detail::decompress_record_chunk_data(mk::bag::record_t const& record, chunk_decompressor_t& decompressor, void const** out_decompressed_data)
 {
 	static constexpr char const s_compression_none_name[] = "none";
 	static constexpr int const s_compression_none_name_len = static_cast<int>(std::size(s_compression_none_name)) - 1;
 	static constexpr char const s_compression_lz4_name[] = "lz4";
 	static constexpr int const s_compression_lz4_name_len = static_cast<int>(std::size(s_compression_lz4_name)) - 1;
+	static constexpr char const s_compression_bz2_name[] = "bz2";
+	static constexpr int const s_compression_bz2_name_len = static_cast<int>(std::size(s_compression_bz2_name)) - 1;
 
 	assert(out_decompressed_data);
 	assert(std::visit(mk::make_overload([](mk::bag::header::chunk_t const&) -> bool { return true; }, [](...) -> bool { return false; }), record.m_header));
@@ -310,42 +1494,59 @@ bool mk::bag_tool::detail::decompress_record_chunk_data(mk::bag::record_t const&
 	bool const is_lz4 = chunk.m_compression.m_len == s_compression_lz4_name_len && std::memcmp(chunk.m_compression.m_begin, s_compression_lz4_name, s_compression_lz4_name_len) == 0;
 	if(is_lz4)
 	{
-		helper_buffer.resize(chunk.m_size);
-		bool const decompressed = decompress_lz4(record.m_data.m_begin, record.m_data.m_len, helper_buffer.data(), static_cast<int>(chunk.m_size));
-		CHECK_RET(decompressed, false);
+		if(!decompressor.m_lz4)
+		{
+			decompressor.m_lz4 = mk::lz4_decompressor_t::make();
+			CHECK_RET_F(decompressor.m_lz4);
+		}
+		bool const reserved = decompressor.m_buffer.reserve(chunk.m_size);
+		CHECK_RET_F(reserved);
+		bool const decompressed = decompressor.m_lz4.decompress(record.m_data.m_begin, record.m_data.m_len, decompressor.m_buffer.get_data(), chunk.m_size);
+		CHECK_RET_F(decompressed);
+
+		void const*& decompressed_data = *out_decompressed_data;
+		decompressed_data = decompressor.m_buffer.get_data();
+		return true;
+	}
+
+	bool const is_bz2 = chunk.m_compression.m_len == s_compression_bz2_name_len && std::memcmp(chunk.m_compression.m_begin, s_compression_bz2_name, s_compression_bz2_name_len) == 0;
+	if(is_bz2)
+	{
+		bool const reserved = decompressor.m_buffer.reserve(chunk.m_size);
+		CHECK_RET_F(reserved);
+		bool const decompressed = decompress_bz2(record.m_data.m_begin, record.m_data.m_len, decompressor.m_buffer.get_data(), static_cast<int>(chunk.m_size));
+		CHECK_RET_F(decompressed);
 
 		void const*& decompressed_data = *out_decompressed_data;
-		decompressed_data = helper_buffer.data();
+		decompressed_data = decompressor.m_buffer.get_data();
 		return true;
 	}
 
 	return false;
 }
 
-bool mk::bag_tool::detail::decompress_lz4(void const* const input, int const input_len_, void* const output, int const output_len_)
+bool mk::bag_tool::detail::decompress_bz2(void const* const input, int const input_len, void* const output, int const output_len)
 {
-	LZ4F_decompressionContext_t ctx;
-	LZ4F_errorCode_t const context_created = LZ4F_createDecompressionContext(&ctx, LZ4F_VERSION);
-	CHECK_RET_F(!LZ4F_isError(context_created));
-	auto const context_free = mk::make_scope_exit([&](){ LZ4F_errorCode_t const context_freed = LZ4F_freeDecompressionContext(ctx); CHECK_RET_CRASH(context_freed == 0); });
-
-	std::size_t output_len = output_len_;
-	std::size_t input_len = input_len_;
-	std::size_t const decompressed = LZ4F_decompress(ctx, output, &output_len, input, &input_len, nullptr);
-	CHECK_RET_F(decompressed == 0 && output_len == static_cast<std::size_t>(output_len_) && input_len == static_cast<std::size_t>(input_len_));
+	// bzlib keeps no state worth reusing between streams, each chunk is a complete stream of its own.
+	unsigned int decompressed_len = static_cast<unsigned int>(output_len);
+	int const decompressed = BZ2_bzBuffToBuffDecompress(static_cast<char*>(output), &decompressed_len, static_cast<char*>(const_cast<void*>(input)), static_cast<unsigned int>(input_len), 0, 0);
+	CHECK_RET_F(decompressed == BZ_OK && decompressed_len == static_cast<unsigned int>(output_len));
 
 	return true;
 }
 
-bool mk::bag_tool::detail::process_inner_ouster_record(mk::bag::record_t const& record, std::uint32_t const ouster_channel)
+bool mk::bag_tool::detail::process_inner_ouster_record(mk::bag::record_t const& record, std::vector<std::uint32_t> const& ouster_channels, time_window_t const& window, std::vector<ouster_packets_t>* const out_packets)
 {
-	static constexpr int const s_udp_header_len = 8;
-	static constexpr int const s_ip_header_len = 28;
-	static constexpr int const s_brutal_header_len = 42;
-	static constexpr int const s_payload_len = 12608;
-	static constexpr int const s_pcap_payload_len = s_payload_len + s_brutal_header_len; // 12650
-	static constexpr int const s_bag_payload_len = 12613;
-	static constexpr std::uint16_t const s_destination_port_number = 7502;
+	static constexpr auto const s_make_header_template = []() -> std::array<unsigned char, s_ouster_header_len>
+	{
+		std::array<unsigned char, s_ouster_header_len> header_template;
+		make_ouster_packet_header(header_template.data());
+		return header_template;
+	};
+	static std::array<unsigned char, s_ouster_header_len> const s_header_template = s_make_header_template();
+
+	assert(out_packets);
+	assert(out_packets->size() == ouster_channels.size());
 
 	bool const is_message_data = std::visit(mk::make_overload([](mk::bag::header::message_data_t const&) -> bool { return true; }, [](...) -> bool { return false; }), record.m_header);
 	if(!is_message_data)
@@ -353,57 +1554,47 @@ bool mk::bag_tool::detail::process_inner_ouster_record(mk::bag::record_t const&
 		return true;
 	}
 	mk::bag::header::message_data_t const& message_data = std::get<mk::bag::header::message_data_t>(record.m_header);
-	bool const is_my_connection = message_data.m_conn == ouster_channel;
-	if(!is_my_connection)
+	auto const it = std::find(ouster_channels.cbegin(), ouster_channels.cend(), message_data.m_conn);
+	if(it == ouster_channels.cend())
+	{
+		return true;
+	}
+	ouster_packets_t& packets = (*out_packets)[it - ouster_channels.cbegin()];
+	bool const is_in_window = is_in_time_window(window, message_data.m_time);
+	if(!is_in_window)
 	{
 		return true;
 	}
-	bool const is_good_size = record.m_data.m_len == s_bag_payload_len;
+	bool const is_good_size = record.m_data.m_len == s_ouster_bag_payload_len;
 	if(!is_good_size)
 	{
 		return true;
 	}
 
-	struct pcaprec_hdr_t
-	{
-		std::uint32_t ts_sec; /* timestamp seconds */
-		std::uint32_t ts_usec; /* timestamp microseconds */
-		std::uint32_t incl_len; /* number of octets of packet saved in file */
-		std::uint32_t orig_len; /* actual length of packet */
-	};
-	static_assert(sizeof(pcaprec_hdr_t) == 16);
-	struct brutal_header_t
-	{
-		unsigned char eth_ig_1[3];
-		unsigned char eth_addr_1[3];
-		unsigned char eth_ig_2[3];
-		unsigned char eth_addr_2[3];
-		unsigned char eth_type[2];
-		unsigned char ip_hdr_len[1];
-		unsigned char ip_dsfield_enc[1];
-		unsigned char ip_len[2];
-		unsigned char ip_id[2];
-		unsigned char ip_frag_offset[2];
-		unsigned char ip_ttl[1];
-		unsigned char ip_proto[1];
-		unsigned char ip_checksum[2];
-		unsigned char ip_src[4];
-		unsigned char ip_dst[4];
-		unsigned char udp_src_port[2];
-		unsigned char udp_dst_port[2];
-		unsigned char udp_len[2];
-		unsigned char udp_checksum[2];
-	};
-	static_assert(sizeof(brutal_header_t) == 42);
+	std::size_t const header_pos = packets.m_headers.size();
+	packets.m_headers.resize(header_pos + s_ouster_header_len);
+	std::memcpy(packets.m_headers.data() + header_pos, s_header_template.data(), s_ouster_header_len);
+	packets.m_payloads.push_back(record.m_data.m_begin + 4);
+	++packets.m_count;
+
+	return true;
+}
+
+void mk::bag_tool::detail::make_ouster_packet_header(unsigned char* const out_header)
+{
+	static constexpr int const s_udp_header_len = 8;
+	static constexpr int const s_ip_header_len = 28;
+	static constexpr int const s_payload_len = s_ouster_payload_len;
+	static constexpr int const s_pcap_payload_len = s_payload_len + static_cast<int>(sizeof(brutal_header_t)); // 12650
+	static constexpr std::uint16_t const s_destination_port_number = 7502;
 
-	g_time += std::chrono::milliseconds{2};
+	assert(out_header);
 
 	pcaprec_hdr_t pcap_record_header;
-	pcap_record_header.ts_sec = static_cast<std::uint32_t>(std::chrono::duration_cast<std::chrono::seconds>(g_time).count());
-	pcap_record_header.ts_usec = static_cast<std::uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(g_time - std::chrono::duration_cast<std::chrono::seconds>(g_time)).count());
+	pcap_record_header.ts_sec = 0; // filled in by stamp_ouster_packets
+	pcap_record_header.ts_usec = 0; // filled in by stamp_ouster_packets
 	pcap_record_header.incl_len = s_pcap_payload_len;
 	pcap_record_header.orig_len = s_pcap_payload_len;
-	g_ofs.write(reinterpret_cast<char const*>(&pcap_record_header), sizeof(pcap_record_header));
 
 	brutal_header_t brutal_header{};
 	brutal_header.eth_ig_1[0] = 0xFF;
@@ -448,9 +1639,216 @@ bool mk::bag_tool::detail::process_inner_ouster_record(mk::bag::record_t const&
 	brutal_header.udp_len[1] = ((s_udp_header_len + s_payload_len) >> (0 * 8)) & 0xFF;
 	brutal_header.udp_checksum[0] = 0x00;
 	brutal_header.udp_checksum[1] = 0x00;
-	g_ofs.write((char const*)&brutal_header, sizeof(brutal_header));
 
-	g_ofs.write(reinterpret_cast<char const*>(record.m_data.m_begin + 4), record.m_data.m_len - 5);
+	std::memcpy(out_header, &pcap_record_header, sizeof(pcap_record_header));
+	std::memcpy(out_header + sizeof(pcap_record_header), &brutal_header, sizeof(brutal_header));
+}
+
+void mk::bag_tool::detail::stamp_ouster_packets(ouster_packets_t& packets, std::uint64_t const first_packet_idx)
+{
+	assert(packets.m_headers.size() == static_cast<std::size_t>(packets.m_count) * s_ouster_header_len);
+
+	for(int i = 0; i != packets.m_count; ++i)
+	{
+		std::chrono::milliseconds const time = std::chrono::milliseconds{2} * static_cast<std::chrono::milliseconds::rep>(first_packet_idx + i + 1);
+
+		pcaprec_hdr_t pcap_record_header;
+		unsigned char* const packet = packets.m_headers.data() + static_cast<std::size_t>(i) * s_ouster_header_len;
+		std::memcpy(&pcap_record_header, packet, sizeof(pcap_record_header));
+		pcap_record_header.ts_sec = static_cast<std::uint32_t>(std::chrono::duration_cast<std::chrono::seconds>(time).count());
+		pcap_record_header.ts_usec = static_cast<std::uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(time - std::chrono::duration_cast<std::chrono::seconds>(time)).count());
+		std::memcpy(packet, &pcap_record_header, sizeof(pcap_record_header));
+	}
+}
+
+bool mk::bag_tool::detail::write_ouster_packets(mk::write_only_file_t& file, std::uint64_t const offset, ouster_packets_t const& packets, mk::read_only_memory_mapped_file_t const* const input_file, std::vector<mk::write_only_file_buffer_t>& buffers)
+{
+	assert(packets.m_headers.size() == static_cast<std::size_t>(packets.m_count) * s_ouster_header_len);
+	assert(packets.m_payloads.size() == static_cast<std::size_t>(packets.m_count));
+
+	// Payloads of uncompressed chunks point into the mapped input, let the kernel move them and write only the headers.
+	// Windows has no such copy, copy_at writes from the mapping there, so the gather write below does the same with a fraction of writes.
+	#ifdef _MSC_VER
+	static constexpr bool const s_copies_in_kernel = false;
+	#else
+	static constexpr bool const s_copies_in_kernel = true;
+	#endif
+	unsigned char const* const input_begin = input_file != nullptr ? static_cast<unsigned char const*>(input_file->get_data()) : nullptr;
+	unsigned char const* const input_end = input_file != nullptr ? input_begin + input_file->get_size() : nullptr;
+	bool const is_in_input = std::all_of(packets.m_payloads.begin(), packets.m_payloads.end(), [&](unsigned char const* const payload){ return payload >= input_begin && payload + s_ouster_payload_len <= input_end; });
+	if(s_copies_in_kernel && input_file != nullptr && is_in_input)
+	{
+		for(int i = 0; i != packets.m_count; ++i)
+		{
+			std::uint64_t const packet_offset = offset + static_cast<std::uint64_t>(i) * s_ouster_packet_len;
+			bool const written = file.write_at(packet_offset, packets.m_headers.data() + static_cast<std::size_t>(i) * s_ouster_header_len, s_ouster_header_len);
+			CHECK_RET_F(written);
+			bool const copied = file.copy_at(packet_offset + s_ouster_header_len, *input_file, static_cast<std::uint64_t>(packets.m_payloads[i] - input_begin), s_ouster_payload_len);
+			CHECK_RET_F(copied);
+		}
+		return true;
+	}
+
+	// One gather write per chunk, headers come from the packets, payloads straight from the decompressed chunk.
+	gather_ouster_packets(packets, buffers);
+	bool const written = file.write_at(offset, buffers.data(), static_cast<int>(buffers.size()));
+	CHECK_RET_F(written);
+
+	return true;
+}
+
+void mk::bag_tool::detail::gather_ouster_packets(ouster_packets_t const& packets, std::vector<mk::write_only_file_buffer_t>& buffers)
+{
+	assert(packets.m_headers.size() == static_cast<std::size_t>(packets.m_count) * s_ouster_header_len);
+	assert(packets.m_payloads.size() == static_cast<std::size_t>(packets.m_count));
+
+	buffers.resize(static_cast<std::size_t>(packets.m_count) * 2);
+	for(int i = 0; i != packets.m_count; ++i)
+	{
+		buffers[static_cast<std::size_t>(i) * 2 + 0] = mk::write_only_file_buffer_t{packets.m_headers.data() + static_cast<std::size_t>(i) * s_ouster_header_len, s_ouster_header_len};
+		buffers[static_cast<std::size_t>(i) * 2 + 1] = mk::write_only_file_buffer_t{packets.m_payloads[i], s_ouster_payload_len};
+	}
+}
+
+bool mk::bag_tool::detail::commit_ouster_packets(pcap_sink_t& sink, ouster_packets_t& packets)
+{
+	stamp_ouster_packets(packets, sink.m_packets_count);
+	if(sink.m_direct)
+	{
+		gather_ouster_packets(packets, sink.m_buffers);
+		bool const staged = stage_output(sink, sink.m_buffers.data(), static_cast<int>(sink.m_buffers.size()));
+		CHECK_RET_F(staged);
+	}
+	else
+	{
+		std::uint64_t const offset = sizeof(pcap_hdr_t) + sink.m_packets_count * s_ouster_packet_len;
+		bool const written = write_ouster_packets(sink.m_file, offset, packets, sink.m_copy_file_range ? sink.m_input_file : nullptr, sink.m_buffers);
+		CHECK_RET_F(written);
+	}
+	sink.m_packets_count += packets.m_count;
+	bool const streamed = stream_output(sink, sizeof(pcap_hdr_t) + sink.m_packets_count * s_ouster_packet_len);
+	CHECK_RET_F(streamed);
+
+	return true;
+}
+
+bool mk::bag_tool::detail::commit_lidars_packets(std::vector<pcap_sink_t>& sinks, std::vector<ouster_packets_t>& packets)
+{
+	assert(sinks.size() == packets.size());
+
+	for(std::size_t i = 0; i != sinks.size(); ++i)
+	{
+		if(packets[i].m_count == 0)
+		{
+			continue;
+		}
+		bool const committed = commit_ouster_packets(sinks[i], packets[i]);
+		CHECK_RET_F(committed);
+	}
+
+	return true;
+}
+
+bool mk::bag_tool::detail::stream_input(pcap_sink_t& sink, std::uint64_t const position)
+{
+	static constexpr std::uint64_t const s_stream_step = 64 * 1024 * 1024;
+
+	if(!(sink.m_stream && sink.m_input_file != nullptr))
+	{
+		return true;
+	}
+	if(position < sink.m_input_dropped + s_stream_step)
+	{
+		return true;
+	}
+	// Chunks are visited in file order, nothing before the current one is going to be touched again.
+	bool const dropped = sink.m_input_file->drop(sink.m_input_dropped, position - sink.m_input_dropped);
+	CHECK_RET_F(dropped);
+	sink.m_input_dropped = position;
 
 	return true;
 }
+
+bool mk::bag_tool::detail::stream_output(pcap_sink_t& sink, std::uint64_t const written_end)
+{
+	static constexpr std::uint64_t const s_stream_step = 64 * 1024 * 1024;
+
+	if(!sink.m_stream)
+	{
+		return true;
+	}
+	if(written_end < sink.m_output_flushed + s_stream_step)
+	{
+		return true;
+	}
+	// Start writeback of the fresh step, drop the previous one which had a whole step worth of time to reach the disk.
+	bool const started = sink.m_file.start_writeback(sink.m_output_flushed, written_end - sink.m_output_flushed);
+	CHECK_RET_F(started);
+	bool const dropped = sink.m_file.drop(sink.m_output_dropped, sink.m_output_flushed - sink.m_output_dropped);
+	CHECK_RET_F(dropped);
+	sink.m_output_dropped = sink.m_output_flushed;
+	sink.m_output_flushed = written_end;
+
+	return true;
+}
+
+bool mk::bag_tool::detail::stage_output(pcap_sink_t& sink, mk::write_only_file_buffer_t const* const buffers, int const buffers_count)
+{
+	assert(sink.m_direct);
+	assert(buffers || buffers_count == 0);
+
+	// Direct I/O wants block aligned offsets, sizes and memory, so packets are copied into the staging buffer and written out only when it is full.
+	std::size_t const capacity = sink.m_staging.get_capacity();
+	assert(capacity % s_direct_block_size == 0);
+	unsigned char* const staging = sink.m_staging.get_data();
+	for(int i = 0; i != buffers_count; ++i)
+	{
+		unsigned char const* const data = static_cast<unsigned char const*>(buffers[i].m_data);
+		std::size_t copied = 0;
+		while(copied != buffers[i].m_size)
+		{
+			std::size_t const amount = std::min(buffers[i].m_size - copied, capacity - sink.m_staged);
+			std::memcpy(staging + sink.m_staged, data + copied, amount);
+			copied += amount;
+			sink.m_staged += amount;
+			if(sink.m_staged == capacity)
+			{
+				bool const written = sink.m_file.write_at(sink.m_staging_offset, staging, capacity);
+				CHECK_RET_F(written);
+				sink.m_staging_offset += capacity;
+				sink.m_staged = 0;
+			}
+		}
+	}
+
+	return true;
+}
+
+bool mk::bag_tool::detail::flush_output(pcap_sink_t& sink)
+{
+	if(!(sink.m_direct && sink.m_staged != 0))
+	{
+		return true;
+	}
+	// Last block is written padded with zeros, then the file is cut back to its real size.
+	std::size_t const padded = (sink.m_staged + (s_direct_block_size - 1)) &~ (s_direct_block_size - 1);
+	std::memset(sink.m_staging.get_data() + sink.m_staged, 0, padded - sink.m_staged);
+	bool const written = sink.m_file.write_at(sink.m_staging_offset, sink.m_staging.get_data(), padded);
+	CHECK_RET_F(written);
+	bool const truncated = sink.m_file.truncate(sink.m_staging_offset + sink.m_staged);
+	CHECK_RET_F(truncated);
+	sink.m_staging_offset += sink.m_staged;
+	sink.m_staged = 0;
+
+	return true;
+}
+
+
+// /extract walks chunks the same way.
+template bool mk::bag_tool::detail::get_connections_offset<mk::data_source_mem_t>(mk::data_source_mem_t& data_source, std::uint64_t* const out_connections_offset);
+template bool mk::bag_tool::detail::get_chunk_entries<mk::data_source_mem_t>(mk::data_source_mem_t& data_source, std::vector<chunk_entry_t>* const out_chunk_entries);
+template bool mk::bag_tool::detail::get_chunk_index_entries<mk::data_source_mem_t>(mk::data_source_mem_t& data_source, chunk_entry_t const& chunk_entry, std::vector<std::uint32_t> const& connections, std::vector<mk::bag::data::index_data_ver_1_t>* const out_index_entries, bool* const out_found);
+
+template bool mk::bag_tool::detail::get_connections_offset<mk::data_source_rommf_t>(mk::data_source_rommf_t& data_source, std::uint64_t* const out_connections_offset);
+template bool mk::bag_tool::detail::get_chunk_entries<mk::data_source_rommf_t>(mk::data_source_rommf_t& data_source, std::vector<chunk_entry_t>* const out_chunk_entries);
+template bool mk::bag_tool::detail::get_chunk_index_entries<mk::data_source_rommf_t>(mk::data_source_rommf_t& data_source, chunk_entry_t const& chunk_entry, std::vector<std::uint32_t> const& connections, std::vector<mk::bag::data::index_data_ver_1_t>* const out_index_entries, bool* const out_found);
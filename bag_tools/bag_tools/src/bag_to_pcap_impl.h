@@ -2,9 +2,19 @@
 
 
 #include "bag.h"
+#include "bag_index_file.h"
 #include "cross_platform.h"
+#include "data_source_pipe.h"
+#include "lz4_decompressor.h"
+#include "raw_buffer.h"
+#include "write_only_file.h"
+#ifndef _MSC_VER
+	#include "data_source_uring.h"
+#endif
 
+#include <cstddef>
 #include <cstdint>
+#include <string>
 #include <vector>
 
 
@@ -16,23 +26,155 @@ namespace mk
 		{
 
 
+			struct chunk_entry_t
+			{
+				mk::bag::header::chunk_info_t m_chunk_info;
+				std::vector<mk::bag::data::chunk_info_ver_1_t> m_connections;
+				std::vector<mk::bag::data::index_data_ver_1_t> m_index_entries; // of the connections asked about, taken from sidecar index, ordered by offset
+				bool m_indexed; // m_index_entries are filled in, index data records need not be read
+			};
+
+			struct time_window_t
+			{
+				std::uint64_t m_start; // nanoseconds, both ends are inclusive
+				std::uint64_t m_end;
+			};
+
+			struct pcap_options_t
+			{
+				int m_threads_count;
+				bool m_pwrite;
+				bool m_huge_pages;
+				bool m_copy_file_range;
+				bool m_stream;
+				bool m_uring;
+				bool m_direct;
+				bool m_index;
+				time_window_t m_window;
+				std::vector<native_char_t const*> m_topics; // convert these instead of the first Ouster LiDAR
+				bool m_all_lidars; // convert every Ouster LiDAR
+			};
+
+			struct lidar_t
+			{
+				std::uint32_t m_conn;
+				std::basic_string<native_char_t> m_output_pcap;
+			};
+
+			struct chunk_decompressor_t
+			{
+				mk::lz4_decompressor_t m_lz4;
+				mk::raw_buffer_t m_buffer;
+			};
+
+			struct ouster_packets_t
+			{
+				std::vector<unsigned char> m_headers; // pcap record header and Ethernet/IP/UDP header of each packet
+				std::vector<unsigned char const*> m_payloads; // point into the decompressed chunk
+				int m_count;
+			};
+
+			struct pcap_sink_t
+			{
+				mk::write_only_file_t m_file;
+				mk::read_only_memory_mapped_file_t const* m_input_file; // nullptr when input is not mapped as a whole
+				bool m_copy_file_range; // payloads inside of m_input_file are copied by the kernel
+				bool m_stream; // drop pages of input and output behind us
+				std::uint64_t m_packets_count;
+				std::uint64_t m_input_dropped;
+				std::uint64_t m_output_flushed;
+				std::uint64_t m_output_dropped;
+				std::vector<mk::write_only_file_buffer_t> m_buffers;
+				bool m_direct; // output bypasses page cache, everything goes through m_staging
+				mk::raw_buffer_t m_staging;
+				std::size_t m_staged;
+				std::uint64_t m_staging_offset;
+			};
+
+			struct pipe_chunk_t
+			{
+				bool m_pending; // chunk is held until its index_data records tell whether it has anything for us
+				bool m_index_seen; // some index_data follows the chunk
+				bool m_indexed; // index_data of lidar connection with messages inside of the time window, or of yet unknown connection, follows the chunk
+				std::vector<char> m_compression;
+				std::uint32_t m_size;
+				std::vector<unsigned char> m_chunk_data;
+			};
+
+			struct pipe_ctx_t
+			{
+				native_char_t const* m_output_pcap;
+				pcap_options_t const& m_options;
+				std::vector<std::uint32_t> m_connections; // seen so far, of any topic
+				std::vector<lidar_t> m_lidars;
+				std::vector<std::uint32_t> m_ouster_channels; // connections of m_lidars
+				std::vector<pcap_sink_t> m_sinks; // one per lidar
+				pipe_chunk_t m_chunk;
+				chunk_decompressor_t m_decompressor;
+				std::vector<ouster_packets_t> m_packets; // one per lidar
+			};
+
+
 			bool bag_to_pcap(int const argc, native_char_t const* const* const argv);
+			bool parse_pcap_options(int const argc, native_char_t const* const* const argv, pcap_options_t* const out_options);
+
+			bool is_time_window_set(time_window_t const& window);
+			bool is_in_time_window(time_window_t const& window, std::uint64_t const time);
+			void drop_chunks_outside_time_window(time_window_t const& window, std::vector<chunk_entry_t>& chunk_entries);
+			bool is_fan_out(pcap_options_t const& options);
+			bool is_topic_equal(mk::bag::string_t const& topic, native_char_t const* const name);
+			bool is_lidar_topic_selected(mk::bag::string_t const& topic, pcap_options_t const& options, std::size_t const lidars_count, bool* const out_selected);
+			bool add_lidar(std::uint32_t const conn, mk::bag::string_t const& topic, native_char_t const* const output_pcap, pcap_options_t const& options, std::vector<lidar_t>* const out_lidars);
+			std::basic_string<native_char_t> get_lidar_pcap_path(native_char_t const* const output_pcap, mk::bag::string_t const& topic, pcap_options_t const& options);
+			std::basic_string<native_char_t> get_topic_output_path(native_char_t const* const output, mk::bag::string_t const& topic);
 
-			bool bag_to_pcap(native_char_t const* const input_bag, native_char_t const* const output_pcap);
+			bool bag_to_pcap(native_char_t const* const input_bag, native_char_t const* const output_pcap, pcap_options_t const& options);
 			template<typename data_source_t>
-			bool bag_to_pcap(data_source_t& data_source, native_char_t const* const output_pcap);
+			bool bag_to_pcap(data_source_t& data_source, mk::read_only_memory_mapped_file_t const* const input_file, mk::bag_index_file_t const& index_file, native_char_t const* const output_pcap, pcap_options_t const& options);
+			bool open_pcap_sink(native_char_t const* const output_pcap, mk::read_only_memory_mapped_file_t const* const input_file, pcap_options_t const& options, pcap_sink_t* const out_sink);
+			bool bag_to_pcap_pipe(mk::data_source_pipe_t& data_source, native_char_t const* const output_pcap, pcap_options_t const& options);
+			bool process_pipe_chunk(pipe_ctx_t& ctx);
+			bool process_pipe_connection(pipe_ctx_t& ctx, mk::bag::record_t const& record);
 			template<typename data_source_t>
-			bool get_ouster_channel(data_source_t& data_source, std::uint32_t* const out_ouster_channel);
+			bool get_lidars(data_source_t& data_source, native_char_t const* const output_pcap, pcap_options_t const& options, std::vector<lidar_t>* const out_lidars);
 			template<typename data_source_t>
 			bool get_connections_offset(data_source_t& data_source, std::uint64_t* const out_connections_offset);
-			bool get_ouster_channel_record(mk::bag::record_t const& record, std::optional<std::uint32_t>* const out_ouster_channel_opt);
-			bool is_topic_ouster_lidar_packets(mk::bag::record_t const& record, bool* const out_satisfies);
-			template<typename data_source_t>
-			bool process_ouster_records(data_source_t& data_source, std::uint32_t const ouster_channel);
-			bool process_record_ouster_chunk(mk::bag::record_t const& record, std::uint32_t const ouster_channel, std::vector<unsigned char>& helper_buffer);
-			bool decompress_record_chunk_data(mk::bag::record_t const& record, std::vector<unsigned char>& helper_buffer, void const** out_decompressed_data);
-			bool decompress_lz4(void const* const input, int const input_len, void* const output, int const output_len);
-			bool process_inner_ouster_record(mk::bag::record_t const& record, std::uint32_t const ouster_channel);
+			template<typename data_source_t>
+			bool get_chunk_entries(data_source_t& data_source, std::vector<chunk_entry_t>* const out_chunk_entries);
+			bool get_chunk_entry(mk::bag::record_t const& record, chunk_entry_t* const out_chunk_entry);
+			bool get_indexed_chunk_entries(mk::bag_index_file_t const& index_file, native_char_t const* const output_pcap, pcap_options_t const& options, std::vector<lidar_t>* const out_lidars, std::vector<chunk_entry_t>* const out_chunk_entries);
+			bool get_indexed_chunk_entries(mk::bag_index_file_t const& index_file, std::vector<std::uint32_t> const& connection_idxs, std::vector<chunk_entry_t>* const out_chunk_entries);
+			template<typename data_source_t>
+			void schedule_chunk_reads(data_source_t& data_source, std::vector<chunk_entry_t> const& chunk_entries, std::vector<std::uint32_t> const& ouster_channels);
+			#ifndef _MSC_VER
+			void schedule_chunk_reads(mk::data_source_uring_t& data_source, std::vector<chunk_entry_t> const& chunk_entries, std::vector<std::uint32_t> const& ouster_channels);
+			#endif
+			std::uint32_t get_chunk_connection_count(chunk_entry_t const& chunk_entry, std::uint32_t const connection);
+			std::uint64_t get_chunk_messages_count(chunk_entry_t const& chunk_entry, std::vector<std::uint32_t> const& connections);
+			bool is_topic_ouster_lidar_packets(mk::bag::string_t const& topic, bool* const out_satisfies);
+			template<typename data_source_t>
+			bool is_ouster_chunk_bz2(data_source_t& data_source, std::vector<chunk_entry_t> const& chunk_entries, std::vector<std::uint32_t> const& ouster_channels, bool* const out_is_bz2);
+			int get_threads_count(pcap_options_t const& options, bool const is_bz2);
+			template<typename data_source_t>
+			bool process_ouster_records(data_source_t& data_source, std::vector<chunk_entry_t> const& chunk_entries, std::vector<std::uint32_t> const& ouster_channels, time_window_t const& window, bool const huge_pages, std::vector<pcap_sink_t>& sinks);
+			template<typename data_source_t>
+			bool process_ouster_records_parallel(data_source_t& data_source, std::vector<chunk_entry_t> const& chunk_entries, std::vector<std::uint32_t> const& ouster_channels, time_window_t const& window, int const threads_count, bool const huge_pages, bool const pwrite, std::vector<pcap_sink_t>& sinks);
+			template<typename data_source_t>
+			bool get_chunk_index_entries(data_source_t& data_source, chunk_entry_t const& chunk_entry, std::vector<std::uint32_t> const& connections, std::vector<mk::bag::data::index_data_ver_1_t>* const out_index_entries, bool* const out_found);
+			bool process_record_ouster_chunk(mk::bag::record_t const& record, std::vector<std::uint32_t> const& ouster_channels, time_window_t const& window, std::vector<mk::bag::data::index_data_ver_1_t> const* const index_entries, chunk_decompressor_t& decompressor, std::vector<ouster_packets_t>* const out_packets);
+			bool decompress_record_chunk_data(mk::bag::record_t const& record, chunk_decompressor_t& decompressor, void const** out_decompressed_data);
+			bool decompress_bz2(void const* const input, int const input_len, void* const output, int const output_len);
+			bool process_inner_ouster_record(mk::bag::record_t const& record, std::vector<std::uint32_t> const& ouster_channels, time_window_t const& window, std::vector<ouster_packets_t>* const out_packets);
+			void make_ouster_packet_header(unsigned char* const out_header);
+			void stamp_ouster_packets(ouster_packets_t& packets, std::uint64_t const first_packet_idx);
+			void gather_ouster_packets(ouster_packets_t const& packets, std::vector<mk::write_only_file_buffer_t>& buffers);
+			bool write_ouster_packets(mk::write_only_file_t& file, std::uint64_t const offset, ouster_packets_t const& packets, mk::read_only_memory_mapped_file_t const* const input_file, std::vector<mk::write_only_file_buffer_t>& buffers);
+			bool commit_ouster_packets(pcap_sink_t& sink, ouster_packets_t& packets);
+			bool commit_lidars_packets(std::vector<pcap_sink_t>& sinks, std::vector<ouster_packets_t>& packets);
+			bool stream_input(pcap_sink_t& sink, std::uint64_t const position);
+			bool stream_output(pcap_sink_t& sink, std::uint64_t const written_end);
+			bool stage_output(pcap_sink_t& sink, mk::write_only_file_buffer_t const* const buffers, int const buffers_count);
+			bool flush_output(pcap_sink_t& sink);
 
 
 		}
@@ -1,11 +1,32 @@
+// 64 bit off_t and file offsets on 32 bit Linux too, bags are way over 2 GiB. Has to come before any system header.
+#if !defined(_MSC_VER) && !defined(_FILE_OFFSET_BITS)
+	#define _FILE_OFFSET_BITS 64
+#endif
+
 #include "bag.cpp"
+#include "bag_index.cpp"
+#include "bag_index_file.cpp"
 #include "bag_to_pcap.cpp"
 #include "bag_to_pcap_impl.cpp"
+#include "bag_tool_extract.cpp"
+#include "bag_tool_extract_impl.cpp"
 #include "bag_tool_info.cpp"
 #include "bag_tool_info_impl.cpp"
+#include "bag_tool_verify.cpp"
+#include "bag_tool_verify_impl.cpp"
+#include "command_line.cpp"
+#include "data_source_direct.cpp"
 #include "data_source_mem.cpp"
+#include "data_source_pipe.cpp"
 #include "data_source_rommf.cpp"
+#include "data_source_uring.cpp"
+#include "lz4_decompressor.cpp"
 #include "main.cpp"
+#include "raw_buffer.cpp"
 #include "read_only_memory_mapped_file.cpp"
 #include "read_only_memory_mapped_file_linux.cpp"
+#include "stream_decompressor.cpp"
 #include "utils.cpp"
+#include "worker_pool.cpp"
+#include "write_only_file.cpp"
+#include "write_only_file_linux.cpp"
@@ -0,0 +1,9 @@
+#include "bag_tool_extract.h"
+
+#include "bag_tool_extract_impl.h"
+
+
+bool mk::bag_tool::bag_extract(int const argc, native_char_t const* const* const argv)
+{
+	return mk::bag_tool::detail::bag_extract(argc, argv);
+}
@@ -0,0 +1,456 @@
+#include "bag_tool_extract_impl.h"
+
+#include "command_line.h"
+#include "data_source_mem.h"
+#include "data_source_pipe.h"
+#include "data_source_rommf.h"
+#include "overload.h"
+#include "read_only_memory_mapped_file.h"
+#include "utils.h"
+
+#include <algorithm> // std::find, std::all_of, std::any_of
+#include <cassert>
+#include <cstring> // std::memcpy
+#include <iterator> // std::size
+#include <limits>
+#include <string> // std::to_string
+
+
+bool mk::bag_tool::detail::bag_extract(int const argc, native_char_t const* const* const argv)
+{
+	CHECK_RET_F(argc >= 4);
+	extract_options_t options;
+	bool const options_parsed = parse_extract_options(argc - 4, argv + 4, &options);
+	CHECK_RET_F(options_parsed);
+	return bag_extract(argv[2], argv[3], options);
+}
+
+bool mk::bag_tool::detail::parse_extract_options(int const argc, native_char_t const* const* const argv, extract_options_t* const out_options)
+{
+	static constexpr native_char_t const s_option_topic_name[] = MK_TEXT("--topic");
+	static constexpr int const s_option_topic_name_len = static_cast<int>(std::size(s_option_topic_name)) - 1;
+	static constexpr native_char_t const s_option_start_name[] = MK_TEXT("--start");
+	static constexpr int const s_option_start_name_len = static_cast<int>(std::size(s_option_start_name)) - 1;
+	static constexpr native_char_t const s_option_end_name[] = MK_TEXT("--end");
+	static constexpr int const s_option_end_name_len = static_cast<int>(std::size(s_option_end_name)) - 1;
+	static constexpr native_char_t const s_option_no_index_name[] = MK_TEXT("--no-index");
+	static constexpr int const s_option_no_index_name_len = static_cast<int>(std::size(s_option_no_index_name)) - 1;
+
+	assert(out_options);
+	extract_options_t& options = *out_options;
+
+	options.m_topics.clear();
+	options.m_window.m_start = 0;
+	options.m_window.m_end = std::numeric_limits<std::uint64_t>::max();
+	options.m_index = true;
+	for(int i = 0; i != argc; ++i)
+	{
+		if(mk::command_line::is_equal(argv[i], s_option_topic_name, s_option_topic_name_len))
+		{
+			CHECK_RET_F(i + 1 != argc);
+			++i;
+			options.m_topics.push_back(argv[i]);
+		}
+		else if(mk::command_line::is_equal(argv[i], s_option_start_name, s_option_start_name_len))
+		{
+			CHECK_RET_F(i + 1 != argc);
+			++i;
+			bool const parsed = mk::command_line::parse_time(argv[i], &options.m_window.m_start);
+			CHECK_RET_F(parsed);
+		}
+		else if(mk::command_line::is_equal(argv[i], s_option_end_name, s_option_end_name_len))
+		{
+			CHECK_RET_F(i + 1 != argc);
+			++i;
+			bool const parsed = mk::command_line::parse_time(argv[i], &options.m_window.m_end);
+			CHECK_RET_F(parsed);
+		}
+		else if(mk::command_line::is_equal(argv[i], s_option_no_index_name, s_option_no_index_name_len))
+		{
+			options.m_index = false;
+		}
+		else
+		{
+			return false;
+		}
+	}
+	CHECK_RET_F(!options.m_topics.empty());
+	CHECK_RET_F(options.m_window.m_start <= options.m_window.m_end);
+
+	return true;
+}
+
+
+bool mk::bag_tool::detail::bag_extract(native_char_t const* const input_bag, native_char_t const* const output, extract_options_t const& options)
+{
+	bool compressed;
+	bool const sniffed = mk::data_source_pipe_t::is_compressed(input_bag, &compressed);
+	CHECK_RET_F(sniffed);
+	if(mk::data_source_pipe_t::is_stdin(input_bag) || compressed)
+	{
+		mk::data_source_pipe_t data_source_pipe = mk::data_source_pipe_t::make(input_bag);
+		CHECK_RET_F(data_source_pipe);
+		bool const extracted = bag_extract_pipe(data_source_pipe, output, options);
+		CHECK_RET_F(extracted);
+		CHECK_RET_F(!data_source_pipe.get_input_failed());
+		return true;
+	}
+
+	mk::bag_index_file_t index_file;
+	if(options.m_index)
+	{
+		index_file = mk::bag_index_file_t::open(input_bag);
+	}
+
+	mk::read_only_memory_mapped_file_t const rommf{input_bag};
+	if(rommf)
+	{
+		mk::data_source_mem_t data_source_mem = mk::data_source_mem_t::make(rommf.get_data(), static_cast<std::size_t>(rommf.get_size()));
+		CHECK_RET_F(data_source_mem);
+		bool const extracted = bag_extract(data_source_mem, index_file, output, options);
+		CHECK_RET_F(extracted);
+		return true;
+	}
+	else
+	{
+		mk::data_source_rommf_t data_source_rommf = mk::data_source_rommf_t::make(input_bag);
+		CHECK_RET_F(data_source_rommf);
+		bool const extracted = bag_extract(data_source_rommf, index_file, output, options);
+		CHECK_RET_F(extracted);
+		return true;
+	}
+}
+
+template<typename data_source_t>
+bool mk::bag_tool::detail::bag_extract(data_source_t& data_source, mk::bag_index_file_t const& index_file, native_char_t const* const output, extract_options_t const& options)
+{
+	struct helper_struct_t
+	{
+		extract_ctx_t& m_ctx;
+		std::vector<mk::bag::data::index_data_ver_1_t> m_index_entries;
+		bool m_indexed;
+	};
+
+	static constexpr auto const s_record_callback = [](void* const ctx, void* const data, bool& keep_iterating) -> bool
+	{
+		helper_struct_t& helper = *static_cast<helper_struct_t*>(ctx);
+		mk::bag::record_t const& record = *static_cast<mk::bag::record_t const*>(data);
+
+		bool const is_chunk = std::visit(mk::make_overload([](mk::bag::header::chunk_t const&) -> bool { return true; }, [](...) -> bool { return false; }), record.m_header);
+		CHECK_RET_F(is_chunk);
+
+		std::vector<mk::bag::data::index_data_ver_1_t> const* const index_entries = helper.m_indexed ? &helper.m_index_entries : nullptr;
+		bool const processed = process_extract_chunk(helper.m_ctx, record, index_entries);
+		CHECK_RET_F(processed);
+
+		keep_iterating = false;
+		return true;
+	};
+	mk::bag::callback_t const callback = s_record_callback;
+
+	CHECK_RET_F(mk::bag::is_bag_file(data_source));
+	data_source.consume(mk::bag::bag_file_header_len());
+
+	extract_ctx_t ctx{output, options, {}, {}, {}, std::vector<extract_output_t>(options.m_topics.size()), chunk_decompressor_t{}};
+	std::vector<chunk_entry_t> chunk_entries;
+	if(index_file)
+	{
+		std::vector<std::uint32_t> connection_idxs;
+		bool const got_connections = get_indexed_extract_connections(index_file, ctx, &connection_idxs);
+		CHECK_RET_F(got_connections);
+		bool const got_chunk_entries = get_indexed_chunk_entries(index_file, connection_idxs, &chunk_entries);
+		CHECK_RET_F(got_chunk_entries);
+	}
+	else
+	{
+		bool const got_connections = get_extract_connections(data_source, ctx);
+		CHECK_RET_F(got_connections);
+
+		data_source.move_to(0, mk::bag::bag_file_header_len());
+		data_source.consume(mk::bag::bag_file_header_len());
+		bool const got_chunk_entries = get_chunk_entries(data_source, &chunk_entries);
+		CHECK_RET_F(got_chunk_entries);
+	}
+	// Every topic asked for has to be there.
+	CHECK_RET_F(std::all_of(ctx.m_outputs.cbegin(), ctx.m_outputs.cend(), [](extract_output_t const& extract_output){ return static_cast<bool>(extract_output.m_file); }));
+	drop_chunks_outside_time_window(options.m_window, chunk_entries);
+
+	// Chunks without any of our topics are never read, the others are decompressed once for all of the topics.
+	helper_struct_t helper{ctx, {}, false};
+	for(chunk_entry_t const& chunk_entry : chunk_entries)
+	{
+		if(get_chunk_messages_count(chunk_entry, ctx.m_selected_connections) == 0)
+		{
+			continue;
+		}
+		bool const got_index_entries = get_chunk_index_entries(data_source, chunk_entry, ctx.m_selected_connections, &helper.m_index_entries, &helper.m_indexed);
+		CHECK_RET_F(got_index_entries);
+		data_source.move_to(chunk_entry.m_chunk_info.m_chunk_pos, 1);
+		bool const parsed = mk::bag::parse_records(data_source, callback, &helper);
+		CHECK_RET_F(parsed);
+	}
+
+	return true;
+}
+
+bool mk::bag_tool::detail::bag_extract_pipe(mk::data_source_pipe_t& data_source, native_char_t const* const output, extract_options_t const& options)
+{
+	static constexpr auto const s_record_callback = [](void* const ctx_, void* const data, [[maybe_unused]] bool& keep_iterating) -> bool
+	{
+		extract_ctx_t& ctx = *static_cast<extract_ctx_t*>(ctx_);
+		mk::bag::record_t const& record = *static_cast<mk::bag::record_t const*>(data);
+
+		// Forward only, every chunk is decompressed and connection records inside of it tell which messages are ours.
+		bool const is_chunk = std::visit(mk::make_overload([](mk::bag::header::chunk_t const&) -> bool { return true; }, [](...) -> bool { return false; }), record.m_header);
+		if(!is_chunk)
+		{
+			return true;
+		}
+		bool const processed = process_extract_chunk(ctx, record, nullptr);
+		CHECK_RET_F(processed);
+
+		return true;
+	};
+	mk::bag::callback_t const callback = s_record_callback;
+
+	CHECK_RET_F(mk::bag::is_bag_file(data_source));
+	data_source.consume(mk::bag::bag_file_header_len());
+
+	extract_ctx_t ctx{output, options, {}, {}, {}, std::vector<extract_output_t>(options.m_topics.size()), chunk_decompressor_t{}};
+	bool const parsed = mk::bag::parse_records(data_source, callback, &ctx);
+	CHECK_RET_F(parsed);
+	CHECK_RET_F(std::all_of(ctx.m_outputs.cbegin(), ctx.m_outputs.cend(), [](extract_output_t const& extract_output){ return static_cast<bool>(extract_output.m_file); }));
+
+	return true;
+}
+
+template<typename data_source_t>
+bool mk::bag_tool::detail::get_extract_connections(data_source_t& data_source, extract_ctx_t& ctx)
+{
+	std::uint64_t connections_offset;
+	bool const got_connections_offset = get_connections_offset(data_source, &connections_offset);
+	CHECK_RET_F(got_connections_offset);
+	CHECK_RET_F(connections_offset < data_source.get_input_size());
+	data_source.move_to(connections_offset, 1);
+
+	static constexpr auto const s_record_callback = [](void* const ctx_, void* const data, bool& keep_iterating) -> bool
+	{
+		extract_ctx_t& ctx = *static_cast<extract_ctx_t*>(ctx_);
+		mk::bag::record_t const& record = *static_cast<mk::bag::record_t const*>(data);
+
+		bool const is_connection = std::visit(mk::make_overload([](mk::bag::header::connection_t const&) -> bool { return true; }, [](...) -> bool { return false; }), record.m_header);
+		if(!is_connection)
+		{
+			keep_iterating = false;
+			return true;
+		}
+		mk::bag::header::connection_t const& connection = std::get<mk::bag::header::connection_t>(record.m_header);
+
+		bool const added = add_extract_connection(ctx, connection.m_conn, connection.m_topic);
+		CHECK_RET_F(added);
+
+		return true;
+	};
+	mk::bag::callback_t const callback = s_record_callback;
+
+	bool const file_parsed = mk::bag::parse_records(data_source, callback, &ctx);
+	CHECK_RET_F(file_parsed);
+
+	return true;
+}
+
+bool mk::bag_tool::detail::get_indexed_extract_connections(mk::bag_index_file_t const& index_file, extract_ctx_t& ctx, std::vector<std::uint32_t>* const out_connection_idxs)
+{
+	assert(index_file);
+	assert(out_connection_idxs);
+	std::vector<std::uint32_t>& connection_idxs = *out_connection_idxs;
+
+	connection_idxs.clear();
+	for(std::uint32_t i = 0; i != index_file.get_connections_count(); ++i)
+	{
+		std::size_t const selected_count = ctx.m_selected_connections.size();
+		bool const added = add_extract_connection(ctx, index_file.get_connection(i).m_conn, index_file.get_topic(i));
+		CHECK_RET_F(added);
+		if(ctx.m_selected_connections.size() != selected_count)
+		{
+			connection_idxs.push_back(i);
+		}
+	}
+
+	return true;
+}
+
+bool mk::bag_tool::detail::add_extract_connection(extract_ctx_t& ctx, std::uint32_t const conn, mk::bag::string_t const& topic)
+{
+	bool const is_known = std::find(ctx.m_connections.cbegin(), ctx.m_connections.cend(), conn) != ctx.m_connections.cend();
+	if(is_known)
+	{
+		return true;
+	}
+	ctx.m_connections.push_back(conn);
+
+	std::vector<native_char_t const*> const& topics = ctx.m_options.m_topics;
+	auto const it = std::find_if(topics.cbegin(), topics.cend(), [&](native_char_t const* const name){ return is_topic_equal(topic, name); });
+	if(it == topics.cend())
+	{
+		return true;
+	}
+	std::size_t const output_idx = static_cast<std::size_t>(it - topics.cbegin());
+	ctx.m_selected_connections.push_back(conn);
+	ctx.m_selected_outputs.push_back(output_idx);
+
+	// Several publishers of one topic share its output, it is opened once the first of them shows up.
+	extract_output_t& extract_output = ctx.m_outputs[output_idx];
+	if(extract_output.m_file)
+	{
+		return true;
+	}
+	extract_output.m_path = topics.size() == 1 ? std::basic_string<native_char_t>{ctx.m_output} : get_topic_output_path(ctx.m_output, topic);
+	auto const is_taken = [&](){ return std::any_of(ctx.m_outputs.cbegin(), ctx.m_outputs.cend(), [&](extract_output_t const& e){ return &e != &extract_output && e.m_path == extract_output.m_path; }); };
+	if(is_taken())
+	{
+		// "/gnss/fix" and "gnss/fix" make the same name, tell them apart by their place on the command line.
+		std::string const unique_topic = std::string{topic.m_begin, topic.m_begin + topic.m_len} + "_" + std::to_string(output_idx);
+		extract_output.m_path = get_topic_output_path(ctx.m_output, mk::bag::string_t{unique_topic.c_str(), static_cast<int>(unique_topic.size())});
+	}
+	CHECK_RET_F(!is_taken());
+	extract_output.m_file = mk::write_only_file_t{extract_output.m_path.c_str()};
+	CHECK_RET_F(extract_output.m_file);
+	extract_output.m_size = 0;
+
+	return true;
+}
+
+bool mk::bag_tool::detail::process_extract_chunk(extract_ctx_t& ctx, mk::bag::record_t const& record, std::vector<mk::bag::data::index_data_ver_1_t> const* const index_entries)
+{
+	assert(std::visit(mk::make_overload([](mk::bag::header::chunk_t const&) -> bool { return true; }, [](...) -> bool { return false; }), record.m_header));
+	mk::bag::header::chunk_t const& chunk = std::get<mk::bag::header::chunk_t>(record.m_header);
+
+	static constexpr auto const s_record_callback = [](void* const ctx_, void* const data, [[maybe_unused]] bool& keep_iterating) -> bool
+	{
+		extract_ctx_t& ctx = *static_cast<extract_ctx_t*>(ctx_);
+		mk::bag::record_t const& record = *static_cast<mk::bag::record_t const*>(data);
+
+		bool const processed = process_extract_record(ctx, record);
+		CHECK_RET_F(processed);
+
+		return true;
+	};
+	mk::bag::callback_t const callback = s_record_callback;
+
+	static constexpr auto const s_indexed_record_callback = [](void* const ctx_, void* const data, bool& keep_iterating) -> bool
+	{
+		extract_ctx_t& ctx = *static_cast<extract_ctx_t*>(ctx_);
+		mk::bag::record_t const& record = *static_cast<mk::bag::record_t const*>(data);
+
+		bool const is_message_data = std::visit(mk::make_overload([](mk::bag::header::message_data_t const&) -> bool { return true; }, [](...) -> bool { return false; }), record.m_header);
+		CHECK_RET_F(is_message_data);
+		std::uint32_t const conn = std::get<mk::bag::header::message_data_t>(record.m_header).m_conn;
+		CHECK_RET_F(std::find(ctx.m_selected_connections.cbegin(), ctx.m_selected_connections.cend(), conn) != ctx.m_selected_connections.cend());
+
+		bool const processed = process_extract_record(ctx, record);
+		CHECK_RET_F(processed);
+
+		keep_iterating = false;
+		return true;
+	};
+	mk::bag::callback_t const indexed_callback = s_indexed_record_callback;
+
+	void const* decompressed_data;
+	bool const decompressed = decompress_record_chunk_data(record, ctx.m_decompressor, &decompressed_data);
+	CHECK_RET_F(decompressed);
+
+	mk::data_source_mem_t data_source = mk::data_source_mem_t::make(decompressed_data, chunk.m_size);
+	if(index_entries == nullptr)
+	{
+		bool const parsed = mk::bag::parse_records(data_source, callback, &ctx);
+		CHECK_RET_F(parsed);
+	}
+	else
+	{
+		for(mk::bag::data::index_data_ver_1_t const& index_entry : *index_entries)
+		{
+			CHECK_RET_F(index_entry.m_offset < chunk.m_size);
+			if(!is_in_time_window(ctx.m_options.m_window, index_entry.m_time))
+			{
+				continue;
+			}
+			data_source.move_to(index_entry.m_offset, 1);
+			bool const parsed = mk::bag::parse_records(data_source, indexed_callback, &ctx);
+			CHECK_RET_F(parsed);
+		}
+	}
+	// Payloads point into the decompressed chunk, they have to be out before the next chunk takes its place.
+	bool const flushed = flush_extract_outputs(ctx);
+	CHECK_RET_F(flushed);
+
+	return true;
+}
+
+bool mk::bag_tool::detail::process_extract_record(extract_ctx_t& ctx, mk::bag::record_t const& record)
+{
+	bool const is_connection = std::visit(mk::make_overload([](mk::bag::header::connection_t const&) -> bool { return true; }, [](...) -> bool { return false; }), record.m_header);
+	if(is_connection)
+	{
+		mk::bag::header::connection_t const& connection = std::get<mk::bag::header::connection_t>(record.m_header);
+		bool const added = add_extract_connection(ctx, connection.m_conn, connection.m_topic);
+		CHECK_RET_F(added);
+		return true;
+	}
+
+	bool const is_message_data = std::visit(mk::make_overload([](mk::bag::header::message_data_t const&) -> bool { return true; }, [](...) -> bool { return false; }), record.m_header);
+	if(!is_message_data)
+	{
+		return true;
+	}
+	mk::bag::header::message_data_t const& message_data = std::get<mk::bag::header::message_data_t>(record.m_header);
+	auto const it = std::find(ctx.m_selected_connections.cbegin(), ctx.m_selected_connections.cend(), message_data.m_conn);
+	if(it == ctx.m_selected_connections.cend())
+	{
+		return true;
+	}
+	if(!is_in_time_window(ctx.m_options.m_window, message_data.m_time))
+	{
+		return true;
+	}
+	extract_output_t& extract_output = ctx.m_outputs[ctx.m_selected_outputs[it - ctx.m_selected_connections.cbegin()]];
+
+	std::uint64_t const time_ns = mk::bag::get_time_ns(message_data.m_time);
+	std::uint32_t const len = static_cast<std::uint32_t>(record.m_data.m_len);
+	std::size_t const header_pos = extract_output.m_headers.size();
+	extract_output.m_headers.resize(header_pos + s_extract_header_len);
+	std::memcpy(extract_output.m_headers.data() + header_pos + 0, &time_ns, sizeof(time_ns));
+	std::memcpy(extract_output.m_headers.data() + header_pos + 8, &len, sizeof(len));
+	extract_output.m_payloads.push_back(mk::write_only_file_buffer_t{record.m_data.m_begin, static_cast<std::size_t>(record.m_data.m_len)});
+
+	return true;
+}
+
+bool mk::bag_tool::detail::flush_extract_outputs(extract_ctx_t& ctx)
+{
+	// One gather write per topic and chunk.
+	for(extract_output_t& extract_output : ctx.m_outputs)
+	{
+		if(extract_output.m_payloads.empty())
+		{
+			continue;
+		}
+		std::size_t const count = extract_output.m_payloads.size();
+		assert(extract_output.m_headers.size() == count * s_extract_header_len);
+		std::uint64_t size = 0;
+		extract_output.m_buffers.resize(count * 2);
+		for(std::size_t i = 0; i != count; ++i)
+		{
+			extract_output.m_buffers[i * 2 + 0] = mk::write_only_file_buffer_t{extract_output.m_headers.data() + i * s_extract_header_len, s_extract_header_len};
+			extract_output.m_buffers[i * 2 + 1] = extract_output.m_payloads[i];
+			size += s_extract_header_len + extract_output.m_payloads[i].m_size;
+		}
+		bool const written = extract_output.m_file.write_at(extract_output.m_size, extract_output.m_buffers.data(), static_cast<int>(extract_output.m_buffers.size()));
+		CHECK_RET_F(written);
+		extract_output.m_size += size;
+		extract_output.m_headers.clear();
+		extract_output.m_payloads.clear();
+	}
+
+	return true;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+
+#include "bag.h"
+#include "bag_index_file.h"
+#include "bag_to_pcap_impl.h"
+#include "cross_platform.h"
+#include "write_only_file.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+namespace mk
+{
+	namespace bag_tool
+	{
+		namespace detail
+		{
+
+
+			// Output of /extract is a plain sequence of messages, each one is
+			// 8 bytes receive time in nanoseconds, 4 bytes payload length, both little endian, followed by the payload.
+			static constexpr int const s_extract_header_len = 12;
+
+			struct extract_options_t
+			{
+				std::vector<native_char_t const*> m_topics;
+				time_window_t m_window;
+				bool m_index;
+			};
+
+			struct extract_output_t
+			{
+				std::basic_string<native_char_t> m_path;
+				mk::write_only_file_t m_file;
+				std::uint64_t m_size;
+				std::vector<unsigned char> m_headers; // of messages of the current chunk
+				std::vector<mk::write_only_file_buffer_t> m_payloads; // point into the decompressed chunk
+				std::vector<mk::write_only_file_buffer_t> m_buffers;
+			};
+
+			struct extract_ctx_t
+			{
+				native_char_t const* m_output;
+				extract_options_t const& m_options;
+				std::vector<std::uint32_t> m_connections; // seen so far, of any topic
+				std::vector<std::uint32_t> m_selected_connections;
+				std::vector<std::size_t> m_selected_outputs; // output of each selected connection
+				std::vector<extract_output_t> m_outputs; // one per topic asked for, in order of the command line
+				chunk_decompressor_t m_decompressor;
+			};
+
+
+			bool bag_extract(int const argc, native_char_t const* const* const argv);
+			bool parse_extract_options(int const argc, native_char_t const* const* const argv, extract_options_t* const out_options);
+
+			bool bag_extract(native_char_t const* const input_bag, native_char_t const* const output, extract_options_t const& options);
+			template<typename data_source_t>
+			bool bag_extract(data_source_t& data_source, mk::bag_index_file_t const& index_file, native_char_t const* const output, extract_options_t const& options);
+			bool bag_extract_pipe(mk::data_source_pipe_t& data_source, native_char_t const* const output, extract_options_t const& options);
+			template<typename data_source_t>
+			bool get_extract_connections(data_source_t& data_source, extract_ctx_t& ctx);
+			bool get_indexed_extract_connections(mk::bag_index_file_t const& index_file, extract_ctx_t& ctx, std::vector<std::uint32_t>* const out_connection_idxs);
+			bool add_extract_connection(extract_ctx_t& ctx, std::uint32_t const conn, mk::bag::string_t const& topic);
+			bool process_extract_chunk(extract_ctx_t& ctx, mk::bag::record_t const& record, std::vector<mk::bag::data::index_data_ver_1_t> const* const index_entries);
+			bool process_extract_record(extract_ctx_t& ctx, mk::bag::record_t const& record);
+			bool flush_extract_outputs(extract_ctx_t& ctx);
+
+
+		}
+	}
+}
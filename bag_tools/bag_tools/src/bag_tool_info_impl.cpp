@@ -1,38 +1,206 @@
 #include "bag_tool_info_impl.h"
 
+#include "command_line.h"
+#include "data_source_direct.h"
 #include "data_source_mem.h"
+#include "data_source_pipe.h"
 #include "data_source_rommf.h"
 #include "overload.h"
 #include "read_only_memory_mapped_file.h"
 #include "utils.h"
 
+#include <algorithm> // std::find_if, std::sort, std::min, std::max, std::any_of, std::sample
 #include <cassert>
-#include <cinttypes> // PRIu32, PRIu64
+#include <charconv> // std::to_chars
+#include <cinttypes> // PRIu32, PRIu64, PRIx64
+#include <cmath> // std::sqrt
 #include <cstdio>
+#include <cstring> // std::strlen
+#include <iterator> // std::size
+#include <limits>
+#include <numeric> // std::iota
+#include <random> // std::mt19937_64
+#include <thread>
+
+
+static constexpr std::size_t const s_info_output_flush_size = 1 * 1024 * 1024;
+static constexpr std::uint64_t const s_info_sample_seed = 0x5A3D1E0C7B962F41ull; // same bag, same sample
+static constexpr double const s_info_sample_z = 1.96; // 95 % confidence
+static constexpr char const* const s_info_column_names[] =
+{
+	"index",
+	"type",
+	"ver",
+	"conn",
+	"topic",
+	"time",
+	"compression",
+	"size",
+	"index_pos",
+	"conn_count",
+	"chunk_count",
+	"chunk_pos",
+	"start_time",
+	"end_time",
+	"count",
+	"data_size",
+};
+static_assert(std::size(s_info_column_names) == static_cast<std::size_t>(mk::bag_tool::detail::info_column_e::data_size) + 1);
 
 
 mk::bag_tool::detail::bag_info_t::bag_info_t() :
 	m_counter(),
-	m_bag_hdr()
+	m_bag_hdr(),
+	m_format(),
+	m_output(),
+	m_column(),
+	m_fields_count()
 {
+	m_output.reserve(s_info_output_flush_size + 64 * 1024);
 }
 
 
 bool mk::bag_tool::detail::bag_info(int const argc, native_char_t const* const* const argv)
 {
-	CHECK_RET_F(argc == 3);
-	return bag_info(argv[2]);
+	CHECK_RET_F(argc >= 3);
+	info_options_t options;
+	bool const options_parsed = parse_info_options(argc - 3, argv + 3, &options);
+	CHECK_RET_F(options_parsed);
+	return bag_info(argv[2], options);
+}
+
+bool mk::bag_tool::detail::parse_info_options(int const argc, native_char_t const* const* const argv, info_options_t* const out_options)
+{
+	static constexpr native_char_t const s_option_direct_name[] = MK_TEXT("--direct");
+	static constexpr int const s_option_direct_name_len = static_cast<int>(std::size(s_option_direct_name)) - 1;
+	static constexpr native_char_t const s_option_summary_name[] = MK_TEXT("--summary");
+	static constexpr int const s_option_summary_name_len = static_cast<int>(std::size(s_option_summary_name)) - 1;
+	static constexpr native_char_t const s_option_format_name[] = MK_TEXT("--format");
+	static constexpr int const s_option_format_name_len = static_cast<int>(std::size(s_option_format_name)) - 1;
+	static constexpr native_char_t const s_format_text_name[] = MK_TEXT("text");
+	static constexpr int const s_format_text_name_len = static_cast<int>(std::size(s_format_text_name)) - 1;
+	static constexpr native_char_t const s_format_csv_name[] = MK_TEXT("csv");
+	static constexpr int const s_format_csv_name_len = static_cast<int>(std::size(s_format_csv_name)) - 1;
+	static constexpr native_char_t const s_format_jsonl_name[] = MK_TEXT("jsonl");
+	static constexpr int const s_format_jsonl_name_len = static_cast<int>(std::size(s_format_jsonl_name)) - 1;
+	static constexpr native_char_t const s_option_deep_name[] = MK_TEXT("--deep");
+	static constexpr int const s_option_deep_name_len = static_cast<int>(std::size(s_option_deep_name)) - 1;
+	static constexpr native_char_t const s_option_threads_name[] = MK_TEXT("-j");
+	static constexpr int const s_option_threads_name_len = static_cast<int>(std::size(s_option_threads_name)) - 1;
+	static constexpr int const s_max_threads_count = 1024;
+	static constexpr native_char_t const s_option_sample_name[] = MK_TEXT("--sample");
+	static constexpr int const s_option_sample_name_len = static_cast<int>(std::size(s_option_sample_name)) - 1;
+
+	assert(out_options);
+	info_options_t& options = *out_options;
+
+	options.m_direct = false;
+	options.m_summary = false;
+	options.m_format = info_format_e::text;
+	options.m_deep = false;
+	options.m_threads_count = 0;
+	options.m_sample_percent = 0;
+	for(int i = 0; i != argc; ++i)
+	{
+		if(mk::command_line::is_equal(argv[i], s_option_direct_name, s_option_direct_name_len))
+		{
+			options.m_direct = true;
+		}
+		else if(mk::command_line::is_equal(argv[i], s_option_summary_name, s_option_summary_name_len))
+		{
+			options.m_summary = true;
+		}
+		else if(mk::command_line::is_equal(argv[i], s_option_format_name, s_option_format_name_len))
+		{
+			CHECK_RET_F(i + 1 != argc);
+			++i;
+			if(mk::command_line::is_equal(argv[i], s_format_text_name, s_format_text_name_len))
+			{
+				options.m_format = info_format_e::text;
+			}
+			else if(mk::command_line::is_equal(argv[i], s_format_csv_name, s_format_csv_name_len))
+			{
+				options.m_format = info_format_e::csv;
+			}
+			else if(mk::command_line::is_equal(argv[i], s_format_jsonl_name, s_format_jsonl_name_len))
+			{
+				options.m_format = info_format_e::jsonl;
+			}
+			else
+			{
+				return false;
+			}
+		}
+		else if(mk::command_line::is_equal(argv[i], s_option_deep_name, s_option_deep_name_len))
+		{
+			options.m_deep = true;
+		}
+		else if(mk::command_line::is_equal(argv[i], s_option_threads_name, s_option_threads_name_len))
+		{
+			CHECK_RET_F(i + 1 != argc);
+			++i;
+			bool const parsed = mk::command_line::parse_int(argv[i], 1, s_max_threads_count, &options.m_threads_count);
+			CHECK_RET_F(parsed);
+		}
+		else if(mk::command_line::is_equal(argv[i], s_option_sample_name, s_option_sample_name_len))
+		{
+			CHECK_RET_F(i + 1 != argc);
+			++i;
+			bool const parsed = mk::command_line::parse_int(argv[i], 1, 100, &options.m_sample_percent);
+			CHECK_RET_F(parsed);
+		}
+		else
+		{
+			return false;
+		}
+	}
+	CHECK_RET_F(static_cast<int>(options.m_summary) + static_cast<int>(options.m_deep) + static_cast<int>(options.m_sample_percent != 0) <= 1);
+	CHECK_RET_F(!((options.m_summary || options.m_deep || options.m_sample_percent != 0) && options.m_format != info_format_e::text));
+	CHECK_RET_F(options.m_deep || options.m_threads_count == 0);
+
+	return true;
 }
 
 
-bool mk::bag_tool::detail::bag_info(native_char_t const* const input_bag)
+bool mk::bag_tool::detail::bag_info(native_char_t const* const input_bag, info_options_t const& options)
 {
+	bool compressed;
+	bool const sniffed = mk::data_source_pipe_t::is_compressed(input_bag, &compressed);
+	CHECK_RET_F(sniffed);
+	mk::bag_index_file_t index_file;
+	if(mk::data_source_pipe_t::is_stdin(input_bag) || compressed)
+	{
+		// Sampling seeks to chunks picked out of the index section at the end of the bag.
+		CHECK_RET_F(options.m_sample_percent == 0);
+		mk::data_source_pipe_t data_source_pipe = mk::data_source_pipe_t::make(input_bag);
+		CHECK_RET_F(data_source_pipe);
+		bool const processed = dispatch_bag_info(data_source_pipe, index_file, options);
+		CHECK_RET_F(processed);
+		CHECK_RET_F(!data_source_pipe.get_input_failed());
+		return true;
+	}
+
+	// Summary takes exact topic time spans from sidecar index when there is one, it is not built here as that would read index data of every chunk.
+	if(options.m_summary)
+	{
+		index_file = mk::bag_index_file_t::load(input_bag);
+	}
+
+	if(options.m_direct)
+	{
+		mk::data_source_direct_t data_source_direct = mk::data_source_direct_t::make(input_bag);
+		CHECK_RET_F(data_source_direct);
+		bool const processed = dispatch_bag_info(data_source_direct, index_file, options);
+		CHECK_RET_F(processed);
+		return true;
+	}
+
 	mk::read_only_memory_mapped_file_t const rommf{input_bag};
 	if(rommf)
 	{
 		mk::data_source_mem_t data_source_mem = mk::data_source_mem_t::make(rommf.get_data(), static_cast<std::size_t>(rommf.get_size()));
 		CHECK_RET_F(data_source_mem);
-		bool const processed = bag_info(data_source_mem);
+		bool const processed = dispatch_bag_info(data_source_mem, index_file, options);
 		CHECK_RET_F(processed);
 		return true;
 	}
@@ -40,14 +208,34 @@ bool mk::bag_tool::detail::bag_info(native_char_t const* const input_bag)
 	{
 		mk::data_source_rommf_t data_source_rommf = mk::data_source_rommf_t::make(input_bag);
 		CHECK_RET_F(data_source_rommf);
-		bool const processed = bag_info(data_source_rommf);
+		bool const processed = dispatch_bag_info(data_source_rommf, index_file, options);
 		CHECK_RET_F(processed);
 		return true;
 	}
 }
 
 template<typename data_source_t>
-bool mk::bag_tool::detail::bag_info(data_source_t& data_source)
+bool mk::bag_tool::detail::dispatch_bag_info(data_source_t& data_source, mk::bag_index_file_t const& index_file, info_options_t const& options)
+{
+	if(options.m_summary)
+	{
+		return bag_info_summary(data_source, index_file);
+	}
+	if(options.m_sample_percent != 0)
+	{
+		return bag_info_sample(data_source, options.m_sample_percent);
+	}
+	if(options.m_deep)
+	{
+		unsigned const hardware_threads_count = std::thread::hardware_concurrency();
+		int const threads_count = options.m_threads_count != 0 ? options.m_threads_count : hardware_threads_count == 0 ? 1 : static_cast<int>(hardware_threads_count);
+		return bag_info_deep(data_source, threads_count);
+	}
+	return bag_info(data_source, options.m_format);
+}
+
+template<typename data_source_t>
+bool mk::bag_tool::detail::bag_info(data_source_t& data_source, info_format_e const format)
 {
 	CHECK_RET_F(mk::bag::is_bag_file(data_source));
 	data_source.consume(mk::bag::bag_file_header_len());
@@ -68,17 +256,21 @@ bool mk::bag_tool::detail::bag_info(data_source_t& data_source)
 	mk::bag::callback_t const callback = s_record_callback;
 
 	bag_info_t bag_info;
+	bag_info.m_format = format;
+	write_info_csv_header(bag_info);
 	bool const records_parsed = mk::bag::parse_records(data_source, callback, &bag_info);
+	bool const flushed = flush_info_output(bag_info);
+	CHECK_RET_F(flushed);
+	CHECK_RET_F(records_parsed);
 
 	return true;
 }
 
 bool mk::bag_tool::detail::process_record(bag_info_t& bag_info, mk::bag::record_t const& record)
 {
-	std::uint32_t const counter = bag_info.m_counter;
 	char const* const type_name = get_record_type_name(record);
 
-	std::printf("%u, %s, ", counter, type_name);
+	begin_info_record(bag_info, type_name);
 
 	bool const type_processed = std::visit
 	(
@@ -95,7 +287,8 @@ bool mk::bag_tool::detail::process_record(bag_info_t& bag_info, mk::bag::record_
 	);
 	CHECK_RET_F(type_processed);
 
-	std::printf(", data size = %d\n" , record.m_data.m_len);
+	bool const record_ended = end_info_record(bag_info, record.m_data.m_len);
+	CHECK_RET_F(record_ended);
 
 	++bag_info.m_counter;
 
@@ -127,13 +320,9 @@ bool mk::bag_tool::detail::process_type(bag_info_t& bag_info, mk::bag::record_t
 
 	bag_info.m_bag_hdr = header;
 
-	std::printf
-	(
-		"index_pos = %" PRIu64 ", conn_count = %" PRIu32 ", chunk_count = %" PRIu32,
-		header.m_index_pos,
-		header.m_conn_count,
-		header.m_chunk_count
-	);
+	write_info_field(bag_info, info_column_e::index_pos, "index_pos", header.m_index_pos);
+	write_info_field(bag_info, info_column_e::conn_count, "conn_count", header.m_conn_count);
+	write_info_field(bag_info, info_column_e::chunk_count, "chunk_count", header.m_chunk_count);
 
 	return true;
 }
@@ -143,13 +332,8 @@ bool mk::bag_tool::detail::process_type(bag_info_t& bag_info, mk::bag::record_t
 	mk::bag::header::chunk_t const& header = std::get<mk::bag::header::chunk_t>(record.m_header);
 	CHECK_RET_F(bag_info.m_counter != 0);
 
-	std::printf
-	(
-		"compression = %.*s, size = %" PRIu32,
-		header.m_compression.m_len,
-		header.m_compression.m_begin,
-		header.m_size
-	);
+	write_info_field(bag_info, info_column_e::compression, "compression", header.m_compression);
+	write_info_field(bag_info, info_column_e::size, "size", header.m_size);
 
 	return true;
 }
@@ -159,13 +343,8 @@ bool mk::bag_tool::detail::process_type(bag_info_t& bag_info, mk::bag::record_t
 	mk::bag::header::connection_t const& header = std::get<mk::bag::header::connection_t>(record.m_header);
 	CHECK_RET_F(bag_info.m_counter != 0);
 
-	std::printf
-	(
-		"m_conn = %" PRIu32 ", m_topic = %.*s",
-		header.m_conn,
-		header.m_topic.m_len,
-		header.m_topic.m_begin
-	);
+	write_info_field(bag_info, info_column_e::conn, "m_conn", header.m_conn);
+	write_info_field(bag_info, info_column_e::topic, "m_topic", header.m_topic);
 
 	return true;
 }
@@ -175,12 +354,8 @@ bool mk::bag_tool::detail::process_type(bag_info_t& bag_info, mk::bag::record_t
 	mk::bag::header::message_data_t const& header = std::get<mk::bag::header::message_data_t>(record.m_header);
 	CHECK_RET_F(bag_info.m_counter != 0);
 
-	std::printf
-	(
-		"conn = %" PRIu32 ", time = %" PRIu64,
-		header.m_conn,
-		header.m_time
-	);
+	write_info_field(bag_info, info_column_e::conn, "conn", header.m_conn);
+	write_info_time_field(bag_info, info_column_e::time, "time", header.m_time);
 
 	return true;
 }
@@ -190,13 +365,9 @@ bool mk::bag_tool::detail::process_type(bag_info_t& bag_info, mk::bag::record_t
 	mk::bag::header::index_data_t const& header = std::get<mk::bag::header::index_data_t>(record.m_header);
 	CHECK_RET_F(bag_info.m_counter != 0);
 
-	std::printf
-	(
-		"ver = %" PRIu32 ", conn = %" PRIu32 ", count = %" PRIu32,
-		header.m_ver,
-		header.m_conn,
-		header.m_count
-	);
+	write_info_field(bag_info, info_column_e::ver, "ver", header.m_ver);
+	write_info_field(bag_info, info_column_e::conn, "conn", header.m_conn);
+	write_info_field(bag_info, info_column_e::count, "count", header.m_count);
 
 	return true;
 }
@@ -206,15 +377,982 @@ bool mk::bag_tool::detail::process_type(bag_info_t& bag_info, mk::bag::record_t
 	mk::bag::header::chunk_info_t const& header = std::get<mk::bag::header::chunk_info_t>(record.m_header);
 	CHECK_RET_F(bag_info.m_counter != 0);
 
+	write_info_field(bag_info, info_column_e::ver, "ver", header.m_ver);
+	write_info_field(bag_info, info_column_e::chunk_pos, "chunk_pos", header.m_chunk_pos);
+	write_info_time_field(bag_info, info_column_e::start_time, "start_time", header.m_start_time);
+	write_info_time_field(bag_info, info_column_e::end_time, "end_time", header.m_end_time);
+	write_info_field(bag_info, info_column_e::count, "count", header.m_count);
+
+	return true;
+}
+
+void mk::bag_tool::detail::write_info_csv_header(bag_info_t& bag_info)
+{
+	if(bag_info.m_format != info_format_e::csv)
+	{
+		return;
+	}
+	for(int i = 0; i != static_cast<int>(std::size(s_info_column_names)); ++i)
+	{
+		if(i != 0)
+		{
+			append_info_output(bag_info, ",");
+		}
+		append_info_output(bag_info, s_info_column_names[i]);
+	}
+	append_info_output(bag_info, "\n");
+}
+
+void mk::bag_tool::detail::begin_info_record(bag_info_t& bag_info, char const* const type_name)
+{
+	bag_info.m_fields_count = 0;
+	switch(bag_info.m_format)
+	{
+		case info_format_e::text:
+		{
+			append_info_number(bag_info, bag_info.m_counter);
+			append_info_output(bag_info, ", ");
+			append_info_output(bag_info, type_name);
+			append_info_output(bag_info, ", ");
+		}
+		break;
+		case info_format_e::csv:
+		{
+			append_info_number(bag_info, bag_info.m_counter);
+			append_info_output(bag_info, ",");
+			append_info_output(bag_info, type_name);
+			bag_info.m_column = static_cast<int>(info_column_e::type) + 1;
+		}
+		break;
+		case info_format_e::jsonl:
+		{
+			append_info_output(bag_info, "{\"index\":");
+			append_info_number(bag_info, bag_info.m_counter);
+			append_info_output(bag_info, ",\"type\":\"");
+			append_info_output(bag_info, type_name);
+			append_info_output(bag_info, "\"");
+		}
+		break;
+	}
+}
+
+bool mk::bag_tool::detail::end_info_record(bag_info_t& bag_info, int const data_size)
+{
+	if(bag_info.m_format == info_format_e::text)
+	{
+		append_info_output(bag_info, ", data size = ");
+	}
+	else
+	{
+		begin_info_field(bag_info, info_column_e::data_size, "data_size");
+	}
+	append_info_number(bag_info, static_cast<std::uint64_t>(data_size));
+	append_info_output(bag_info, bag_info.m_format == info_format_e::jsonl ? "}\n" : "\n");
+
+	// Few large writes instead of a formatted print per field.
+	if(bag_info.m_output.size() >= s_info_output_flush_size)
+	{
+		bool const flushed = flush_info_output(bag_info);
+		CHECK_RET_F(flushed);
+	}
+
+	return true;
+}
+
+void mk::bag_tool::detail::begin_info_field(bag_info_t& bag_info, info_column_e const column, char const* const text_name)
+{
+	switch(bag_info.m_format)
+	{
+		case info_format_e::text:
+		{
+			if(bag_info.m_fields_count != 0)
+			{
+				append_info_output(bag_info, ", ");
+			}
+			append_info_output(bag_info, text_name);
+			append_info_output(bag_info, " = ");
+		}
+		break;
+		case info_format_e::csv:
+		{
+			assert(static_cast<int>(column) >= bag_info.m_column);
+			for(int i = bag_info.m_column; i != static_cast<int>(column) + 1; ++i)
+			{
+				append_info_output(bag_info, ",");
+			}
+			bag_info.m_column = static_cast<int>(column) + 1;
+		}
+		break;
+		case info_format_e::jsonl:
+		{
+			append_info_output(bag_info, ",\"");
+			append_info_output(bag_info, s_info_column_names[static_cast<int>(column)]);
+			append_info_output(bag_info, "\":");
+		}
+		break;
+	}
+	++bag_info.m_fields_count;
+}
+
+void mk::bag_tool::detail::write_info_field(bag_info_t& bag_info, info_column_e const column, char const* const text_name, std::uint64_t const value)
+{
+	begin_info_field(bag_info, column, text_name);
+	append_info_number(bag_info, value);
+}
+
+void mk::bag_tool::detail::write_info_field(bag_info_t& bag_info, info_column_e const column, char const* const text_name, mk::bag::string_t const& value)
+{
+	begin_info_field(bag_info, column, text_name);
+	append_info_string(bag_info, value);
+}
+
+void mk::bag_tool::detail::write_info_time_field(bag_info_t& bag_info, info_column_e const column, char const* const text_name, std::uint64_t const time)
+{
+	// Text keeps the value as stored, machine readable formats get nanoseconds which order and subtract as they should.
+	begin_info_field(bag_info, column, text_name);
+	append_info_number(bag_info, bag_info.m_format == info_format_e::text ? time : mk::bag::get_time_ns(time));
+}
+
+void mk::bag_tool::detail::append_info_output(bag_info_t& bag_info, char const* const data, std::size_t const len)
+{
+	bag_info.m_output.insert(bag_info.m_output.end(), data, data + len);
+}
+
+void mk::bag_tool::detail::append_info_output(bag_info_t& bag_info, char const* const str)
+{
+	append_info_output(bag_info, str, std::strlen(str));
+}
+
+void mk::bag_tool::detail::append_info_number(bag_info_t& bag_info, std::uint64_t const value)
+{
+	char buffer[20];
+	std::to_chars_result const converted = std::to_chars(buffer, buffer + std::size(buffer), value);
+	assert(converted.ec == std::errc{});
+	append_info_output(bag_info, buffer, static_cast<std::size_t>(converted.ptr - buffer));
+}
+
+void mk::bag_tool::detail::append_info_string(bag_info_t& bag_info, mk::bag::string_t const& value)
+{
+	static constexpr char const s_hex_digits[] = "0123456789abcdef";
+
+	switch(bag_info.m_format)
+	{
+		case info_format_e::text:
+		{
+			append_info_output(bag_info, value.m_begin, static_cast<std::size_t>(value.m_len));
+		}
+		break;
+		case info_format_e::csv:
+		{
+			bool const needs_quotes = std::any_of(value.m_begin, value.m_begin + value.m_len, [](char const ch){ return ch == ',' || ch == '"' || ch == '\n' || ch == '\r'; });
+			if(!needs_quotes)
+			{
+				append_info_output(bag_info, value.m_begin, static_cast<std::size_t>(value.m_len));
+				break;
+			}
+			append_info_output(bag_info, "\"");
+			for(int i = 0; i != value.m_len; ++i)
+			{
+				append_info_output(bag_info, value.m_begin[i] == '"' ? "\"\"" : value.m_begin + i, value.m_begin[i] == '"' ? 2 : 1);
+			}
+			append_info_output(bag_info, "\"");
+		}
+		break;
+		case info_format_e::jsonl:
+		{
+			append_info_output(bag_info, "\"");
+			for(int i = 0; i != value.m_len; ++i)
+			{
+				unsigned char const ch = static_cast<unsigned char>(value.m_begin[i]);
+				if(ch == '"' || ch == '\\')
+				{
+					char const escaped[] = {'\\', static_cast<char>(ch)};
+					append_info_output(bag_info, escaped, std::size(escaped));
+				}
+				else if(ch < 0x20)
+				{
+					char const escaped[] = {'\\', 'u', '0', '0', s_hex_digits[ch >> 4], s_hex_digits[ch & 0xF]};
+					append_info_output(bag_info, escaped, std::size(escaped));
+				}
+				else
+				{
+					append_info_output(bag_info, value.m_begin + i, 1);
+				}
+			}
+			append_info_output(bag_info, "\"");
+		}
+		break;
+	}
+}
+
+bool mk::bag_tool::detail::flush_info_output(bag_info_t& bag_info)
+{
+	if(bag_info.m_output.empty())
+	{
+		return true;
+	}
+	std::size_t const size = bag_info.m_output.size();
+	std::size_t const written = std::fwrite(bag_info.m_output.data(), 1, size, stdout);
+	bag_info.m_output.clear();
+	CHECK_RET_F(written == size);
+	return true;
+}
+
+
+template<typename data_source_t>
+bool mk::bag_tool::detail::bag_info_summary(data_source_t& data_source, mk::bag_index_file_t const& index_file)
+{
+	static constexpr auto const s_record_callback = [](void* const ctx, void* const data, bool& keep_iterating) -> bool
+	{
+		assert(ctx);
+		assert(data);
+
+		bag_summary_t& summary = *static_cast<bag_summary_t*>(ctx);
+		mk::bag::record_t const& record = *static_cast<mk::bag::record_t const*>(data);
+
+		bool const record_processed = process_summary_record(summary, record);
+		CHECK_RET_F(record_processed);
+
+		keep_iterating = false;
+		return true;
+	};
+	mk::bag::callback_t const callback = s_record_callback;
+
+	bag_summary_t summary;
+	bool const got_index = get_summary_index(data_source, &summary);
+	CHECK_RET_F(got_index);
+
+	// Header of each chunk, chunk data is neither read nor decompressed.
+	for(std::uint64_t const chunk_pos : summary.m_chunk_positions)
+	{
+		CHECK_RET_F(chunk_pos >= static_cast<std::uint64_t>(mk::bag::bag_file_header_len()) && chunk_pos < summary.m_bag_hdr.m_index_pos);
+		data_source.move_to(chunk_pos, 1);
+		bool const chunk_parsed = mk::bag::parse_records(data_source, callback, &summary);
+		CHECK_RET_F(chunk_parsed);
+	}
+	std::uint64_t chunks_count = 0;
+	for(summary_compression_t const& compression : summary.m_compressions)
+	{
+		chunks_count += compression.m_chunks_count;
+	}
+	CHECK_RET_F(chunks_count == summary.m_chunk_positions.size());
+
+	apply_summary_index_file(summary, index_file);
+	print_summary(summary);
+
+	return true;
+}
+
+template<typename data_source_t>
+bool mk::bag_tool::detail::get_summary_index(data_source_t& data_source, bag_summary_t* const out_summary)
+{
+	static constexpr auto const s_record_callback = [](void* const ctx, void* const data, bool& keep_iterating) -> bool
+	{
+		assert(ctx);
+		assert(data);
+
+		bag_summary_t& summary = *static_cast<bag_summary_t*>(ctx);
+		mk::bag::record_t const& record = *static_cast<mk::bag::record_t const*>(data);
+
+		bool const record_processed = process_summary_record(summary, record);
+		CHECK_RET_F(record_processed);
+
+		keep_iterating = false;
+		return true;
+	};
+	mk::bag::callback_t const callback = s_record_callback;
+
+	static constexpr auto const s_index_record_callback = [](void* const ctx, void* const data, [[maybe_unused]] bool& keep_iterating) -> bool
+	{
+		assert(ctx);
+		assert(data);
+
+		bag_summary_t& summary = *static_cast<bag_summary_t*>(ctx);
+		mk::bag::record_t const& record = *static_cast<mk::bag::record_t const*>(data);
+
+		bool const record_processed = process_summary_record(summary, record);
+		CHECK_RET_F(record_processed);
+
+		return true;
+	};
+	mk::bag::callback_t const index_callback = s_index_record_callback;
+
+	assert(out_summary);
+	bag_summary_t& summary = *out_summary;
+
+	CHECK_RET_F(mk::bag::is_bag_file(data_source));
+	data_source.consume(mk::bag::bag_file_header_len());
+
+	summary = bag_summary_t{};
+	summary.m_bag_size = data_source.get_input_size();
+	summary.m_start_time = std::numeric_limits<std::uint64_t>::max();
+	summary.m_end_time = 0;
+
+	// Bag header record and the index section it points to.
+	bool const bag_parsed = mk::bag::parse_records(data_source, callback, &summary);
+	CHECK_RET_F(bag_parsed);
+	CHECK_RET_F(summary.m_bag_hdr_seen);
+	CHECK_RET_F(summary.m_bag_hdr.m_index_pos >= static_cast<std::uint64_t>(mk::bag::bag_file_header_len()) && summary.m_bag_hdr.m_index_pos < data_source.get_input_size());
+	data_source.move_to(summary.m_bag_hdr.m_index_pos, 1);
+	bool const index_parsed = mk::bag::parse_records(data_source, index_callback, &summary);
+	CHECK_RET_F(index_parsed);
+
+	return true;
+}
+
+bool mk::bag_tool::detail::bag_info_summary(mk::data_source_pipe_t& data_source, [[maybe_unused]] mk::bag_index_file_t const& index_file)
+{
+	static constexpr auto const s_record_callback = [](void* const ctx, void* const data, [[maybe_unused]] bool& keep_iterating) -> bool
+	{
+		assert(ctx);
+		assert(data);
+
+		bag_summary_t& summary = *static_cast<bag_summary_t*>(ctx);
+		mk::bag::record_t const& record = *static_cast<mk::bag::record_t const*>(data);
+
+		bool const record_processed = process_summary_record(summary, record);
+		CHECK_RET_F(record_processed);
+
+		return true;
+	};
+	mk::bag::callback_t const callback = s_record_callback;
+
+	CHECK_RET_F(mk::bag::is_bag_file(data_source));
+	data_source.consume(mk::bag::bag_file_header_len());
+
+	bag_summary_t summary{};
+	summary.m_start_time = std::numeric_limits<std::uint64_t>::max();
+	summary.m_end_time = 0;
+
+	// No seeking here, chunks flow by without being decompressed and the index section comes last.
+	bool const parsed = mk::bag::parse_records(data_source, callback, &summary);
+	CHECK_RET_F(parsed);
+	CHECK_RET_F(summary.m_bag_hdr_seen);
+	summary.m_bag_size = data_source.get_input_position();
+	std::uint64_t chunks_count = 0;
+	for(summary_compression_t const& compression : summary.m_compressions)
+	{
+		chunks_count += compression.m_chunks_count;
+	}
+	CHECK_RET_F(chunks_count == summary.m_chunk_positions.size());
+
+	print_summary(summary);
+
+	return true;
+}
+
+bool mk::bag_tool::detail::process_summary_record(bag_summary_t& summary, mk::bag::record_t const& record)
+{
+	bool const type_processed = std::visit
+	(
+		make_overload
+		(
+			[&](mk::bag::header::bag_t const& header) -> bool
+			{
+				CHECK_RET_F(!summary.m_bag_hdr_seen);
+				summary.m_bag_hdr_seen = true;
+				summary.m_bag_hdr = header;
+				return true;
+			},
+			[&](mk::bag::header::chunk_t const& header) -> bool
+			{
+				auto const it = std::find_if(summary.m_compressions.begin(), summary.m_compressions.end(), [&](summary_compression_t const& compression){ return compression.m_name.compare(0, std::string::npos, header.m_compression.m_begin, header.m_compression.m_len) == 0; });
+				summary_compression_t& compression = it != summary.m_compressions.end() ? *it : summary.m_compressions.emplace_back(summary_compression_t{std::string{header.m_compression.m_begin, header.m_compression.m_begin + header.m_compression.m_len}, 0, 0, 0});
+				++compression.m_chunks_count;
+				compression.m_compressed_size += static_cast<std::uint64_t>(record.m_data.m_len);
+				compression.m_uncompressed_size += header.m_size;
+				return true;
+			},
+			[&](mk::bag::header::connection_t const&) -> bool { return process_summary_connection(summary, record); },
+			[&](mk::bag::header::chunk_info_t const&) -> bool { return process_summary_chunk_info(summary, record); },
+			[](...) -> bool { return true; }
+		),
+		record.m_header
+	);
+	CHECK_RET_F(type_processed);
+
+	return true;
+}
+
+bool mk::bag_tool::detail::process_summary_connection(bag_summary_t& summary, mk::bag::record_t const& record)
+{
+	struct fields_ctx_t
+	{
+		mk::bag::fields_t m_fields;
+		int m_count;
+	};
+
+	static constexpr auto const s_field_callback = [](void* const ctx, void* const data, [[maybe_unused]] bool& keep_iterating) -> bool
+	{
+		fields_ctx_t& fields_ctx = *static_cast<fields_ctx_t*>(ctx);
+		mk::bag::field_t const& field = *static_cast<mk::bag::field_t const*>(data);
+
+		CHECK_RET_F(fields_ctx.m_count != mk::bag::s_fields_max);
+		fields_ctx.m_fields[fields_ctx.m_count] = field;
+		++fields_ctx.m_count;
+
+		return true;
+	};
+	mk::bag::callback_t const field_callback = s_field_callback;
+
+	mk::bag::header::connection_t const& header = std::get<mk::bag::header::connection_t>(record.m_header);
+	bool const is_known = std::find_if(summary.m_connections.cbegin(), summary.m_connections.cend(), [&](summary_connection_t const& connection){ return connection.m_conn == header.m_conn; }) != summary.m_connections.cend();
+	CHECK_RET_F(!is_known);
+
+	// Type and md5sum live in the record data, which is itself a list of fields.
+	mk::data_source_mem_t data_source = mk::data_source_mem_t::make(record.m_data.m_begin, static_cast<std::size_t>(record.m_data.m_len));
+	CHECK_RET_F(data_source);
+	fields_ctx_t fields_ctx{};
+	bool const fields_parsed = mk::bag::parse_fields(data_source, field_callback, &fields_ctx);
+	CHECK_RET_F(fields_parsed);
+	mk::bag::data::connection_data_t connection_data;
+	bool const connection_data_parsed = mk::bag::parse_connection_data(fields_ctx.m_fields.data(), fields_ctx.m_count, &connection_data);
+	CHECK_RET_F(connection_data_parsed);
+
+	// Several publishers of one topic make one topic.
+	auto const it = std::find_if(summary.m_topics.begin(), summary.m_topics.end(), [&](summary_topic_t const& topic){ return topic.m_name.compare(0, std::string::npos, header.m_topic.m_begin, header.m_topic.m_len) == 0; });
+	std::uint32_t const topic_idx = static_cast<std::uint32_t>(it - summary.m_topics.begin());
+	if(it == summary.m_topics.end())
+	{
+		summary_topic_t topic;
+		topic.m_name.assign(header.m_topic.m_begin, header.m_topic.m_begin + header.m_topic.m_len);
+		topic.m_type.assign(connection_data.m_type.m_begin, connection_data.m_type.m_begin + connection_data.m_type.m_len);
+		topic.m_md5sum = connection_data.m_md5sum;
+		topic.m_connections_count = 0;
+		topic.m_messages_count = 0;
+		topic.m_start_time = std::numeric_limits<std::uint64_t>::max();
+		topic.m_end_time = 0;
+		summary.m_topics.push_back(std::move(topic));
+	}
+	++summary.m_topics[topic_idx].m_connections_count;
+	summary.m_connections.push_back(summary_connection_t{header.m_conn, topic_idx});
+
+	return true;
+}
+
+bool mk::bag_tool::detail::process_summary_chunk_info(bag_summary_t& summary, mk::bag::record_t const& record)
+{
+	mk::bag::header::chunk_info_t const& header = std::get<mk::bag::header::chunk_info_t>(record.m_header);
+	CHECK_RET_F(header.m_ver == 1);
+
+	std::uint64_t const start_time = mk::bag::get_time_ns(header.m_start_time);
+	std::uint64_t const end_time = mk::bag::get_time_ns(header.m_end_time);
+	summary.m_chunk_positions.push_back(header.m_chunk_pos);
+	summary.m_start_time = std::min(summary.m_start_time, start_time);
+	summary.m_end_time = std::max(summary.m_end_time, end_time);
+	for(std::uint32_t i = 0; i != header.m_count; ++i)
+	{
+		mk::bag::data::chunk_info_ver_1_t chunk_info_data;
+		bool const parsed = mk::bag::parse_chunk_info_data(record, i, &chunk_info_data);
+		CHECK_RET_F(parsed);
+		auto const it = std::find_if(summary.m_connections.cbegin(), summary.m_connections.cend(), [&](summary_connection_t const& connection){ return connection.m_conn == chunk_info_data.m_conn; });
+		CHECK_RET_F(it != summary.m_connections.cend());
+		summary_topic_t& topic = summary.m_topics[it->m_topic_idx];
+		topic.m_messages_count += chunk_info_data.m_count;
+		summary.m_messages_count += chunk_info_data.m_count;
+		if(chunk_info_data.m_count != 0)
+		{
+			topic.m_start_time = std::min(topic.m_start_time, start_time);
+			topic.m_end_time = std::max(topic.m_end_time, end_time);
+		}
+	}
+
+	return true;
+}
+
+void mk::bag_tool::detail::apply_summary_index_file(bag_summary_t& summary, mk::bag_index_file_t const& index_file)
+{
+	if(!index_file)
+	{
+		return;
+	}
+
+	// Sidecar keeps first and last message time of each connection, narrower than bounds of its chunks.
+	std::vector<summary_topic_t> topics = summary.m_topics;
+	for(summary_topic_t& topic : topics)
+	{
+		topic.m_start_time = std::numeric_limits<std::uint64_t>::max();
+		topic.m_end_time = 0;
+	}
+	for(std::uint32_t i = 0; i != index_file.get_connections_count(); ++i)
+	{
+		mk::bag_index_file_connection_t const& connection = index_file.get_connection(i);
+		auto const it = std::find_if(summary.m_connections.cbegin(), summary.m_connections.cend(), [&](summary_connection_t const& summary_connection){ return summary_connection.m_conn == connection.m_conn; });
+		if(it == summary.m_connections.cend())
+		{
+			return;
+		}
+		if(connection.m_messages_count == 0)
+		{
+			continue;
+		}
+		summary_topic_t& topic = topics[it->m_topic_idx];
+		topic.m_start_time = std::min(topic.m_start_time, mk::bag::get_time_ns(connection.m_start_time));
+		topic.m_end_time = std::max(topic.m_end_time, mk::bag::get_time_ns(connection.m_end_time));
+	}
+	summary.m_topics = std::move(topics);
+	summary.m_exact_spans = true;
+}
+
+void mk::bag_tool::detail::print_summary(bag_summary_t const& summary)
+{
+	std::uint64_t compressed_size = 0;
+	std::uint64_t uncompressed_size = 0;
+	for(summary_compression_t const& compression : summary.m_compressions)
+	{
+		compressed_size += compression.m_compressed_size;
+		uncompressed_size += compression.m_uncompressed_size;
+	}
+	bool const has_messages = summary.m_start_time <= summary.m_end_time;
+
+	std::printf("size = %" PRIu64 ", chunk data = %" PRIu64 ", uncompressed = %" PRIu64 "\n", summary.m_bag_size, compressed_size, uncompressed_size);
+	std::printf("start = ");
+	print_summary_time(has_messages ? summary.m_start_time : 0);
+	std::printf(", end = ");
+	print_summary_time(has_messages ? summary.m_end_time : 0);
+	std::printf(", duration = ");
+	print_summary_time(has_messages ? summary.m_end_time - summary.m_start_time : 0);
+	std::printf("\n");
+	std::printf("messages = %" PRIu64 ", topics = %zu, connections = %zu, chunks = %zu\n", summary.m_messages_count, summary.m_topics.size(), summary.m_connections.size(), summary.m_chunk_positions.size());
+	for(summary_compression_t const& compression : summary.m_compressions)
+	{
+		std::printf
+		(
+			"compression = %s, chunks = %" PRIu32 ", size = %" PRIu64 ", uncompressed = %" PRIu64 "\n",
+			compression.m_name.c_str(),
+			compression.m_chunks_count,
+			compression.m_compressed_size,
+			compression.m_uncompressed_size
+		);
+	}
+
+	std::vector<std::size_t> order(summary.m_topics.size());
+	std::iota(order.begin(), order.end(), std::size_t{0});
+	std::sort(order.begin(), order.end(), [&](std::size_t const a, std::size_t const b){ return summary.m_topics[a].m_name < summary.m_topics[b].m_name; });
+	for(std::size_t const topic_idx : order)
+	{
+		summary_topic_t const& topic = summary.m_topics[topic_idx];
+		bool const topic_has_messages = topic.m_start_time <= topic.m_end_time;
+		std::printf
+		(
+			"topic = %s, messages = %" PRIu64 ", type = %s, md5sum = %016" PRIx64 "%016" PRIx64 ", connections = %" PRIu32 ", start = ",
+			topic.m_name.c_str(),
+			topic.m_messages_count,
+			topic.m_type.c_str(),
+			topic.m_md5sum.m_lo,
+			topic.m_md5sum.m_hi,
+			topic.m_connections_count
+		);
+		print_summary_time(topic_has_messages ? topic.m_start_time : 0);
+		std::printf(", end = ");
+		print_summary_time(topic_has_messages ? topic.m_end_time : 0);
+		std::printf("%s\n", summary.m_exact_spans ? "" : " (bounds of chunks)");
+	}
+}
+
+void mk::bag_tool::detail::print_summary_time(std::uint64_t const time_ns)
+{
+	std::printf("%" PRIu64 ".%09" PRIu64, time_ns / std::uint64_t{1'000'000'000}, time_ns % std::uint64_t{1'000'000'000});
+}
+
+
+template<typename data_source_t>
+bool mk::bag_tool::detail::bag_info_sample(data_source_t& data_source, int const sample_percent)
+{
+	static constexpr auto const s_record_callback = [](void* const ctx_, void* const data, bool& keep_iterating) -> bool
+	{
+		sample_ctx_t& ctx = *static_cast<sample_ctx_t*>(ctx_);
+		mk::bag::record_t const& record = *static_cast<mk::bag::record_t const*>(data);
+
+		bool const processed = process_sample_chunk(ctx, record);
+		CHECK_RET_F(processed);
+
+		keep_iterating = false;
+		return true;
+	};
+	mk::bag::callback_t const callback = s_record_callback;
+
+	bag_summary_t summary;
+	bool const got_index = get_summary_index(data_source, &summary);
+	CHECK_RET_F(got_index);
+
+	// Counts and time spans are exact from the index section, only sizes of messages come from the sample.
+	std::size_t const chunks_count = summary.m_chunk_positions.size();
+	std::size_t const sample_count = std::min(chunks_count, std::max<std::size_t>(1, (chunks_count * static_cast<std::size_t>(sample_percent) + 99) / 100));
+	std::vector<std::uint64_t> sample_positions;
+	sample_positions.reserve(sample_count);
+	std::mt19937_64 random_engine{s_info_sample_seed};
+	std::sample(summary.m_chunk_positions.cbegin(), summary.m_chunk_positions.cend(), std::back_inserter(sample_positions), sample_count, random_engine);
+	std::sort(sample_positions.begin(), sample_positions.end());
+
+	sample_ctx_t ctx{summary, std::vector<std::vector<std::uint32_t>>(summary.m_topics.size()), chunk_decompressor_t{}, 0, 0};
+	for(std::uint64_t const chunk_pos : sample_positions)
+	{
+		CHECK_RET_F(chunk_pos >= static_cast<std::uint64_t>(mk::bag::bag_file_header_len()) && chunk_pos < summary.m_bag_hdr.m_index_pos);
+		data_source.move_to(chunk_pos, 1);
+		bool const chunk_parsed = mk::bag::parse_records(data_source, callback, &ctx);
+		CHECK_RET_F(chunk_parsed);
+	}
+	CHECK_RET_F(ctx.m_chunks_count == sample_positions.size());
+
+	print_sample(ctx);
+
+	return true;
+}
+
+bool mk::bag_tool::detail::process_sample_chunk(sample_ctx_t& ctx, mk::bag::record_t const& record)
+{
+	static constexpr auto const s_record_callback = [](void* const ctx_, void* const data, [[maybe_unused]] bool& keep_iterating) -> bool
+	{
+		sample_ctx_t& ctx = *static_cast<sample_ctx_t*>(ctx_);
+		mk::bag::record_t const& record = *static_cast<mk::bag::record_t const*>(data);
+
+		bool const is_message_data = std::visit(mk::make_overload([](mk::bag::header::message_data_t const&) -> bool { return true; }, [](...) -> bool { return false; }), record.m_header);
+		if(!is_message_data)
+		{
+			return true;
+		}
+		std::uint32_t const conn = std::get<mk::bag::header::message_data_t>(record.m_header).m_conn;
+		auto const it = std::find_if(ctx.m_summary.m_connections.cbegin(), ctx.m_summary.m_connections.cend(), [&](summary_connection_t const& connection){ return connection.m_conn == conn; });
+		CHECK_RET_F(it != ctx.m_summary.m_connections.cend());
+		ctx.m_sizes[it->m_topic_idx].push_back(static_cast<std::uint32_t>(record.m_data.m_len));
+
+		return true;
+	};
+	mk::bag::callback_t const callback = s_record_callback;
+
+	bool const is_chunk = std::visit(mk::make_overload([](mk::bag::header::chunk_t const&) -> bool { return true; }, [](...) -> bool { return false; }), record.m_header);
+	CHECK_RET_F(is_chunk);
+	mk::bag::header::chunk_t const& chunk = std::get<mk::bag::header::chunk_t>(record.m_header);
+
+	void const* decompressed_data;
+	bool const decompressed = decompress_record_chunk_data(record, ctx.m_decompressor, &decompressed_data);
+	CHECK_RET_F(decompressed);
+
+	mk::data_source_mem_t data_source = mk::data_source_mem_t::make(decompressed_data, chunk.m_size);
+	bool const parsed = mk::bag::parse_records(data_source, callback, &ctx);
+	CHECK_RET_F(parsed);
+
+	++ctx.m_chunks_count;
+	ctx.m_chunks_size += static_cast<std::uint64_t>(record.m_data.m_len);
+
+	return true;
+}
+
+void mk::bag_tool::detail::print_sample(sample_ctx_t const& ctx)
+{
+	bag_summary_t const& summary = ctx.m_summary;
+
 	std::printf
 	(
-		"ver = %" PRIu32 ", chunk_pos = %" PRIu64 ", start_time = %" PRIu64 ", end_time = %" PRIu64 ", count = %" PRIu32,
-		header.m_ver,
-		header.m_chunk_pos,
-		header.m_start_time,
-		header.m_end_time,
-		header.m_count
+		"sampled chunks = %" PRIu64 " of %zu, chunk data read = %" PRIu64 ", messages = %" PRIu64 "\n",
+		ctx.m_chunks_count,
+		summary.m_chunk_positions.size(),
+		ctx.m_chunks_size,
+		summary.m_messages_count
 	);
 
+	std::vector<std::size_t> order(summary.m_topics.size());
+	std::iota(order.begin(), order.end(), std::size_t{0});
+	std::sort(order.begin(), order.end(), [&](std::size_t const a, std::size_t const b){ return summary.m_topics[a].m_name < summary.m_topics[b].m_name; });
+	double bytes_estimate = 0.0;
+	double bytes_variance = 0.0;
+	for(std::size_t const topic_idx : order)
+	{
+		summary_topic_t const& topic = summary.m_topics[topic_idx];
+		bool const has_messages = topic.m_start_time < topic.m_end_time;
+		double const rate = has_messages ? static_cast<double>(topic.m_messages_count) / (static_cast<double>(topic.m_end_time - topic.m_start_time) / 1'000'000'000.0) : 0.0;
+		std::printf("topic = %s, messages = %" PRIu64 ", rate = %.3f/s", topic.m_name.c_str(), topic.m_messages_count, rate);
+
+		std::vector<std::uint32_t> sizes = ctx.m_sizes[topic_idx];
+		if(sizes.empty())
+		{
+			std::printf(", sampled = 0\n");
+			continue;
+		}
+		std::sort(sizes.begin(), sizes.end());
+		double sum = 0.0;
+		for(std::uint32_t const size : sizes)
+		{
+			sum += static_cast<double>(size);
+		}
+		double const n = static_cast<double>(sizes.size());
+		double const mean = sum / n;
+		double squares = 0.0;
+		for(std::uint32_t const size : sizes)
+		{
+			squares += (static_cast<double>(size) - mean) * (static_cast<double>(size) - mean);
+		}
+		double const stddev = sizes.size() > 1 ? std::sqrt(squares / (n - 1.0)) : 0.0;
+
+		// Normal approximation, messages of sampled chunks taken as a simple random sample of the topic.
+		// Finite population correction brings the bound to zero once every message is sampled.
+		double const population = static_cast<double>(topic.m_messages_count);
+		double const correction = population > n ? std::sqrt((population - n) / (population - 1.0)) : 0.0;
+		double const topic_bytes = population * mean;
+		double const topic_bound = s_info_sample_z * population * stddev / std::sqrt(n) * correction;
+		bytes_estimate += topic_bytes;
+		bytes_variance += topic_bound * topic_bound;
+
+		std::printf
+		(
+			", sampled = %zu, size min = %" PRIu32 ", p50 = %" PRIu32 ", mean = %.1f, p95 = %" PRIu32 ", max = %" PRIu32 ", stddev = %.1f, message data = %.0f +- %.0f\n",
+			sizes.size(),
+			sizes.front(),
+			sizes[(sizes.size() - 1) / 2],
+			mean,
+			sizes[(sizes.size() * 95 + 99) / 100 - 1],
+			sizes.back(),
+			stddev,
+			topic_bytes,
+			topic_bound
+		);
+	}
+	std::printf("message data = %.0f +- %.0f (95 %% confidence)\n", bytes_estimate, std::sqrt(bytes_variance));
+}
+
+template<typename data_source_t>
+bool mk::bag_tool::detail::bag_info_deep(data_source_t& data_source, int const threads_count)
+{
+	static constexpr auto const s_record_callback = [](void* const ctx_, void* const data, [[maybe_unused]] bool& keep_iterating) -> bool
+	{
+		deep_ctx_t& ctx = *static_cast<deep_ctx_t*>(ctx_);
+		mk::bag::record_t const& record = *static_cast<mk::bag::record_t const*>(data);
+
+		bool const processed = process_deep_top_record(ctx, record);
+		CHECK_RET_F(processed);
+
+		return true;
+	};
+	mk::bag::callback_t const callback = s_record_callback;
+
+	static constexpr auto const s_task = []([[maybe_unused]] void* const ctx, [[maybe_unused]] int const thread_idx, void* const job_) -> bool
+	{
+		deep_chunk_job_t& job = *static_cast<deep_chunk_job_t*>(job_);
+
+		bool const processed = process_deep_chunk(job);
+		CHECK_RET_F(processed);
+
+		return true;
+	};
+	mk::worker_pool_t::task_t const task = s_task;
+
+	CHECK_RET_F(mk::bag::is_bag_file(data_source));
+	data_source.consume(mk::bag::bag_file_header_len());
+
+	int const max_jobs_count = threads_count * 2;
+	std::vector<deep_chunk_job_t> jobs(max_jobs_count);
+	deep_ctx_t ctx{};
+	ctx.m_free_jobs.resize(max_jobs_count);
+	std::transform(jobs.begin(), jobs.end(), ctx.m_free_jobs.begin(), [](deep_chunk_job_t& job){ return &job; });
+
+	// Chunks go to the workers as they come in the file, so any data source works, even a pipe. Workers keep tables of their own chunk only,
+	// these are merged on this thread in order of the file, which keeps gaps across chunk boundaries right.
+	mk::worker_pool_t worker_pool{threads_count, task, nullptr};
+	ctx.m_worker_pool = &worker_pool;
+	bool const parsed = mk::bag::parse_records(data_source, callback, &ctx);
+	while(worker_pool.get_jobs_count() != 0)
+	{
+		bool const committed = commit_deep_chunk(ctx);
+		CHECK_RET_F(committed);
+	}
+	CHECK_RET_F(parsed);
+
+	print_deep(ctx);
+
+	return true;
+}
+
+bool mk::bag_tool::detail::process_deep_top_record(deep_ctx_t& ctx, mk::bag::record_t const& record)
+{
+	bool const is_connection = std::visit(mk::make_overload([](mk::bag::header::connection_t const&) -> bool { return true; }, [](...) -> bool { return false; }), record.m_header);
+	if(is_connection)
+	{
+		mk::bag::header::connection_t const& connection = std::get<mk::bag::header::connection_t>(record.m_header);
+		add_deep_topic(ctx.m_topics, connection.m_conn, std::string{connection.m_topic.m_begin, connection.m_topic.m_begin + connection.m_topic.m_len});
+		return true;
+	}
+
+	bool const is_chunk = std::visit(mk::make_overload([](mk::bag::header::chunk_t const&) -> bool { return true; }, [](...) -> bool { return false; }), record.m_header);
+	if(!is_chunk)
+	{
+		return true;
+	}
+	mk::bag::header::chunk_t const& chunk = std::get<mk::bag::header::chunk_t>(record.m_header);
+
+	if(ctx.m_free_jobs.empty())
+	{
+		bool const committed = commit_deep_chunk(ctx);
+		CHECK_RET_F(committed);
+	}
+	deep_chunk_job_t& job = *ctx.m_free_jobs.back();
+	ctx.m_free_jobs.pop_back();
+	job.m_compression.assign(chunk.m_compression.m_begin, chunk.m_compression.m_begin + chunk.m_compression.m_len);
+	job.m_size = chunk.m_size;
+	job.m_chunk_data.assign(record.m_data.m_begin, record.m_data.m_begin + record.m_data.m_len);
+	job.m_stats.clear();
+	job.m_topics.clear();
+	ctx.m_worker_pool->push(&job);
+
+	++ctx.m_chunks_count;
+	ctx.m_compressed_size += static_cast<std::uint64_t>(record.m_data.m_len);
+	ctx.m_uncompressed_size += chunk.m_size;
+
+	return true;
+}
+
+bool mk::bag_tool::detail::process_deep_chunk(deep_chunk_job_t& job)
+{
+	static constexpr auto const s_record_callback = [](void* const ctx, void* const data, [[maybe_unused]] bool& keep_iterating) -> bool
+	{
+		deep_chunk_job_t& job = *static_cast<deep_chunk_job_t*>(ctx);
+		mk::bag::record_t const& record = *static_cast<mk::bag::record_t const*>(data);
+
+		bool const processed = process_deep_record(job, record);
+		CHECK_RET_F(processed);
+
+		return true;
+	};
+	mk::bag::callback_t const callback = s_record_callback;
+
+	mk::bag::record_t record;
+	mk::bag::header::chunk_t chunk;
+	chunk.m_compression.m_begin = job.m_compression.data();
+	chunk.m_compression.m_len = static_cast<int>(job.m_compression.size());
+	chunk.m_size = job.m_size;
+	record.m_header = chunk;
+	record.m_data.m_begin = job.m_chunk_data.data();
+	record.m_data.m_len = static_cast<int>(job.m_chunk_data.size());
+
+	void const* decompressed_data;
+	bool const decompressed = decompress_record_chunk_data(record, job.m_decompressor, &decompressed_data);
+	CHECK_RET_F(decompressed);
+
+	mk::data_source_mem_t data_source = mk::data_source_mem_t::make(decompressed_data, job.m_size);
+	bool const parsed = mk::bag::parse_records(data_source, callback, &job);
+	CHECK_RET_F(parsed);
+
+	return true;
+}
+
+bool mk::bag_tool::detail::process_deep_record(deep_chunk_job_t& job, mk::bag::record_t const& record)
+{
+	bool const is_connection = std::visit(mk::make_overload([](mk::bag::header::connection_t const&) -> bool { return true; }, [](...) -> bool { return false; }), record.m_header);
+	if(is_connection)
+	{
+		mk::bag::header::connection_t const& connection = std::get<mk::bag::header::connection_t>(record.m_header);
+		add_deep_topic(job.m_topics, connection.m_conn, std::string{connection.m_topic.m_begin, connection.m_topic.m_begin + connection.m_topic.m_len});
+		return true;
+	}
+
+	bool const is_message_data = std::visit(mk::make_overload([](mk::bag::header::message_data_t const&) -> bool { return true; }, [](...) -> bool { return false; }), record.m_header);
+	CHECK_RET_F(is_message_data);
+	mk::bag::header::message_data_t const& message_data = std::get<mk::bag::header::message_data_t>(record.m_header);
+
+	std::uint32_t const size = static_cast<std::uint32_t>(record.m_data.m_len);
+	std::uint64_t const time = mk::bag::get_time_ns(message_data.m_time);
+	merge_deep_stats(job.m_stats, deep_stats_t{message_data.m_conn, 1, size, size, size, time, time, 0, 0});
+
 	return true;
 }
+
+bool mk::bag_tool::detail::commit_deep_chunk(deep_ctx_t& ctx)
+{
+	void* job_;
+	bool const processed = ctx.m_worker_pool->pop(&job_);
+	deep_chunk_job_t& job = *static_cast<deep_chunk_job_t*>(job_);
+	ctx.m_free_jobs.push_back(&job);
+	CHECK_RET_F(processed);
+
+	for(deep_topic_t const& topic : job.m_topics)
+	{
+		add_deep_topic(ctx.m_topics, topic.m_conn, topic.m_topic);
+	}
+	for(deep_stats_t const& stats : job.m_stats)
+	{
+		merge_deep_stats(ctx.m_stats, stats);
+	}
+
+	return true;
+}
+
+void mk::bag_tool::detail::add_deep_topic(std::vector<deep_topic_t>& topics, std::uint32_t const conn, std::string const& topic)
+{
+	bool const is_known = std::any_of(topics.cbegin(), topics.cend(), [&](deep_topic_t const& deep_topic){ return deep_topic.m_conn == conn; });
+	if(is_known)
+	{
+		return;
+	}
+	topics.push_back(deep_topic_t{conn, topic});
+}
+
+void mk::bag_tool::detail::merge_deep_stats(std::vector<deep_stats_t>& stats, deep_stats_t const& other)
+{
+	// Other comes later in the bag than everything merged so far.
+	auto const it = std::find_if(stats.begin(), stats.end(), [&](deep_stats_t const& deep_stats){ return deep_stats.m_conn == other.m_conn; });
+	if(it == stats.end())
+	{
+		stats.push_back(other);
+		return;
+	}
+	deep_stats_t& merged = *it;
+	if(other.m_first_time >= merged.m_last_time)
+	{
+		merged.m_max_gap = std::max(merged.m_max_gap, other.m_first_time - merged.m_last_time);
+	}
+	else
+	{
+		++merged.m_backward_steps;
+	}
+	merged.m_messages_count += other.m_messages_count;
+	merged.m_bytes += other.m_bytes;
+	merged.m_min_size = std::min(merged.m_min_size, other.m_min_size);
+	merged.m_max_size = std::max(merged.m_max_size, other.m_max_size);
+	merged.m_last_time = other.m_last_time;
+	merged.m_max_gap = std::max(merged.m_max_gap, other.m_max_gap);
+	merged.m_backward_steps += other.m_backward_steps;
+}
+
+void mk::bag_tool::detail::print_deep(deep_ctx_t const& ctx)
+{
+	std::uint64_t messages_count = 0;
+	std::uint64_t bytes = 0;
+	for(deep_stats_t const& stats : ctx.m_stats)
+	{
+		messages_count += stats.m_messages_count;
+		bytes += stats.m_bytes;
+	}
+	std::printf
+	(
+		"chunks = %" PRIu64 ", chunk data = %" PRIu64 ", uncompressed = %" PRIu64 ", messages = %" PRIu64 ", message data = %" PRIu64 "\n",
+		ctx.m_chunks_count,
+		ctx.m_compressed_size,
+		ctx.m_uncompressed_size,
+		messages_count,
+		bytes
+	);
+
+	std::vector<deep_stats_t> sorted = ctx.m_stats;
+	std::sort(sorted.begin(), sorted.end(), [](deep_stats_t const& a, deep_stats_t const& b){ return a.m_conn < b.m_conn; });
+	for(deep_stats_t const& stats : sorted)
+	{
+		auto const it = std::find_if(ctx.m_topics.cbegin(), ctx.m_topics.cend(), [&](deep_topic_t const& topic){ return topic.m_conn == stats.m_conn; });
+		std::string const& topic = it != ctx.m_topics.cend() ? it->m_topic : std::string{};
+		std::printf
+		(
+			"conn = %" PRIu32 ", topic = %s, messages = %" PRIu64 ", bytes = %" PRIu64 ", min size = %" PRIu32 ", max size = %" PRIu32 ", first = ",
+			stats.m_conn,
+			topic.c_str(),
+			stats.m_messages_count,
+			stats.m_bytes,
+			stats.m_min_size,
+			stats.m_max_size
+		);
+		print_summary_time(stats.m_first_time);
+		std::printf(", last = ");
+		print_summary_time(stats.m_last_time);
+		std::printf(", max gap = ");
+		print_summary_time(stats.m_max_gap);
+		std::printf(", backward steps = %" PRIu64 "\n", stats.m_backward_steps);
+	}
+}
@@ -2,7 +2,16 @@
 
 
 #include "bag.h"
+#include "bag_index_file.h"
+#include "bag_to_pcap_impl.h"
 #include "cross_platform.h"
+#include "data_source_pipe.h"
+#include "worker_pool.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
 
 
 namespace mk
@@ -13,6 +22,34 @@ namespace mk
 		{
 
 
+			enum class info_format_e
+			{
+				text,
+				csv,
+				jsonl,
+			};
+
+			// Columns of the CSV output. Each record type writes its fields in this order, so a row is written left to right without going back.
+			enum class info_column_e
+			{
+				index,
+				type,
+				ver,
+				conn,
+				topic,
+				time,
+				compression,
+				size,
+				index_pos,
+				conn_count,
+				chunk_count,
+				chunk_pos,
+				start_time,
+				end_time,
+				count,
+				data_size,
+			};
+
 			struct bag_info_t
 			{
 			public:
@@ -20,13 +57,118 @@ namespace mk
 			public:
 				unsigned m_counter;
 				mk::bag::header::bag_t m_bag_hdr;
+				info_format_e m_format;
+				std::vector<char> m_output; // formatted records waiting for one big write
+				int m_column; // next CSV column of the current row
+				int m_fields_count; // of the current record
+			};
+
+			struct info_options_t
+			{
+				bool m_direct;
+				bool m_summary;
+				info_format_e m_format;
+				bool m_deep;
+				int m_threads_count; // 0 means one per core
+				int m_sample_percent; // of chunks to read, 0 means all of them
+			};
+
+			struct deep_stats_t
+			{
+				std::uint32_t m_conn;
+				std::uint64_t m_messages_count;
+				std::uint64_t m_bytes; // of message data
+				std::uint32_t m_min_size;
+				std::uint32_t m_max_size;
+				std::uint64_t m_first_time; // nanoseconds
+				std::uint64_t m_last_time;
+				std::uint64_t m_max_gap; // between consecutive messages of the connection
+				std::uint64_t m_backward_steps; // messages received before the message preceding them
+			};
+
+			struct deep_topic_t
+			{
+				std::uint32_t m_conn;
+				std::string m_topic;
+			};
+
+			struct deep_chunk_job_t
+			{
+				std::vector<char> m_compression;
+				std::uint32_t m_size;
+				std::vector<unsigned char> m_chunk_data;
+				chunk_decompressor_t m_decompressor;
+				std::vector<deep_stats_t> m_stats; // of connections with messages in the chunk
+				std::vector<deep_topic_t> m_topics; // of connection records inside of the chunk
+			};
+
+			struct deep_ctx_t
+			{
+				mk::worker_pool_t* m_worker_pool;
+				std::vector<deep_chunk_job_t*> m_free_jobs;
+				std::vector<deep_stats_t> m_stats; // whole bag, per connection
+				std::vector<deep_topic_t> m_topics;
+				std::uint64_t m_chunks_count;
+				std::uint64_t m_compressed_size;
+				std::uint64_t m_uncompressed_size;
+			};
+
+			struct summary_topic_t
+			{
+				std::string m_name;
+				std::string m_type;
+				mk::bag::md5sum_t m_md5sum;
+				std::uint32_t m_connections_count;
+				std::uint64_t m_messages_count;
+				std::uint64_t m_start_time; // nanoseconds
+				std::uint64_t m_end_time;
+			};
+
+			struct summary_connection_t
+			{
+				std::uint32_t m_conn;
+				std::uint32_t m_topic_idx;
+			};
+
+			struct summary_compression_t
+			{
+				std::string m_name;
+				std::uint32_t m_chunks_count;
+				std::uint64_t m_compressed_size; // chunk data as stored in the bag
+				std::uint64_t m_uncompressed_size;
+			};
+
+			struct bag_summary_t
+			{
+				bool m_bag_hdr_seen;
+				mk::bag::header::bag_t m_bag_hdr;
+				std::uint64_t m_bag_size;
+				std::vector<summary_topic_t> m_topics;
+				std::vector<summary_connection_t> m_connections;
+				std::vector<std::uint64_t> m_chunk_positions;
+				std::vector<summary_compression_t> m_compressions;
+				std::uint64_t m_messages_count;
+				std::uint64_t m_start_time; // nanoseconds
+				std::uint64_t m_end_time;
+				bool m_exact_spans; // topic spans come from sidecar index, otherwise they are bounds of chunks holding the topic
+			};
+
+			struct sample_ctx_t
+			{
+				bag_summary_t const& m_summary;
+				std::vector<std::vector<std::uint32_t>> m_sizes; // per topic of m_summary, of messages in the sampled chunks
+				chunk_decompressor_t m_decompressor;
+				std::uint64_t m_chunks_count; // sampled
+				std::uint64_t m_chunks_size; // chunk data read
 			};
 
 
 			bool bag_info(int const argc, native_char_t const* const* const argv);
+			bool parse_info_options(int const argc, native_char_t const* const* const argv, info_options_t* const out_options);
 
-			bool bag_info(native_char_t const* const input_bag);
-			template<typename data_source_t> bool bag_info(data_source_t& data_source);
+			bool bag_info(native_char_t const* const input_bag, info_options_t const& options);
+			template<typename data_source_t> bool dispatch_bag_info(data_source_t& data_source, mk::bag_index_file_t const& index_file, info_options_t const& options);
+			template<typename data_source_t> bool bag_info(data_source_t& data_source, info_format_e const format);
 			bool process_record(bag_info_t& bag_info, mk::bag::record_t const& record);
 			char const* get_record_type_name(mk::bag::record_t const& record);
 			bool process_type(bag_info_t& bag_info, mk::bag::record_t const& record, mk::bag::header::bag_t const& /* tag */);
@@ -35,6 +177,41 @@ namespace mk
 			bool process_type(bag_info_t& bag_info, mk::bag::record_t const& record, mk::bag::header::message_data_t const& /* tag */);
 			bool process_type(bag_info_t& bag_info, mk::bag::record_t const& record, mk::bag::header::index_data_t const& /* tag */);
 			bool process_type(bag_info_t& bag_info, mk::bag::record_t const& record, mk::bag::header::chunk_info_t const& /* tag */);
+			void write_info_csv_header(bag_info_t& bag_info);
+			void begin_info_record(bag_info_t& bag_info, char const* const type_name);
+			bool end_info_record(bag_info_t& bag_info, int const data_size);
+			void begin_info_field(bag_info_t& bag_info, info_column_e const column, char const* const text_name);
+			void write_info_field(bag_info_t& bag_info, info_column_e const column, char const* const text_name, std::uint64_t const value);
+			void write_info_field(bag_info_t& bag_info, info_column_e const column, char const* const text_name, mk::bag::string_t const& value);
+			void write_info_time_field(bag_info_t& bag_info, info_column_e const column, char const* const text_name, std::uint64_t const time);
+			void append_info_output(bag_info_t& bag_info, char const* const data, std::size_t const len);
+			void append_info_output(bag_info_t& bag_info, char const* const str);
+			void append_info_number(bag_info_t& bag_info, std::uint64_t const value);
+			void append_info_string(bag_info_t& bag_info, mk::bag::string_t const& value);
+			bool flush_info_output(bag_info_t& bag_info);
+
+			template<typename data_source_t> bool bag_info_summary(data_source_t& data_source, mk::bag_index_file_t const& index_file);
+			template<typename data_source_t> bool get_summary_index(data_source_t& data_source, bag_summary_t* const out_summary);
+			bool bag_info_summary(mk::data_source_pipe_t& data_source, mk::bag_index_file_t const& index_file);
+			bool process_summary_record(bag_summary_t& summary, mk::bag::record_t const& record);
+			bool process_summary_connection(bag_summary_t& summary, mk::bag::record_t const& record);
+			bool process_summary_chunk_info(bag_summary_t& summary, mk::bag::record_t const& record);
+			void apply_summary_index_file(bag_summary_t& summary, mk::bag_index_file_t const& index_file);
+			void print_summary(bag_summary_t const& summary);
+			void print_summary_time(std::uint64_t const time_ns);
+
+			template<typename data_source_t> bool bag_info_sample(data_source_t& data_source, int const sample_percent);
+			bool process_sample_chunk(sample_ctx_t& ctx, mk::bag::record_t const& record);
+			void print_sample(sample_ctx_t const& ctx);
+
+			template<typename data_source_t> bool bag_info_deep(data_source_t& data_source, int const threads_count);
+			bool process_deep_top_record(deep_ctx_t& ctx, mk::bag::record_t const& record);
+			bool process_deep_chunk(deep_chunk_job_t& job);
+			bool process_deep_record(deep_chunk_job_t& job, mk::bag::record_t const& record);
+			bool commit_deep_chunk(deep_ctx_t& ctx);
+			void add_deep_topic(std::vector<deep_topic_t>& topics, std::uint32_t const conn, std::string const& topic);
+			void merge_deep_stats(std::vector<deep_stats_t>& stats, deep_stats_t const& other);
+			void print_deep(deep_ctx_t const& ctx);
 
 
 		}
@@ -0,0 +1,9 @@
+#include "bag_tool_verify.h"
+
+#include "bag_tool_verify_impl.h"
+
+
+bool mk::bag_tool::bag_verify(int const argc, native_char_t const* const* const argv)
+{
+	return mk::bag_tool::detail::bag_verify(argc, argv);
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+
+#include "cross_platform.h"
+
+
+namespace mk
+{
+	namespace bag_tool
+	{
+
+		bool bag_verify(int const argc, native_char_t const* const* const argv);
+
+	}
+}
@@ -0,0 +1,597 @@
+#include "bag_tool_verify_impl.h"
+
+#include "command_line.h"
+#include "data_source_direct.h"
+#include "data_source_mem.h"
+#include "data_source_pipe.h"
+#include "data_source_rommf.h"
+#include "overload.h"
+#include "read_only_memory_mapped_file.h"
+#include "utils.h"
+
+#include <algorithm> // std::find_if, std::lower_bound, std::min, std::max, std::any_of, std::transform
+#include <cassert>
+#include <cinttypes> // PRIu32, PRIu64
+#include <cstdio>
+#include <iterator> // std::size
+#include <limits>
+#include <thread>
+
+
+bool mk::bag_tool::detail::bag_verify(int const argc, native_char_t const* const* const argv)
+{
+	CHECK_RET_F(argc >= 3);
+	verify_options_t options;
+	bool const options_parsed = parse_verify_options(argc - 3, argv + 3, &options);
+	CHECK_RET_F(options_parsed);
+	return bag_verify(argv[2], options);
+}
+
+bool mk::bag_tool::detail::parse_verify_options(int const argc, native_char_t const* const* const argv, verify_options_t* const out_options)
+{
+	static constexpr native_char_t const s_option_direct_name[] = MK_TEXT("--direct");
+	static constexpr int const s_option_direct_name_len = static_cast<int>(std::size(s_option_direct_name)) - 1;
+	static constexpr native_char_t const s_option_threads_name[] = MK_TEXT("-j");
+	static constexpr int const s_option_threads_name_len = static_cast<int>(std::size(s_option_threads_name)) - 1;
+	static constexpr int const s_max_threads_count = 1024;
+
+	assert(out_options);
+	verify_options_t& options = *out_options;
+
+	options.m_direct = false;
+	options.m_threads_count = 0;
+	for(int i = 0; i != argc; ++i)
+	{
+		if(mk::command_line::is_equal(argv[i], s_option_direct_name, s_option_direct_name_len))
+		{
+			options.m_direct = true;
+		}
+		else if(mk::command_line::is_equal(argv[i], s_option_threads_name, s_option_threads_name_len))
+		{
+			CHECK_RET_F(i + 1 != argc);
+			++i;
+			bool const parsed = mk::command_line::parse_int(argv[i], 1, s_max_threads_count, &options.m_threads_count);
+			CHECK_RET_F(parsed);
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+bool mk::bag_tool::detail::bag_verify(native_char_t const* const input_bag, verify_options_t const& options)
+{
+	unsigned const hardware_threads_count = std::thread::hardware_concurrency();
+	int const threads_count = options.m_threads_count != 0 ? options.m_threads_count : hardware_threads_count == 0 ? 1 : static_cast<int>(hardware_threads_count);
+
+	bool compressed;
+	bool const sniffed = mk::data_source_pipe_t::is_compressed(input_bag, &compressed);
+	CHECK_RET_F(sniffed);
+	if(mk::data_source_pipe_t::is_stdin(input_bag) || compressed)
+	{
+		mk::data_source_pipe_t data_source_pipe = mk::data_source_pipe_t::make(input_bag);
+		CHECK_RET_F(data_source_pipe);
+		bool const verified = bag_verify(data_source_pipe, threads_count);
+		CHECK_RET_F(verified);
+		CHECK_RET_F(!data_source_pipe.get_input_failed());
+		return true;
+	}
+
+	if(options.m_direct)
+	{
+		mk::data_source_direct_t data_source_direct = mk::data_source_direct_t::make(input_bag);
+		CHECK_RET_F(data_source_direct);
+		bool const verified = bag_verify(data_source_direct, threads_count);
+		CHECK_RET_F(verified);
+		return true;
+	}
+
+	mk::read_only_memory_mapped_file_t const rommf{input_bag};
+	if(rommf)
+	{
+		mk::data_source_mem_t data_source_mem = mk::data_source_mem_t::make(rommf.get_data(), static_cast<std::size_t>(rommf.get_size()));
+		CHECK_RET_F(data_source_mem);
+		bool const verified = bag_verify(data_source_mem, threads_count);
+		CHECK_RET_F(verified);
+		return true;
+	}
+	else
+	{
+		mk::data_source_rommf_t data_source_rommf = mk::data_source_rommf_t::make(input_bag);
+		CHECK_RET_F(data_source_rommf);
+		bool const verified = bag_verify(data_source_rommf, threads_count);
+		CHECK_RET_F(verified);
+		return true;
+	}
+}
+
+template<typename data_source_t>
+bool mk::bag_tool::detail::bag_verify(data_source_t& data_source, int const threads_count)
+{
+	static constexpr auto const s_record_callback = [](void* const ctx_, void* const data, bool& keep_iterating) -> bool
+	{
+		verify_ctx_t& ctx = *static_cast<verify_ctx_t*>(ctx_);
+		mk::bag::record_t const& record = *static_cast<mk::bag::record_t const*>(data);
+
+		bool const processed = process_verify_top_record(ctx, record);
+		CHECK_RET_F(processed);
+
+		keep_iterating = false;
+		return true;
+	};
+	mk::bag::callback_t const callback = s_record_callback;
+
+	static constexpr auto const s_task = []([[maybe_unused]] void* const ctx, [[maybe_unused]] int const thread_idx, void* const job_) -> bool
+	{
+		verify_chunk_job_t& job = *static_cast<verify_chunk_job_t*>(job_);
+
+		bool const processed = process_verify_chunk(job);
+		CHECK_RET_F(processed);
+
+		return true;
+	};
+	mk::worker_pool_t::task_t const task = s_task;
+
+	CHECK_RET_F(mk::bag::is_bag_file(data_source));
+	data_source.consume(mk::bag::bag_file_header_len());
+
+	int const max_jobs_count = threads_count * 2;
+	std::vector<verify_chunk_job_t> jobs(max_jobs_count);
+	verify_ctx_t ctx{};
+	ctx.m_free_jobs.resize(max_jobs_count);
+	std::transform(jobs.begin(), jobs.end(), ctx.m_free_jobs.begin(), [](verify_chunk_job_t& job){ return &job; });
+
+	// Bag is walked forward one record at a time to know where each record starts, so a pipe works too and so does a bag cut short,
+	// everything up to the damage is still checked. Index data records following a chunk travel with it to a worker.
+	mk::worker_pool_t worker_pool{threads_count, task, nullptr};
+	ctx.m_worker_pool = &worker_pool;
+	while(data_source.get_input_position() != data_source.get_input_size())
+	{
+		ctx.m_record_pos = data_source.get_input_position();
+		bool const parsed = mk::bag::parse_records(data_source, callback, &ctx);
+		if(!parsed)
+		{
+			add_verify_problem(ctx.m_problems, "record at %" PRIu64 " cannot be parsed, rest of the bag is not checked", ctx.m_record_pos);
+			break;
+		}
+		print_verify_problems(ctx, ctx.m_problems);
+	}
+	bool const pushed = push_verify_chunk(ctx);
+	bool const committed = commit_verify_chunks(ctx);
+	CHECK_RET_F(pushed);
+	CHECK_RET_F(committed);
+
+	check_verify_bag(ctx);
+	print_verify_problems(ctx, ctx.m_problems);
+	std::printf("chunks = %zu, chunk infos = %" PRIu64 ", messages = %" PRIu64 ", problems = %" PRIu64 "\n", ctx.m_chunks.size(), ctx.m_chunk_infos_count, ctx.m_messages_count, ctx.m_problems_count);
+	CHECK_RET_F(ctx.m_problems_count == 0);
+
+	return true;
+}
+
+bool mk::bag_tool::detail::process_verify_top_record(verify_ctx_t& ctx, mk::bag::record_t const& record)
+{
+	bool const is_index_data = std::visit(mk::make_overload([](mk::bag::header::index_data_t const&) -> bool { return true; }, [](...) -> bool { return false; }), record.m_header);
+	if(is_index_data)
+	{
+		bool const processed = process_verify_index_data(ctx, record);
+		CHECK_RET_F(processed);
+		return true;
+	}
+
+	// Any other record ends the run of index data records following the chunk.
+	bool const pushed = push_verify_chunk(ctx);
+	CHECK_RET_F(pushed);
+
+	bool const is_chunk = std::visit(mk::make_overload([](mk::bag::header::chunk_t const&) -> bool { return true; }, [](...) -> bool { return false; }), record.m_header);
+	if(is_chunk)
+	{
+		mk::bag::header::chunk_t const& chunk = std::get<mk::bag::header::chunk_t>(record.m_header);
+		if(ctx.m_free_jobs.empty())
+		{
+			bool const committed = commit_verify_chunk(ctx);
+			CHECK_RET_F(committed);
+		}
+		verify_chunk_job_t& job = *ctx.m_free_jobs.back();
+		ctx.m_free_jobs.pop_back();
+		job.m_compression.assign(chunk.m_compression.m_begin, chunk.m_compression.m_begin + chunk.m_compression.m_len);
+		job.m_size = chunk.m_size;
+		job.m_chunk_data.assign(record.m_data.m_begin, record.m_data.m_begin + record.m_data.m_len);
+		job.m_index_data.clear();
+		job.m_chunk.m_pos = ctx.m_record_pos;
+		ctx.m_pending = &job;
+		return true;
+	}
+
+	bool const is_bag = std::visit(mk::make_overload([](mk::bag::header::bag_t const&) -> bool { return true; }, [](...) -> bool { return false; }), record.m_header);
+	if(is_bag)
+	{
+		if(ctx.m_bag_seen)
+		{
+			add_verify_problem(ctx.m_problems, "bag header at %" PRIu64 " is not the first one", ctx.m_record_pos);
+			return true;
+		}
+		ctx.m_bag_seen = true;
+		ctx.m_bag = std::get<mk::bag::header::bag_t>(record.m_header);
+		return true;
+	}
+
+	bool const is_connection = std::visit(mk::make_overload([](mk::bag::header::connection_t const&) -> bool { return true; }, [](...) -> bool { return false; }), record.m_header);
+	if(is_connection)
+	{
+		std::uint32_t const conn = std::get<mk::bag::header::connection_t>(record.m_header).m_conn;
+		ctx.m_index_pos = ctx.m_index_pos != 0 ? ctx.m_index_pos : ctx.m_record_pos;
+		if(std::find(ctx.m_connections.cbegin(), ctx.m_connections.cend(), conn) == ctx.m_connections.cend())
+		{
+			ctx.m_connections.push_back(conn);
+		}
+		return true;
+	}
+
+	bool const is_chunk_info = std::visit(mk::make_overload([](mk::bag::header::chunk_info_t const&) -> bool { return true; }, [](...) -> bool { return false; }), record.m_header);
+	if(is_chunk_info)
+	{
+		ctx.m_index_pos = ctx.m_index_pos != 0 ? ctx.m_index_pos : ctx.m_record_pos;
+		bool const processed = process_verify_chunk_info(ctx, record);
+		CHECK_RET_F(processed);
+		return true;
+	}
+
+	add_verify_problem(ctx.m_problems, "record at %" PRIu64 " is message data outside of any chunk, such bags are not checked", ctx.m_record_pos);
+	return true;
+}
+
+bool mk::bag_tool::detail::process_verify_index_data(verify_ctx_t& ctx, mk::bag::record_t const& record)
+{
+	assert(std::visit(mk::make_overload([](mk::bag::header::index_data_t const&) -> bool { return true; }, [](...) -> bool { return false; }), record.m_header));
+	mk::bag::header::index_data_t const& index_data = std::get<mk::bag::header::index_data_t>(record.m_header);
+
+	if(ctx.m_pending == nullptr)
+	{
+		add_verify_problem(ctx.m_problems, "index data at %" PRIu64 " does not follow a chunk", ctx.m_record_pos);
+		return true;
+	}
+	if(index_data.m_ver != 1)
+	{
+		add_verify_problem(ctx.m_problems, "index data at %" PRIu64 " is of unknown version %" PRIu32, ctx.m_record_pos, index_data.m_ver);
+		return true;
+	}
+	verify_index_data_t& verify_index_data = ctx.m_pending->m_index_data.emplace_back();
+	verify_index_data.m_conn = index_data.m_conn;
+	verify_index_data.m_count = index_data.m_count;
+	verify_index_data.m_entries.resize(index_data.m_count);
+	for(std::uint32_t i = 0; i != index_data.m_count; ++i)
+	{
+		bool const parsed = mk::bag::parse_index_data_data(record, i, &verify_index_data.m_entries[i]);
+		if(!parsed)
+		{
+			add_verify_problem(ctx.m_problems, "index data at %" PRIu64 " does not hold %" PRIu32 " entries it counts", ctx.m_record_pos, index_data.m_count);
+			ctx.m_pending->m_index_data.pop_back();
+			return true;
+		}
+	}
+
+	return true;
+}
+
+bool mk::bag_tool::detail::process_verify_chunk_info(verify_ctx_t& ctx, mk::bag::record_t const& record)
+{
+	assert(std::visit(mk::make_overload([](mk::bag::header::chunk_info_t const&) -> bool { return true; }, [](...) -> bool { return false; }), record.m_header));
+	mk::bag::header::chunk_info_t const& chunk_info = std::get<mk::bag::header::chunk_info_t>(record.m_header);
+
+	// Chunk infos describe chunks before them, those have to be back from the workers.
+	bool const committed = commit_verify_chunks(ctx);
+	CHECK_RET_F(committed);
+	++ctx.m_chunk_infos_count;
+
+	auto const it = std::lower_bound(ctx.m_chunks.begin(), ctx.m_chunks.end(), chunk_info.m_chunk_pos, [](verify_chunk_t const& chunk, std::uint64_t const pos){ return chunk.m_pos < pos; });
+	if(it == ctx.m_chunks.end() || it->m_pos != chunk_info.m_chunk_pos)
+	{
+		add_verify_problem(ctx.m_problems, "chunk info at %" PRIu64 " points to %" PRIu64 ", there is no chunk record", ctx.m_record_pos, chunk_info.m_chunk_pos);
+		return true;
+	}
+	verify_chunk_t& chunk = *it;
+	if(chunk.m_info_seen)
+	{
+		add_verify_problem(ctx.m_problems, "chunk at %" PRIu64 ": chunk info at %" PRIu64 " is not the first one", chunk.m_pos, ctx.m_record_pos);
+		return true;
+	}
+	chunk.m_info_seen = true;
+	if(chunk_info.m_ver != 1)
+	{
+		add_verify_problem(ctx.m_problems, "chunk info at %" PRIu64 " is of unknown version %" PRIu32, ctx.m_record_pos, chunk_info.m_ver);
+		return true;
+	}
+	if(!chunk.m_read)
+	{
+		// Already reported when the chunk came back from its worker.
+		return true;
+	}
+
+	std::vector<mk::bag::data::chunk_info_ver_1_t> counts(chunk_info.m_count);
+	for(std::uint32_t i = 0; i != chunk_info.m_count; ++i)
+	{
+		bool const parsed = mk::bag::parse_chunk_info_data(record, i, &counts[i]);
+		if(!parsed)
+		{
+			add_verify_problem(ctx.m_problems, "chunk info at %" PRIu64 " does not hold %" PRIu32 " entries it counts", ctx.m_record_pos, chunk_info.m_count);
+			return true;
+		}
+		std::uint32_t const found_count = get_verify_count(chunk.m_counts, counts[i].m_conn);
+		if(counts[i].m_count != found_count)
+		{
+			add_verify_problem(ctx.m_problems, "chunk at %" PRIu64 ": chunk info counts %" PRIu32 " messages of connection %" PRIu32 ", chunk holds %" PRIu32, chunk.m_pos, counts[i].m_count, counts[i].m_conn, found_count);
+		}
+	}
+	for(mk::bag::data::chunk_info_ver_1_t const& found : chunk.m_counts)
+	{
+		bool const is_listed = std::any_of(counts.cbegin(), counts.cend(), [&](mk::bag::data::chunk_info_ver_1_t const& count){ return count.m_conn == found.m_conn; });
+		if(!is_listed)
+		{
+			add_verify_problem(ctx.m_problems, "chunk at %" PRIu64 ": connection %" PRIu32 " has %" PRIu32 " messages, chunk info does not list it", chunk.m_pos, found.m_conn, found.m_count);
+		}
+	}
+
+	std::uint64_t const start_time = mk::bag::get_time_ns(chunk_info.m_start_time);
+	std::uint64_t const end_time = mk::bag::get_time_ns(chunk_info.m_end_time);
+	if(!chunk.m_counts.empty() && (chunk.m_start_time < start_time || chunk.m_end_time > end_time))
+	{
+		add_verify_problem(ctx.m_problems, "chunk at %" PRIu64 ": messages span %" PRIu64 " .. %" PRIu64 " ns, chunk info says %" PRIu64 " .. %" PRIu64 " ns", chunk.m_pos, chunk.m_start_time, chunk.m_end_time, start_time, end_time);
+	}
+
+	return true;
+}
+
+bool mk::bag_tool::detail::push_verify_chunk(verify_ctx_t& ctx)
+{
+	if(ctx.m_pending == nullptr)
+	{
+		return true;
+	}
+	ctx.m_worker_pool->push(ctx.m_pending);
+	ctx.m_pending = nullptr;
+
+	return true;
+}
+
+bool mk::bag_tool::detail::commit_verify_chunk(verify_ctx_t& ctx)
+{
+	void* job_;
+	bool const processed = ctx.m_worker_pool->pop(&job_);
+	verify_chunk_job_t& job = *static_cast<verify_chunk_job_t*>(job_);
+	ctx.m_free_jobs.push_back(&job);
+	CHECK_RET_F(processed);
+
+	print_verify_problems(ctx, job.m_problems);
+	ctx.m_chunks.push_back(job.m_chunk);
+	ctx.m_messages_count += job.m_messages.size();
+
+	return true;
+}
+
+bool mk::bag_tool::detail::commit_verify_chunks(verify_ctx_t& ctx)
+{
+	// Problems of the chunks come out before those found on this thread meanwhile, these are about records later in the bag.
+	std::vector<std::string> problems;
+	problems.swap(ctx.m_problems);
+	while(ctx.m_worker_pool->get_jobs_count() != 0)
+	{
+		bool const committed = commit_verify_chunk(ctx);
+		CHECK_RET_F(committed);
+	}
+	problems.swap(ctx.m_problems);
+	ctx.m_problems.insert(ctx.m_problems.end(), problems.begin(), problems.end());
+
+	return true;
+}
+
+bool mk::bag_tool::detail::process_verify_chunk(verify_chunk_job_t& job)
+{
+	struct helper_struct_t
+	{
+		verify_chunk_job_t& m_job;
+		std::uint32_t m_offset;
+	};
+
+	static constexpr auto const s_record_callback = [](void* const ctx, void* const data, bool& keep_iterating) -> bool
+	{
+		helper_struct_t& helper = *static_cast<helper_struct_t*>(ctx);
+		mk::bag::record_t const& record = *static_cast<mk::bag::record_t const*>(data);
+
+		bool const processed = process_verify_record(helper.m_job, record, helper.m_offset);
+		CHECK_RET_F(processed);
+
+		keep_iterating = false;
+		return true;
+	};
+	mk::bag::callback_t const callback = s_record_callback;
+
+	job.m_messages.clear();
+	job.m_problems.clear();
+	job.m_chunk.m_read = false;
+	job.m_chunk.m_info_seen = false;
+	job.m_chunk.m_start_time = std::numeric_limits<std::uint64_t>::max();
+	job.m_chunk.m_end_time = 0;
+	job.m_chunk.m_counts.clear();
+
+	mk::bag::record_t record;
+	mk::bag::header::chunk_t chunk;
+	chunk.m_compression.m_begin = job.m_compression.data();
+	chunk.m_compression.m_len = static_cast<int>(job.m_compression.size());
+	chunk.m_size = job.m_size;
+	record.m_header = chunk;
+	record.m_data.m_begin = job.m_chunk_data.data();
+	record.m_data.m_len = static_cast<int>(job.m_chunk_data.size());
+
+	void const* decompressed_data;
+	bool const decompressed = decompress_record_chunk_data(record, job.m_decompressor, &decompressed_data);
+	if(!decompressed)
+	{
+		add_verify_problem(job.m_problems, "chunk at %" PRIu64 ": data does not decompress to %" PRIu32 " bytes", job.m_chunk.m_pos, job.m_size);
+		return true;
+	}
+
+	// Record by record, offset of each one is what index data entries point to.
+	mk::data_source_mem_t data_source = mk::data_source_mem_t::make(decompressed_data, job.m_size);
+	helper_struct_t helper{job, 0};
+	while(data_source.get_input_position() != data_source.get_input_size())
+	{
+		helper.m_offset = static_cast<std::uint32_t>(data_source.get_input_position());
+		bool const parsed = mk::bag::parse_records(data_source, callback, &helper);
+		if(!parsed)
+		{
+			add_verify_problem(job.m_problems, "chunk at %" PRIu64 ": record at offset %" PRIu32 " inside cannot be parsed", job.m_chunk.m_pos, helper.m_offset);
+			return true;
+		}
+	}
+	job.m_chunk.m_read = true;
+
+	for(verify_message_t const& message : job.m_messages)
+	{
+		auto const it = std::find_if(job.m_chunk.m_counts.begin(), job.m_chunk.m_counts.end(), [&](mk::bag::data::chunk_info_ver_1_t const& count){ return count.m_conn == message.m_conn; });
+		if(it == job.m_chunk.m_counts.end())
+		{
+			job.m_chunk.m_counts.push_back(mk::bag::data::chunk_info_ver_1_t{message.m_conn, 1});
+		}
+		else
+		{
+			++it->m_count;
+		}
+		std::uint64_t const time = mk::bag::get_time_ns(message.m_time);
+		job.m_chunk.m_start_time = std::min(job.m_chunk.m_start_time, time);
+		job.m_chunk.m_end_time = std::max(job.m_chunk.m_end_time, time);
+	}
+	check_verify_index_data(job);
+
+	return true;
+}
+
+bool mk::bag_tool::detail::process_verify_record(verify_chunk_job_t& job, mk::bag::record_t const& record, std::uint32_t const offset)
+{
+	bool const is_connection = std::visit(mk::make_overload([](mk::bag::header::connection_t const&) -> bool { return true; }, [](...) -> bool { return false; }), record.m_header);
+	if(is_connection)
+	{
+		return true;
+	}
+
+	bool const is_message_data = std::visit(mk::make_overload([](mk::bag::header::message_data_t const&) -> bool { return true; }, [](...) -> bool { return false; }), record.m_header);
+	if(!is_message_data)
+	{
+		add_verify_problem(job.m_problems, "chunk at %" PRIu64 ": record at offset %" PRIu32 " inside is neither message data nor connection", job.m_chunk.m_pos, offset);
+		return true;
+	}
+	mk::bag::header::message_data_t const& message_data = std::get<mk::bag::header::message_data_t>(record.m_header);
+	job.m_messages.push_back(verify_message_t{offset, message_data.m_conn, message_data.m_time});
+
+	return true;
+}
+
+void mk::bag_tool::detail::check_verify_index_data(verify_chunk_job_t& job)
+{
+	verify_chunk_t const& chunk = job.m_chunk;
+	for(mk::bag::data::chunk_info_ver_1_t const& found : chunk.m_counts)
+	{
+		bool const is_indexed = std::any_of(job.m_index_data.cbegin(), job.m_index_data.cend(), [&](verify_index_data_t const& index_data){ return index_data.m_conn == found.m_conn; });
+		if(!is_indexed)
+		{
+			add_verify_problem(job.m_problems, "chunk at %" PRIu64 ": connection %" PRIu32 " has %" PRIu32 " messages, no index data follows the chunk", chunk.m_pos, found.m_conn, found.m_count);
+		}
+	}
+
+	for(verify_index_data_t const& index_data : job.m_index_data)
+	{
+		std::uint32_t const found_count = get_verify_count(chunk.m_counts, index_data.m_conn);
+		if(index_data.m_count != found_count)
+		{
+			add_verify_problem(job.m_problems, "chunk at %" PRIu64 ": index data counts %" PRIu32 " messages of connection %" PRIu32 ", chunk holds %" PRIu32, chunk.m_pos, index_data.m_count, index_data.m_conn, found_count);
+		}
+
+		// Each entry has to land on the start of a message data record of its connection, with the same time.
+		std::uint32_t bad_count = 0;
+		std::uint32_t first_bad_offset = 0;
+		for(mk::bag::data::index_data_ver_1_t const& entry : index_data.m_entries)
+		{
+			auto const it = std::lower_bound(job.m_messages.cbegin(), job.m_messages.cend(), entry.m_offset, [](verify_message_t const& message, std::uint32_t const offset){ return message.m_offset < offset; });
+			bool const is_good = it != job.m_messages.cend() && it->m_offset == entry.m_offset && it->m_conn == index_data.m_conn && it->m_time == entry.m_time;
+			if(!is_good)
+			{
+				first_bad_offset = bad_count == 0 ? entry.m_offset : first_bad_offset;
+				++bad_count;
+			}
+		}
+		if(bad_count != 0)
+		{
+			add_verify_problem(job.m_problems, "chunk at %" PRIu64 ": %" PRIu32 " of %zu index entries of connection %" PRIu32 " do not point to its message data records, first one to offset %" PRIu32, chunk.m_pos, bad_count, index_data.m_entries.size(), index_data.m_conn, first_bad_offset);
+		}
+	}
+}
+
+void mk::bag_tool::detail::check_verify_bag(verify_ctx_t& ctx)
+{
+	if(!ctx.m_bag_seen)
+	{
+		add_verify_problem(ctx.m_problems, "%s", "bag header record is missing");
+		return;
+	}
+	if(ctx.m_bag.m_chunk_count != ctx.m_chunks.size())
+	{
+		add_verify_problem(ctx.m_problems, "bag header counts %" PRIu32 " chunks, bag holds %zu", ctx.m_bag.m_chunk_count, ctx.m_chunks.size());
+	}
+	// Recorder writes the index section when the bag is closed, a killed recording leaves it out.
+	if(ctx.m_index_pos == 0)
+	{
+		add_verify_problem(ctx.m_problems, "index section is missing, bag was not closed properly");
+		return;
+	}
+	if(ctx.m_bag.m_index_pos != ctx.m_index_pos)
+	{
+		add_verify_problem(ctx.m_problems, "bag header points to index section at %" PRIu64 ", it starts at %" PRIu64, ctx.m_bag.m_index_pos, ctx.m_index_pos);
+	}
+	if(ctx.m_bag.m_conn_count != ctx.m_connections.size())
+	{
+		add_verify_problem(ctx.m_problems, "bag header counts %" PRIu32 " connections, index section holds %zu", ctx.m_bag.m_conn_count, ctx.m_connections.size());
+	}
+	std::uint64_t uninfoed_count = 0;
+	std::uint64_t first_uninfoed_pos = 0;
+	for(verify_chunk_t const& chunk : ctx.m_chunks)
+	{
+		if(!chunk.m_info_seen)
+		{
+			first_uninfoed_pos = uninfoed_count == 0 ? chunk.m_pos : first_uninfoed_pos;
+			++uninfoed_count;
+		}
+	}
+	if(uninfoed_count != 0)
+	{
+		add_verify_problem(ctx.m_problems, "%" PRIu64 " of %zu chunks have no chunk info, first one at %" PRIu64, uninfoed_count, ctx.m_chunks.size(), first_uninfoed_pos);
+	}
+}
+
+std::uint32_t mk::bag_tool::detail::get_verify_count(std::vector<mk::bag::data::chunk_info_ver_1_t> const& counts, std::uint32_t const conn)
+{
+	auto const it = std::find_if(counts.cbegin(), counts.cend(), [&](mk::bag::data::chunk_info_ver_1_t const& count){ return count.m_conn == conn; });
+	return it != counts.cend() ? it->m_count : 0;
+}
+
+template<typename... args_t>
+void mk::bag_tool::detail::add_verify_problem(std::vector<std::string>& problems, char const* const format, args_t const... args)
+{
+	char buffer[512];
+	int const len = std::snprintf(buffer, std::size(buffer), format, args...);
+	assert(len >= 0);
+	problems.emplace_back(buffer, std::min(static_cast<std::size_t>(len), std::size(buffer) - 1));
+}
+
+void mk::bag_tool::detail::print_verify_problems(verify_ctx_t& ctx, std::vector<std::string>& problems)
+{
+	for(std::string const& problem : problems)
+	{
+		std::printf("%s\n", problem.c_str());
+	}
+	ctx.m_problems_count += problems.size();
+	problems.clear();
+}
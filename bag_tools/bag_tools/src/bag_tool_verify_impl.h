@@ -0,0 +1,106 @@
+#pragma once
+
+
+#include "bag.h"
+#include "bag_to_pcap_impl.h"
+#include "cross_platform.h"
+#include "worker_pool.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+namespace mk
+{
+	namespace bag_tool
+	{
+		namespace detail
+		{
+
+
+			struct verify_options_t
+			{
+				bool m_direct;
+				int m_threads_count; // 0 means one per core
+			};
+
+			struct verify_index_data_t
+			{
+				std::uint32_t m_conn;
+				std::uint32_t m_count;
+				std::vector<mk::bag::data::index_data_ver_1_t> m_entries;
+			};
+
+			struct verify_message_t
+			{
+				std::uint32_t m_offset; // of the message data record inside of uncompressed chunk
+				std::uint32_t m_conn;
+				std::uint64_t m_time; // as stored in the bag
+			};
+
+			struct verify_chunk_t
+			{
+				std::uint64_t m_pos; // of the chunk record
+				bool m_read; // chunk decompressed and every record inside of it parsed
+				bool m_info_seen; // chunk info record of the chunk found in the index section
+				std::uint64_t m_start_time; // nanoseconds, of the earliest message inside
+				std::uint64_t m_end_time;
+				std::vector<mk::bag::data::chunk_info_ver_1_t> m_counts; // messages found inside, per connection
+			};
+
+			struct verify_chunk_job_t
+			{
+				std::vector<char> m_compression;
+				std::uint32_t m_size;
+				std::vector<unsigned char> m_chunk_data;
+				std::vector<verify_index_data_t> m_index_data; // records following the chunk
+				chunk_decompressor_t m_decompressor;
+				std::vector<verify_message_t> m_messages; // ordered by offset
+				verify_chunk_t m_chunk;
+				std::vector<std::string> m_problems;
+			};
+
+			struct verify_ctx_t
+			{
+				mk::worker_pool_t* m_worker_pool;
+				std::vector<verify_chunk_job_t*> m_free_jobs;
+				verify_chunk_job_t* m_pending; // chunk still collecting index data records following it
+				std::uint64_t m_record_pos; // of the top level record being processed
+				bool m_bag_seen;
+				mk::bag::header::bag_t m_bag;
+				std::uint64_t m_index_pos; // of the first connection or chunk info record outside of chunks, 0 if there is none
+				std::vector<std::uint32_t> m_connections; // of the index section
+				std::vector<verify_chunk_t> m_chunks; // in order of the file
+				std::uint64_t m_chunk_infos_count;
+				std::uint64_t m_messages_count;
+				std::uint64_t m_problems_count;
+				std::vector<std::string> m_problems; // found on this thread, not printed yet
+			};
+
+
+			bool bag_verify(int const argc, native_char_t const* const* const argv);
+			bool parse_verify_options(int const argc, native_char_t const* const* const argv, verify_options_t* const out_options);
+
+			bool bag_verify(native_char_t const* const input_bag, verify_options_t const& options);
+			template<typename data_source_t>
+			bool bag_verify(data_source_t& data_source, int const threads_count);
+			bool process_verify_top_record(verify_ctx_t& ctx, mk::bag::record_t const& record);
+			bool process_verify_index_data(verify_ctx_t& ctx, mk::bag::record_t const& record);
+			bool process_verify_chunk_info(verify_ctx_t& ctx, mk::bag::record_t const& record);
+			bool push_verify_chunk(verify_ctx_t& ctx);
+			bool commit_verify_chunk(verify_ctx_t& ctx);
+			bool commit_verify_chunks(verify_ctx_t& ctx);
+			bool process_verify_chunk(verify_chunk_job_t& job);
+			bool process_verify_record(verify_chunk_job_t& job, mk::bag::record_t const& record, std::uint32_t const offset);
+			void check_verify_index_data(verify_chunk_job_t& job);
+			void check_verify_bag(verify_ctx_t& ctx);
+			std::uint32_t get_verify_count(std::vector<mk::bag::data::chunk_info_ver_1_t> const& counts, std::uint32_t const conn);
+			template<typename... args_t>
+			void add_verify_problem(std::vector<std::string>& problems, char const* const format, args_t const... args);
+			void print_verify_problems(verify_ctx_t& ctx, std::vector<std::string>& problems);
+
+
+		}
+	}
+}
@@ -0,0 +1,98 @@
+#include "command_line.h"
+
+#include "utils.h"
+
+#include <cassert>
+#include <cstring> // std::memcmp
+
+
+bool mk::command_line::is_equal(native_char_t const* const& arg, native_char_t const* const& name, int const& name_len)
+{
+	assert(arg);
+	assert(name);
+	int const arg_len = static_cast<int>(native_strlen(arg));
+	return arg_len == name_len && std::memcmp(arg, name, name_len * sizeof(native_char_t)) == 0;
+}
+
+bool mk::command_line::parse_u64(native_char_t const* const& arg, std::uint64_t* const& out_value)
+{
+	static constexpr std::uint64_t const s_max = 0xFFFFFFFFFFFFFFFFull;
+
+	assert(arg);
+	assert(out_value);
+	std::uint64_t& value = *out_value;
+
+	CHECK_RET_F(arg[0] != MK_TEXT('\0'));
+	std::uint64_t val = 0;
+	for(native_char_t const* it = arg; *it != MK_TEXT('\0'); ++it)
+	{
+		CHECK_RET_F(*it >= MK_TEXT('0') && *it <= MK_TEXT('9'));
+		std::uint64_t const digit = static_cast<std::uint64_t>(*it - MK_TEXT('0'));
+		CHECK_RET_F(val <= (s_max - digit) / 10);
+		val = val * 10 + digit;
+	}
+	value = val;
+
+	return true;
+}
+
+bool mk::command_line::parse_int(native_char_t const* const& arg, int const& min_value, int const& max_value, int* const& out_value)
+{
+	assert(min_value >= 0);
+	assert(min_value <= max_value);
+	assert(out_value);
+	int& value = *out_value;
+
+	std::uint64_t val;
+	bool const parsed = parse_u64(arg, &val);
+	CHECK_RET_F(parsed);
+	CHECK_RET_F(val >= static_cast<std::uint64_t>(min_value) && val <= static_cast<std::uint64_t>(max_value));
+	value = static_cast<int>(val);
+
+	return true;
+}
+
+bool mk::command_line::parse_time(native_char_t const* const& arg, std::uint64_t* const& out_time_ns)
+{
+	static constexpr std::uint64_t const s_max_sec = 0xFFFFFFFFull;
+	static constexpr int const s_max_fraction_digits = 9;
+
+	assert(arg);
+	assert(out_time_ns);
+	std::uint64_t& time_ns = *out_time_ns;
+
+	// Seconds since epoch as rosbag info prints them, fraction down to nanoseconds, 1690000000.25 for example.
+	CHECK_RET_F(arg[0] != MK_TEXT('\0'));
+	native_char_t const* it = arg;
+	std::uint64_t sec = 0;
+	int sec_digits = 0;
+	for(; *it != MK_TEXT('\0') && *it != MK_TEXT('.'); ++it)
+	{
+		CHECK_RET_F(*it >= MK_TEXT('0') && *it <= MK_TEXT('9'));
+		sec = sec * 10 + static_cast<std::uint64_t>(*it - MK_TEXT('0'));
+		CHECK_RET_F(sec <= s_max_sec);
+		++sec_digits;
+	}
+	std::uint64_t nsec = 0;
+	int fraction_digits = 0;
+	if(*it == MK_TEXT('.'))
+	{
+		for(++it; *it != MK_TEXT('\0'); ++it)
+		{
+			CHECK_RET_F(*it >= MK_TEXT('0') && *it <= MK_TEXT('9'));
+			CHECK_RET_F(fraction_digits != s_max_fraction_digits);
+			nsec = nsec * 10 + static_cast<std::uint64_t>(*it - MK_TEXT('0'));
+			++fraction_digits;
+		}
+		// A lone dot is a typo rather than a time, 123. and . are refused.
+		CHECK_RET_F(fraction_digits != 0);
+	}
+	CHECK_RET_F(sec_digits + fraction_digits != 0);
+	for(; fraction_digits != s_max_fraction_digits; ++fraction_digits)
+	{
+		nsec *= 10;
+	}
+	time_ns = sec * 1'000'000'000ull + nsec;
+
+	return true;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+
+#include "cross_platform.h"
+
+#include <cstdint> // std::uint64_t
+
+
+namespace mk
+{
+	namespace command_line
+	{
+
+
+		bool is_equal(native_char_t const* const& arg, native_char_t const* const& name, int const& name_len);
+		bool parse_u64(native_char_t const* const& arg, std::uint64_t* const& out_value);
+		bool parse_int(native_char_t const* const& arg, int const& min_value, int const& max_value, int* const& out_value);
+		bool parse_time(native_char_t const* const& arg, std::uint64_t* const& out_time_ns);
+
+
+	}
+}
@@ -0,0 +1,280 @@
+// 64 bit off_t and file offsets on 32 bit Linux too, bags are way over 2 GiB. Has to come before any system header.
+#if !defined(_MSC_VER) && !defined(_FILE_OFFSET_BITS)
+	#define _FILE_OFFSET_BITS 64
+#endif
+
+#include "data_source_direct.h"
+
+#include "utils.h"
+
+#include <cassert>
+#include <cstring> // std::memmove
+#include <utility> // std::swap
+
+#ifdef _MSC_VER
+	#include <windows.h>
+#else
+	#include <cerrno> // errno, EINTR, EINVAL
+
+	// open, O_DIRECT, posix_fadvise
+	#include <sys/types.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+
+	#include <unistd.h> // close, pread
+
+	static_assert(sizeof(off_t) == sizeof(std::uint64_t));
+#endif
+
+
+namespace mk
+{
+	namespace detail
+	{
+		static constexpr std::size_t const s_data_source_direct_buffer_size = 64 * 1024 * 1024;
+		static constexpr std::size_t const s_data_source_direct_block_size = 4 * 1024; // covers logical block size of both 512e and 4Kn disks
+		#ifndef _MSC_VER
+		static constexpr int const s_data_source_direct_invalid_fd = -1;
+		#endif
+	}
+}
+
+
+mk::data_source_direct_t::data_source_direct_t() noexcept :
+	#ifdef _MSC_VER
+	m_file(INVALID_HANDLE_VALUE),
+	#else
+	m_fd(detail::s_data_source_direct_invalid_fd),
+	m_direct(),
+	#endif
+	m_size(),
+	m_buffer(),
+	m_view_start(),
+	m_view_size(),
+	m_position(0xFFFFFFFFFFFFFFFFull)
+{
+}
+
+mk::data_source_direct_t mk::data_source_direct_t::make(native_char_t const* const file_path)
+{
+	data_source_direct_t source;
+
+	#ifdef _MSC_VER
+	HANDLE const file = CreateFileW(file_path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_NO_BUFFERING, nullptr);
+	CHECK_RET(file != INVALID_HANDLE_VALUE, source);
+	source.m_file = file;
+
+	static_assert(sizeof(std::uint64_t) >= sizeof(LARGE_INTEGER));
+	LARGE_INTEGER size;
+	BOOL const got_size = GetFileSizeEx(file, &size);
+	CHECK_RET(got_size != 0, source);
+	source.m_size = size.QuadPart;
+	#else
+	int fd = open(file_path, O_RDONLY | O_CLOEXEC | O_DIRECT);
+	bool direct = true;
+	if(fd == detail::s_data_source_direct_invalid_fd && errno == EINVAL)
+	{
+		// File system does not do direct I/O (tmpfs for example), read through page cache and drop it behind us.
+		fd = open(file_path, O_RDONLY | O_CLOEXEC);
+		direct = false;
+	}
+	CHECK_RET(fd != detail::s_data_source_direct_invalid_fd, source);
+	source.m_fd = fd;
+	source.m_direct = direct;
+
+	struct stat stat_buff;
+	int const stated = fstat(fd, &stat_buff);
+	CHECK_RET(stated == 0, source);
+	source.m_size = static_cast<std::uint64_t>(stat_buff.st_size);
+	#endif
+
+	// Allocated by pages, so aligned well enough for direct I/O.
+	mk::raw_buffer_t buffer{false};
+	bool const reserved = buffer.reserve(detail::s_data_source_direct_buffer_size);
+	CHECK_RET(reserved, source);
+	source.m_buffer = std::move(buffer);
+
+	return source;
+}
+
+mk::data_source_direct_t::data_source_direct_t(data_source_direct_t&& other) noexcept :
+	data_source_direct_t()
+{
+	swap(other);
+}
+
+mk::data_source_direct_t& mk::data_source_direct_t::operator=(data_source_direct_t&& other) noexcept
+{
+	swap(other);
+	return *this;
+}
+
+mk::data_source_direct_t::~data_source_direct_t() noexcept
+{
+	#ifdef _MSC_VER
+	if(m_file != INVALID_HANDLE_VALUE)
+	{
+		BOOL const closed = CloseHandle(m_file);
+		CHECK_RET_CRASH(closed != 0);
+	}
+	#else
+	if(m_fd != detail::s_data_source_direct_invalid_fd)
+	{
+		int const closed = close(m_fd);
+		CHECK_RET_CRASH(closed == 0);
+	}
+	#endif
+}
+
+void mk::data_source_direct_t::swap(data_source_direct_t& other) noexcept
+{
+	using std::swap;
+	#ifdef _MSC_VER
+	swap(m_file, other.m_file);
+	#else
+	swap(m_fd, other.m_fd);
+	swap(m_direct, other.m_direct);
+	#endif
+	swap(m_size, other.m_size);
+	swap(m_buffer, other.m_buffer);
+	swap(m_view_start, other.m_view_start);
+	swap(m_view_size, other.m_view_size);
+	swap(m_position, other.m_position);
+}
+
+mk::data_source_direct_t::operator bool() const
+{
+	#ifdef _MSC_VER
+	return m_file != INVALID_HANDLE_VALUE && m_buffer.get_data() != nullptr;
+	#else
+	return m_fd != detail::s_data_source_direct_invalid_fd && m_buffer.get_data() != nullptr;
+	#endif
+}
+
+void mk::data_source_direct_t::reset()
+{
+	*this = data_source_direct_t{};
+}
+
+
+std::uint64_t mk::data_source_direct_t::get_input_size() const
+{
+	return m_size;
+}
+
+std::uint64_t mk::data_source_direct_t::get_input_position() const
+{
+	return m_position;
+}
+
+std::uint64_t mk::data_source_direct_t::get_input_remaining_size() const
+{
+	return get_input_size() - get_input_position();
+}
+
+void const* mk::data_source_direct_t::get_view() const
+{
+	assert(m_position >= m_view_start && m_position <= m_view_start + m_view_size);
+	std::size_t const offset = static_cast<std::size_t>(m_position - m_view_start);
+	return static_cast<void const*>(m_buffer.get_data() + offset);
+}
+
+std::size_t mk::data_source_direct_t::get_view_remaining_size() const
+{
+	assert(m_position >= m_view_start && m_position <= m_view_start + m_view_size);
+	std::size_t const offset = static_cast<std::size_t>(m_position - m_view_start);
+	return m_view_size - offset;
+}
+
+
+void mk::data_source_direct_t::consume(std::size_t const amount)
+{
+	assert(amount <= get_view_remaining_size());
+	m_position += amount;
+}
+
+void mk::data_source_direct_t::move_to(std::uint64_t const position, std::size_t const window_size)
+{
+	assert(position < get_input_size());
+	assert(window_size <= detail::s_data_source_direct_buffer_size - detail::s_data_source_direct_block_size);
+
+	std::uint64_t const view_end = m_view_start + m_view_size;
+	std::uint64_t const position_end = position + window_size;
+	if(position >= m_view_start && position_end <= view_end)
+	{
+		m_position = position;
+		return;
+	}
+
+	// Direct I/O reads whole blocks into aligned memory only, start the view at block boundary.
+	std::uint64_t const new_view_start = position &~ std::uint64_t{detail::s_data_source_direct_block_size - 1};
+	unsigned char* const buffer = m_buffer.get_data();
+	std::size_t kept = 0;
+	if(new_view_start >= m_view_start && new_view_start < view_end)
+	{
+		// Walking forward, the tail of the current view is already here, do not read it again.
+		kept = static_cast<std::size_t>(view_end - new_view_start);
+		assert(kept % detail::s_data_source_direct_block_size == 0);
+		std::memmove(buffer, buffer + (new_view_start - m_view_start), kept);
+	}
+	std::uint64_t const file_remaining = m_size - new_view_start;
+	std::uint64_t const file_remaining_aligned = (file_remaining + (detail::s_data_source_direct_block_size - 1)) &~ std::uint64_t{detail::s_data_source_direct_block_size - 1};
+	std::size_t const new_view_capacity = file_remaining_aligned < detail::s_data_source_direct_buffer_size ? static_cast<std::size_t>(file_remaining_aligned) : detail::s_data_source_direct_buffer_size;
+	std::size_t read;
+	bool const was_read = read_at(new_view_start + kept, buffer + kept, new_view_capacity - kept, &read);
+	CHECK_RET_CRASH(was_read);
+
+	m_view_start = new_view_start;
+	m_view_size = kept + read;
+	m_position = position;
+	CHECK_RET_CRASH(position_end <= m_view_start + m_view_size);
+}
+
+
+bool mk::data_source_direct_t::read_at(std::uint64_t const position, unsigned char* const buffer, std::size_t const size, std::size_t* const out_read)
+{
+	assert(position % detail::s_data_source_direct_block_size == 0);
+	assert(size % detail::s_data_source_direct_block_size == 0);
+	assert(out_read);
+
+	std::size_t read_total = 0;
+	while(read_total != size)
+	{
+		#ifdef _MSC_VER
+		std::uint64_t const offset = position + read_total;
+		OVERLAPPED overlapped{};
+		overlapped.Offset = static_cast<DWORD>((offset >> (0 * 32)) & 0xFFFFFFFFull);
+		overlapped.OffsetHigh = static_cast<DWORD>((offset >> (1 * 32)) & 0xFFFFFFFFull);
+		DWORD read;
+		BOOL const was_read = ReadFile(m_file, buffer + read_total, static_cast<DWORD>(size - read_total), &read, &overlapped);
+		if(was_read == 0 && GetLastError() == ERROR_HANDLE_EOF)
+		{
+			break;
+		}
+		CHECK_RET_F(was_read != 0);
+		#else
+		ssize_t const read = pread(m_fd, buffer + read_total, size - read_total, static_cast<off_t>(position + read_total));
+		if(read == -1 && errno == EINTR)
+		{
+			continue;
+		}
+		CHECK_RET_F(read != -1);
+		#endif
+		if(read == 0)
+		{
+			break;
+		}
+		read_total += static_cast<std::size_t>(read);
+	}
+	#ifndef _MSC_VER
+	if(!m_direct && read_total != 0)
+	{
+		int const advised = posix_fadvise(m_fd, static_cast<off_t>(position), static_cast<off_t>(read_total), POSIX_FADV_DONTNEED);
+		(void)advised;
+	}
+	#endif
+
+	std::size_t& read_ = *out_read;
+	read_ = read_total;
+	return true;
+}
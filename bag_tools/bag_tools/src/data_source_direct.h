@@ -0,0 +1,56 @@
+#pragma once
+
+
+#include "cross_platform.h"
+#include "raw_buffer.h"
+
+#include <cstddef>
+#include <cstdint>
+
+
+namespace mk
+{
+
+
+	class data_source_direct_t
+	{
+	public:
+		data_source_direct_t() noexcept;
+		static data_source_direct_t make(native_char_t const* const file_path);
+		data_source_direct_t(data_source_direct_t const&) = delete;
+		data_source_direct_t(data_source_direct_t&& other) noexcept;
+		data_source_direct_t& operator=(data_source_direct_t const&) = delete;
+		data_source_direct_t& operator=(data_source_direct_t&& other) noexcept;
+		~data_source_direct_t() noexcept;
+		void swap(data_source_direct_t& other) noexcept;
+		explicit operator bool() const;
+		void reset();
+	public:
+		std::uint64_t get_input_size() const;
+		std::uint64_t get_input_position() const;
+		std::uint64_t get_input_remaining_size() const;
+		void const* get_view() const;
+		std::size_t get_view_remaining_size() const;
+	public:
+		void consume(std::size_t const amount);
+		void move_to(std::uint64_t const position, std::size_t const window_size);
+	private:
+		bool read_at(std::uint64_t const position, unsigned char* const buffer, std::size_t const size, std::size_t* const out_read);
+	private:
+		#ifdef _MSC_VER
+		void* m_file;
+		#else
+		int m_fd;
+		bool m_direct;
+		#endif
+		std::uint64_t m_size;
+		mk::raw_buffer_t m_buffer;
+		std::uint64_t m_view_start;
+		std::size_t m_view_size;
+		std::uint64_t m_position;
+	};
+
+	inline void swap(data_source_direct_t& a, data_source_direct_t& b) noexcept { a.swap(b); }
+
+
+}
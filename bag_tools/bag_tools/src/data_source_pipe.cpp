@@ -0,0 +1,463 @@
+// 64 bit off_t and file offsets on 32 bit Linux too, bags are way over 2 GiB. Has to come before any system header.
+#if !defined(_MSC_VER) && !defined(_FILE_OFFSET_BITS)
+	#define _FILE_OFFSET_BITS 64
+#endif
+
+#include "data_source_pipe.h"
+
+#include "scope_exit.h"
+#include "utils.h"
+
+#include <cassert>
+#include <cstring> // std::memcpy
+#include <utility> // std::swap
+
+#ifdef _MSC_VER
+	#include <windows.h>
+#else
+	#include <cerrno> // errno, EINTR
+
+	// open
+	#include <sys/types.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+
+	#include <unistd.h> // close, read, STDIN_FILENO
+
+	static_assert(sizeof(off_t) == sizeof(std::uint64_t));
+#endif
+
+
+namespace mk
+{
+	namespace detail
+	{
+		static constexpr std::size_t const s_data_source_pipe_headroom = 16 * 1024 * 1024; // biggest window parse_record asks for, the unconsumed tail is carried over here
+		static constexpr std::size_t const s_data_source_pipe_read_size = 32 * 1024 * 1024;
+		static constexpr std::size_t const s_data_source_pipe_input_size = 4 * 1024 * 1024;
+		#ifndef _MSC_VER
+		static constexpr int const s_data_source_pipe_invalid_fd = -1;
+		#endif
+	}
+}
+
+
+mk::data_source_pipe_t::data_source_pipe_t() noexcept :
+	#ifdef _MSC_VER
+	m_file(INVALID_HANDLE_VALUE),
+	#else
+	m_fd(detail::s_data_source_pipe_invalid_fd),
+	#endif
+	m_owns_file(),
+	m_size(0xFFFFFFFFFFFFFFFFull),
+	m_read_total(),
+	m_eof(),
+	m_failed(),
+	m_buffers(),
+	m_front(1),
+	m_view_offset(),
+	m_view_start(),
+	m_view_size(),
+	m_position(),
+	m_job(),
+	m_reader()
+{
+}
+
+mk::data_source_pipe_t mk::data_source_pipe_t::make(native_char_t const* const file_path)
+{
+	data_source_pipe_t source;
+
+	#ifdef _MSC_VER
+	if(is_stdin(file_path))
+	{
+		HANDLE const file = GetStdHandle(STD_INPUT_HANDLE);
+		CHECK_RET(file != INVALID_HANDLE_VALUE && file != nullptr, source);
+		source.m_file = file;
+		source.m_owns_file = false;
+	}
+	else
+	{
+		HANDLE const file = CreateFileW(file_path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		CHECK_RET(file != INVALID_HANDLE_VALUE, source);
+		source.m_file = file;
+		source.m_owns_file = true;
+	}
+	#else
+	if(is_stdin(file_path))
+	{
+		source.m_fd = STDIN_FILENO;
+		source.m_owns_file = false;
+	}
+	else
+	{
+		int const fd = open(file_path, O_RDONLY | O_CLOEXEC);
+		CHECK_RET(fd != detail::s_data_source_pipe_invalid_fd, source);
+		source.m_fd = fd;
+		source.m_owns_file = true;
+	}
+	#endif
+
+	for(mk::raw_buffer_t& buffer : source.m_buffers)
+	{
+		buffer = mk::raw_buffer_t{false};
+		bool const reserved = buffer.reserve(detail::s_data_source_pipe_headroom + detail::s_data_source_pipe_read_size);
+		CHECK_RET(reserved, source);
+	}
+
+	// One reader thread fills the back buffer while the parser works on the front one.
+	source.m_job = std::make_unique<read_job_t>();
+	#ifdef _MSC_VER
+	source.m_job->m_file = source.m_file;
+	#else
+	source.m_job->m_fd = source.m_fd;
+	#endif
+	source.m_job->m_input = mk::raw_buffer_t{false};
+	bool const reserved = source.m_job->m_input.reserve(detail::s_data_source_pipe_input_size);
+	CHECK_RET(reserved, source);
+	source.m_reader = std::make_unique<mk::worker_pool_t>(1, &data_source_pipe_t::read, nullptr);
+	source.submit();
+
+	return source;
+}
+
+mk::data_source_pipe_t::data_source_pipe_t(data_source_pipe_t&& other) noexcept :
+	data_source_pipe_t()
+{
+	swap(other);
+}
+
+mk::data_source_pipe_t& mk::data_source_pipe_t::operator=(data_source_pipe_t&& other) noexcept
+{
+	swap(other);
+	return *this;
+}
+
+mk::data_source_pipe_t::~data_source_pipe_t() noexcept
+{
+	// Joins the reader thread, it might be in the middle of reading from the file.
+	m_reader.reset();
+	if(!m_owns_file)
+	{
+		return;
+	}
+	#ifdef _MSC_VER
+	if(m_file != INVALID_HANDLE_VALUE)
+	{
+		BOOL const closed = CloseHandle(m_file);
+		CHECK_RET_CRASH(closed != 0);
+	}
+	#else
+	if(m_fd != detail::s_data_source_pipe_invalid_fd)
+	{
+		int const closed = close(m_fd);
+		CHECK_RET_CRASH(closed == 0);
+	}
+	#endif
+}
+
+void mk::data_source_pipe_t::swap(data_source_pipe_t& other) noexcept
+{
+	using std::swap;
+	#ifdef _MSC_VER
+	swap(m_file, other.m_file);
+	#else
+	swap(m_fd, other.m_fd);
+	#endif
+	swap(m_owns_file, other.m_owns_file);
+	swap(m_size, other.m_size);
+	swap(m_read_total, other.m_read_total);
+	swap(m_eof, other.m_eof);
+	swap(m_failed, other.m_failed);
+	swap(m_buffers, other.m_buffers);
+	swap(m_front, other.m_front);
+	swap(m_view_offset, other.m_view_offset);
+	swap(m_view_start, other.m_view_start);
+	swap(m_view_size, other.m_view_size);
+	swap(m_position, other.m_position);
+	swap(m_job, other.m_job);
+	swap(m_reader, other.m_reader);
+}
+
+mk::data_source_pipe_t::operator bool() const
+{
+	return m_reader != nullptr;
+}
+
+void mk::data_source_pipe_t::reset()
+{
+	*this = data_source_pipe_t{};
+}
+
+
+bool mk::data_source_pipe_t::is_stdin(native_char_t const* const file_path)
+{
+	assert(file_path);
+	return file_path[0] == MK_TEXT('-') && file_path[1] == MK_TEXT('\0');
+}
+
+bool mk::data_source_pipe_t::is_compressed(native_char_t const* const file_path, bool* const out_compressed)
+{
+	assert(file_path);
+	assert(out_compressed);
+	bool& compressed = *out_compressed;
+
+	// Peeking at stdin would eat the bytes, it is always read through the pipe source anyway.
+	if(is_stdin(file_path))
+	{
+		compressed = false;
+		return true;
+	}
+
+	read_job_t job{};
+	#ifdef _MSC_VER
+	HANDLE const file = CreateFileW(file_path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	CHECK_RET_F(file != INVALID_HANDLE_VALUE);
+	auto const fn_close_file = mk::make_scope_exit([&](){ BOOL const closed = CloseHandle(file); CHECK_RET_CRASH(closed != 0); });
+	job.m_file = file;
+	#else
+	int const fd = open(file_path, O_RDONLY | O_CLOEXEC);
+	CHECK_RET_F(fd != detail::s_data_source_pipe_invalid_fd);
+	auto const fn_close_fd = mk::make_scope_exit([&](){ int const closed = close(fd); CHECK_RET_CRASH(closed == 0); });
+	job.m_fd = fd;
+	#endif
+
+	unsigned char magic[mk::stream_decompressor_t::s_magic_len];
+	std::size_t read;
+	bool eof;
+	bool const was_read = read_raw(job, magic, sizeof(magic), &read, &eof);
+	CHECK_RET_F(was_read);
+	compressed = mk::stream_decompressor_t::detect(magic, read) != mk::stream_compression_e::none;
+	return true;
+}
+
+
+std::uint64_t mk::data_source_pipe_t::get_input_size() const
+{
+	return m_size;
+}
+
+std::uint64_t mk::data_source_pipe_t::get_input_position() const
+{
+	return m_position;
+}
+
+std::uint64_t mk::data_source_pipe_t::get_input_remaining_size() const
+{
+	return get_input_size() - get_input_position();
+}
+
+bool mk::data_source_pipe_t::get_input_failed() const
+{
+	return m_failed;
+}
+
+void const* mk::data_source_pipe_t::get_view() const
+{
+	assert(m_position >= m_view_start && m_position <= m_view_start + m_view_size);
+	std::size_t const offset = m_view_offset + static_cast<std::size_t>(m_position - m_view_start);
+	return static_cast<void const*>(m_buffers[m_front].get_data() + offset);
+}
+
+std::size_t mk::data_source_pipe_t::get_view_remaining_size() const
+{
+	assert(m_position >= m_view_start && m_position <= m_view_start + m_view_size);
+	std::size_t const offset = static_cast<std::size_t>(m_position - m_view_start);
+	return m_view_size - offset;
+}
+
+
+void mk::data_source_pipe_t::consume(std::size_t const amount)
+{
+	assert(amount <= get_view_remaining_size());
+	m_position += amount;
+}
+
+void mk::data_source_pipe_t::move_to(std::uint64_t const position, std::size_t const window_size)
+{
+	assert(window_size <= detail::s_data_source_pipe_headroom);
+
+	// Input flows forward only, whatever is behind the view is gone.
+	CHECK_RET_CRASH(position >= m_view_start);
+	while(position + window_size > m_view_start + m_view_size && !m_eof)
+	{
+		refill(position);
+	}
+	CHECK_RET_CRASH(position <= m_view_start + m_view_size);
+	m_position = position;
+}
+
+
+bool mk::data_source_pipe_t::read([[maybe_unused]] void* const ctx, [[maybe_unused]] int const thread_idx, void* const job_)
+{
+	read_job_t& job = *static_cast<read_job_t*>(job_);
+
+	job.m_read = 0;
+	job.m_eof = false;
+
+	if(!job.m_detected)
+	{
+		// The container is recognized by its first bytes, a plain bag gets them back in front of the rest of the input.
+		job.m_detected = true;
+		std::size_t input_read;
+		bool const was_read = read_raw(job, job.m_input.get_data(), detail::s_data_source_pipe_input_size, &input_read, &job.m_input_eof);
+		CHECK_RET_F(was_read);
+		job.m_input_begin = 0;
+		job.m_input_end = input_read;
+		mk::stream_compression_e const compression = mk::stream_decompressor_t::detect(job.m_input.get_data(), input_read);
+		job.m_decompressor = mk::stream_decompressor_t::make(compression);
+		CHECK_RET_F(job.m_decompressor);
+	}
+
+	if(job.m_decompressor.get_compression() != mk::stream_compression_e::none)
+	{
+		bool const decompressed = read_decompressed(job);
+		CHECK_RET_F(decompressed);
+		return true;
+	}
+
+	std::size_t const sniffed = job.m_input_end - job.m_input_begin;
+	if(sniffed != 0)
+	{
+		assert(sniffed <= job.m_capacity);
+		std::memcpy(job.m_data, job.m_input.get_data() + job.m_input_begin, sniffed);
+		job.m_input_begin = job.m_input_end;
+		job.m_read = sniffed;
+		if(job.m_input_eof)
+		{
+			job.m_eof = true;
+			return true;
+		}
+	}
+	std::size_t read;
+	bool const was_read = read_raw(job, job.m_data + job.m_read, job.m_capacity - job.m_read, &read, &job.m_eof);
+	CHECK_RET_F(was_read);
+	job.m_read += read;
+
+	return true;
+}
+
+bool mk::data_source_pipe_t::read_raw(read_job_t& job, unsigned char* const data, std::size_t const capacity, std::size_t* const out_read, bool* const out_eof)
+{
+	assert(data);
+	assert(out_read);
+	assert(out_eof);
+	std::size_t& total = *out_read;
+	bool& eof = *out_eof;
+
+	// Pipes hand out data in small pieces, keep reading until the buffer is full or the writer is done.
+	total = 0;
+	eof = false;
+	while(total != capacity)
+	{
+		#ifdef _MSC_VER
+		DWORD const to_read = static_cast<DWORD>(capacity - total);
+		DWORD read;
+		BOOL const was_read = ReadFile(job.m_file, data + total, to_read, &read, nullptr);
+		if(was_read == 0 && (GetLastError() == ERROR_BROKEN_PIPE || GetLastError() == ERROR_HANDLE_EOF))
+		{
+			read = 0;
+		}
+		else
+		{
+			CHECK_RET_F(was_read != 0);
+		}
+		#else
+		ssize_t const read = ::read(job.m_fd, data + total, capacity - total);
+		if(read == -1 && errno == EINTR)
+		{
+			continue;
+		}
+		CHECK_RET_F(read != -1);
+		#endif
+		if(read == 0)
+		{
+			eof = true;
+			break;
+		}
+		total += static_cast<std::size_t>(read);
+	}
+
+	return true;
+}
+
+bool mk::data_source_pipe_t::read_decompressed(read_job_t& job)
+{
+	// Runs on the reader thread, so decompression of the next buffer overlaps with parsing of the current one.
+	while(job.m_read != job.m_capacity)
+	{
+		if(job.m_input_begin == job.m_input_end)
+		{
+			if(job.m_input_eof)
+			{
+				// Input cut in the middle of a frame just ends early, the record parser then reports the bag as truncated.
+				job.m_eof = true;
+				break;
+			}
+			std::size_t input_read;
+			bool const was_read = read_raw(job, job.m_input.get_data(), detail::s_data_source_pipe_input_size, &input_read, &job.m_input_eof);
+			CHECK_RET_F(was_read);
+			job.m_input_begin = 0;
+			job.m_input_end = input_read;
+			continue;
+		}
+		std::size_t consumed;
+		std::size_t produced;
+		bool frame_end;
+		bool const decompressed = job.m_decompressor.decompress(job.m_input.get_data() + job.m_input_begin, job.m_input_end - job.m_input_begin, &consumed, job.m_data + job.m_read, job.m_capacity - job.m_read, &produced, &frame_end);
+		CHECK_RET_F(decompressed);
+		CHECK_RET_F(consumed != 0 || produced != 0);
+		job.m_input_begin += consumed;
+		job.m_read += produced;
+	}
+
+	return true;
+}
+
+void mk::data_source_pipe_t::submit()
+{
+	// Reads land right after the headroom of the back buffer, so the tail of the front buffer can be put in front of them.
+	int const back = 1 - m_front;
+	m_job->m_data = m_buffers[back].get_data() + detail::s_data_source_pipe_headroom;
+	m_job->m_capacity = detail::s_data_source_pipe_read_size;
+	m_reader->push(m_job.get());
+}
+
+void mk::data_source_pipe_t::refill(std::uint64_t const position)
+{
+	assert(!m_eof);
+
+	void* job_;
+	bool const was_read = m_reader->pop(&job_);
+	assert(job_ == m_job.get());
+
+	std::uint64_t const view_end = m_view_start + m_view_size;
+	std::uint64_t const keep_start = position < view_end ? position : view_end;
+	std::size_t const kept = static_cast<std::size_t>(view_end - keep_start);
+	CHECK_RET_CRASH(kept <= detail::s_data_source_pipe_headroom);
+	int const back = 1 - m_front;
+	unsigned char* const back_data = m_buffers[back].get_data();
+	std::memcpy(back_data + detail::s_data_source_pipe_headroom - kept, m_buffers[m_front].get_data() + m_view_offset + (keep_start - m_view_start), kept);
+
+	m_front = back;
+	m_view_offset = detail::s_data_source_pipe_headroom - kept;
+	m_view_start = keep_start;
+	m_view_size = kept + m_job->m_read;
+	m_read_total += m_job->m_read;
+	if(!was_read)
+	{
+		// Corrupt stream or failed read ends the input like truncation does, the record parser reports it. Callers tell the two apart by get_input_failed.
+		m_eof = true;
+		m_failed = true;
+		m_size = m_read_total;
+	}
+	else if(m_job->m_eof)
+	{
+		m_eof = true;
+		m_size = m_read_total;
+	}
+	else
+	{
+		submit();
+	}
+}
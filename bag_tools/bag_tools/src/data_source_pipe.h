@@ -0,0 +1,94 @@
+#pragma once
+
+
+#include "cross_platform.h"
+#include "raw_buffer.h"
+#include "stream_decompressor.h"
+#include "worker_pool.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+
+namespace mk
+{
+
+
+	class data_source_pipe_t
+	{
+	private:
+		struct read_job_t
+		{
+			#ifdef _MSC_VER
+			void* m_file;
+			#else
+			int m_fd;
+			#endif
+			unsigned char* m_data;
+			std::size_t m_capacity;
+			std::size_t m_read;
+			bool m_eof;
+			bool m_detected;
+			mk::stream_decompressor_t m_decompressor;
+			mk::raw_buffer_t m_input; // compressed bytes waiting for the decompressor
+			std::size_t m_input_begin;
+			std::size_t m_input_end;
+			bool m_input_eof;
+		};
+	public:
+		data_source_pipe_t() noexcept;
+		static data_source_pipe_t make(native_char_t const* const file_path);
+		data_source_pipe_t(data_source_pipe_t const&) = delete;
+		data_source_pipe_t(data_source_pipe_t&& other) noexcept;
+		data_source_pipe_t& operator=(data_source_pipe_t const&) = delete;
+		data_source_pipe_t& operator=(data_source_pipe_t&& other) noexcept;
+		~data_source_pipe_t() noexcept;
+		void swap(data_source_pipe_t& other) noexcept;
+		explicit operator bool() const;
+		void reset();
+	public:
+		static bool is_stdin(native_char_t const* const file_path);
+		static bool is_compressed(native_char_t const* const file_path, bool* const out_compressed);
+	public:
+		std::uint64_t get_input_size() const;
+		std::uint64_t get_input_position() const;
+		std::uint64_t get_input_remaining_size() const;
+		bool get_input_failed() const;
+		void const* get_view() const;
+		std::size_t get_view_remaining_size() const;
+	public:
+		void consume(std::size_t const amount);
+		void move_to(std::uint64_t const position, std::size_t const window_size);
+	private:
+		static bool read(void* const ctx, int const thread_idx, void* const job);
+		static bool read_raw(read_job_t& job, unsigned char* const data, std::size_t const capacity, std::size_t* const out_read, bool* const out_eof);
+		static bool read_decompressed(read_job_t& job);
+		void submit();
+		void refill(std::uint64_t const position);
+	private:
+		#ifdef _MSC_VER
+		void* m_file;
+		#else
+		int m_fd;
+		#endif
+		bool m_owns_file;
+		std::uint64_t m_size; // unknown until the end of input is seen
+		std::uint64_t m_read_total;
+		bool m_eof;
+		bool m_failed; // reading or decompressing failed, input ends where it stopped
+		std::array<mk::raw_buffer_t, 2> m_buffers;
+		int m_front;
+		std::size_t m_view_offset;
+		std::uint64_t m_view_start;
+		std::size_t m_view_size;
+		std::uint64_t m_position;
+		std::unique_ptr<read_job_t> m_job;
+		std::unique_ptr<mk::worker_pool_t> m_reader; // last, so the reader thread is gone before anything it touches
+	};
+
+	inline void swap(data_source_pipe_t& a, data_source_pipe_t& b) noexcept { a.swap(b); }
+
+
+}
@@ -1,3 +1,8 @@
+// 64 bit off_t and file offsets on 32 bit Linux too, bags are way over 2 GiB. Has to come before any system header.
+#if !defined(_MSC_VER) && !defined(_FILE_OFFSET_BITS)
+	#define _FILE_OFFSET_BITS 64
+#endif
+
 #include "data_source_rommf.h"
 
 #include "utils.h"
@@ -5,7 +10,19 @@
 #include <cassert>
 #include <utility> // std::swap
 
-#include <windows.h>
+#ifdef _MSC_VER
+	#include <windows.h>
+#else
+	// open
+	#include <sys/types.h>
+	#include <sys/stat.h>
+	#include <fcntl.h> // open, posix_fadvise
+
+	#include <unistd.h> // close
+	#include <sys/mman.h> // mmap, munmap, madvise
+
+	static_assert(sizeof(off_t) == sizeof(std::uint64_t));
+#endif
 
 
 namespace mk
@@ -14,14 +31,22 @@ namespace mk
 	{
 		static constexpr int const s_view_size = 64 * 1024 * 1024;
 		static constexpr int const s_view_granularity = 2 * 1024 * 1024;
+		#ifndef _MSC_VER
+		static constexpr int const s_data_source_rommf_invalid_fd = -1;
+		#endif
 	}
 }
 
 
 mk::data_source_rommf_t::data_source_rommf_t() noexcept :
+	#ifdef _MSC_VER
 	m_file(INVALID_HANDLE_VALUE),
 	m_size(),
 	m_mapping(),
+	#else
+	m_fd(detail::s_data_source_rommf_invalid_fd),
+	m_size(),
+	#endif
 	m_view(),
 	m_view_start(0xFFFFFFFFFFFFFFFFull),
 	m_position(0xFFFFFFFFFFFFFFFFull)
@@ -32,6 +57,7 @@ mk::data_source_rommf_t mk::data_source_rommf_t::make(native_char_t const* const
 {
 	data_source_rommf_t source;
 
+	#ifdef _MSC_VER
 	HANDLE const file = CreateFileW(file_path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
 	CHECK_RET(file != INVALID_HANDLE_VALUE, source);
 	source.m_file = file;
@@ -45,6 +71,20 @@ mk::data_source_rommf_t mk::data_source_rommf_t::make(native_char_t const* const
 	HANDLE const mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
 	CHECK_RET(mapping != nullptr, source);
 	source.m_mapping = mapping;
+	#else
+	int const fd = open(file_path, O_RDONLY | O_CLOEXEC);
+	CHECK_RET(fd != detail::s_data_source_rommf_invalid_fd, source);
+	source.m_fd = fd;
+
+	struct stat stat_buff;
+	int const stated = fstat(fd, &stat_buff);
+	CHECK_RET(stated == 0, source);
+	source.m_size = static_cast<std::uint64_t>(stat_buff.st_size);
+
+	// Views are walked mostly front to back, let the kernel read ahead aggressively.
+	int const advised = posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+	(void)advised;
+	#endif
 
 	return source;
 }
@@ -63,6 +103,7 @@ mk::data_source_rommf_t& mk::data_source_rommf_t::operator=(data_source_rommf_t&
 
 mk::data_source_rommf_t::~data_source_rommf_t() noexcept
 {
+	#ifdef _MSC_VER
 	if(m_view != nullptr)
 	{
 		BOOL const unmapped = UnmapViewOfFile(m_view);
@@ -78,14 +119,33 @@ mk::data_source_rommf_t::~data_source_rommf_t() noexcept
 		BOOL const closed = CloseHandle(m_file);
 		CHECK_RET_CRASH(closed != 0);
 	}
+	#else
+	if(m_view != nullptr)
+	{
+		std::uint64_t const file_remaining = m_size - m_view_start;
+		int const view_size = file_remaining < detail::s_view_size ? static_cast<int>(file_remaining) : detail::s_view_size;
+		int const munmapped = munmap(const_cast<void*>(m_view), view_size);
+		CHECK_RET_CRASH(munmapped == 0);
+	}
+	if(m_fd != detail::s_data_source_rommf_invalid_fd)
+	{
+		int const closed = close(m_fd);
+		CHECK_RET_CRASH(closed == 0);
+	}
+	#endif
 }
 
 void mk::data_source_rommf_t::swap(data_source_rommf_t& other) noexcept
 {
 	using std::swap;
+	#ifdef _MSC_VER
 	swap(m_file, other.m_file);
 	swap(m_size, other.m_size);
 	swap(m_mapping, other.m_mapping);
+	#else
+	swap(m_fd, other.m_fd);
+	swap(m_size, other.m_size);
+	#endif
 	swap(m_view, other.m_view);
 	swap(m_view_start, other.m_view_start);
 	swap(m_position, other.m_position);
@@ -93,7 +153,11 @@ void mk::data_source_rommf_t::swap(data_source_rommf_t& other) noexcept
 
 mk::data_source_rommf_t::operator bool() const
 {
+	#ifdef _MSC_VER
 	return m_mapping != nullptr;
+	#else
+	return m_fd != detail::s_data_source_rommf_invalid_fd;
+	#endif
 }
 
 void mk::data_source_rommf_t::reset()
@@ -123,7 +187,7 @@ void const* mk::data_source_rommf_t::get_view() const
 	int const view_size = file_remaining < detail::s_view_size ? static_cast<int>(file_remaining) : detail::s_view_size;
 	assert(m_position >= m_view_start && m_position < m_view_start + view_size);
 	std::uint64_t const offset_ = m_position - m_view_start;
-	assert(offset_ <= view_size);
+	assert(offset_ <= static_cast<std::uint64_t>(view_size));
 	std::size_t const offset = static_cast<std::size_t>(offset_);
 	return static_cast<void const*>(static_cast<unsigned char const*>(m_view) + offset);
 }
@@ -134,7 +198,7 @@ std::size_t mk::data_source_rommf_t::get_view_remaining_size() const
 	int const view_size = file_remaining < detail::s_view_size ? static_cast<int>(file_remaining) : detail::s_view_size;
 	assert(m_position >= m_view_start && m_position < m_view_start + view_size);
 	std::uint64_t const offset_ = m_position - m_view_start;
-	assert(offset_ <= view_size);
+	assert(offset_ <= static_cast<std::uint64_t>(view_size));
 	std::size_t const offset = static_cast<std::size_t>(offset_);
 	return view_size - offset;
 }
@@ -163,19 +227,40 @@ void mk::data_source_rommf_t::move_to(std::uint64_t const position, std::size_t
 	}
 	else
 	{
+		std::uint64_t const new_view_begin = position &~ std::uint64_t{detail::s_view_granularity - 1};
+		std::uint64_t const new_file_remaining = m_size - new_view_begin;
+		int const new_view_size = new_file_remaining < detail::s_view_size ? static_cast<int>(new_file_remaining) : detail::s_view_size;
+		#ifdef _MSC_VER
 		if(m_view != nullptr)
 		{
 			BOOL const unmapped = UnmapViewOfFile(m_view);
 			CHECK_RET_CRASH(unmapped != 0);
 		}
 
-		std::uint64_t const new_view_begin = position &~ std::uint64_t{detail::s_view_granularity - 1};
 		std::uint32_t const new_view_begin_hi = static_cast<std::uint32_t>((new_view_begin >> (1 * 32)) & 0xFFFFFFFFull);
 		std::uint32_t const new_view_begin_lo = static_cast<std::uint32_t>((new_view_begin >> (0 * 32)) & 0xFFFFFFFFull);
-		std::uint64_t const new_file_remaining = m_size - new_view_begin;
-		int const new_view_size = new_file_remaining < detail::s_view_size ? static_cast<int>(new_file_remaining) : detail::s_view_size;
 		void const* const new_view = MapViewOfFile(m_mapping, FILE_MAP_READ, new_view_begin_hi, new_view_begin_lo, new_view_size);
 		CHECK_RET_CRASH(new_view != nullptr);
+		#else
+		if(m_view != nullptr)
+		{
+			int const munmapped = munmap(const_cast<void*>(m_view), view_size);
+			CHECK_RET_CRASH(munmapped == 0);
+		}
+
+		void* const new_view = mmap(nullptr, new_view_size, PROT_READ, MAP_PRIVATE, m_fd, static_cast<off_t>(new_view_begin));
+		CHECK_RET_CRASH(new_view != MAP_FAILED);
+		int const advised = madvise(new_view, new_view_size, MADV_WILLNEED);
+		(void)advised;
+
+		// Start reading the window after this one, so it is in page cache by the time we map it.
+		std::uint64_t const next_view_begin = new_view_begin + new_view_size - detail::s_view_granularity;
+		if(next_view_begin + detail::s_view_granularity < m_size)
+		{
+			int const prefetched = posix_fadvise(m_fd, static_cast<off_t>(next_view_begin), detail::s_view_size, POSIX_FADV_WILLNEED);
+			(void)prefetched;
+		}
+		#endif
 		m_view = new_view;
 		m_view_start = new_view_begin;
 		m_position = position;
@@ -34,9 +34,15 @@ namespace mk
 		void consume(std::size_t const amount);
 		void move_to(std::uint64_t const position, std::size_t const window_size);
 	private:
+		#ifdef _MSC_VER
 		void* m_file;
+		#else
+		int m_fd;
+		#endif
 		std::uint64_t m_size;
+		#ifdef _MSC_VER
 		void* m_mapping;
+		#endif
 		void const* m_view;
 		std::uint64_t m_view_start;
 		std::uint64_t m_position;
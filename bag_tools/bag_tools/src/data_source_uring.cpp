@@ -0,0 +1,522 @@
+// 64 bit off_t and file offsets on 32 bit Linux too, bags are way over 2 GiB. Has to come before any system header.
+#if !defined(_MSC_VER) && !defined(_FILE_OFFSET_BITS)
+	#define _FILE_OFFSET_BITS 64
+#endif
+
+#include "data_source_uring.h"
+
+#include "utils.h"
+
+#include <algorithm> // std::min, std::max, std::find_if, std::is_sorted
+#include <cassert>
+#include <cerrno> // errno, EINTR
+#include <utility> // std::swap, std::move
+
+// open, fstat
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+#include <unistd.h> // close, syscall
+#include <sys/mman.h> // mmap, munmap
+#include <sys/syscall.h> // __NR_io_uring_setup, __NR_io_uring_enter, __NR_io_uring_register
+#include <sys/uio.h> // iovec
+#include <linux/io_uring.h>
+
+static_assert(sizeof(off_t) == sizeof(std::uint64_t));
+
+
+namespace mk
+{
+	namespace detail
+	{
+		static constexpr int const s_data_source_uring_invalid_fd = -1;
+		static constexpr std::uint32_t const s_data_source_uring_slot_capacity = 32 * 1024 * 1024; // twice the biggest record parse_record asks for
+		static constexpr unsigned const s_data_source_uring_entries = 8;
+		enum class data_source_uring_slot_state_t : int { free, in_flight, ready, failed };
+		int io_uring_setup(unsigned const entries, io_uring_params* const params);
+		int io_uring_enter(int const ring_fd, unsigned const to_submit, unsigned const min_complete, unsigned const flags);
+		int io_uring_register(int const ring_fd, unsigned const opcode, void const* const arg, unsigned const nr_args);
+	}
+}
+
+
+int mk::detail::io_uring_setup(unsigned const entries, io_uring_params* const params)
+{
+	return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int mk::detail::io_uring_enter(int const ring_fd, unsigned const to_submit, unsigned const min_complete, unsigned const flags)
+{
+	return static_cast<int>(syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+int mk::detail::io_uring_register(int const ring_fd, unsigned const opcode, void const* const arg, unsigned const nr_args)
+{
+	return static_cast<int>(syscall(__NR_io_uring_register, ring_fd, opcode, arg, nr_args));
+}
+
+
+mk::data_source_uring_t::data_source_uring_t() noexcept :
+	m_fd(detail::s_data_source_uring_invalid_fd),
+	m_size(),
+	m_ring_fd(detail::s_data_source_uring_invalid_fd),
+	m_sq_ring(),
+	m_sq_ring_size(),
+	m_cq_ring(),
+	m_cq_ring_size(),
+	m_sqes(),
+	m_sqes_size(),
+	m_sq_tail(),
+	m_sq_mask(),
+	m_sq_array(),
+	m_cq_head(),
+	m_cq_tail(),
+	m_cq_mask(),
+	m_cqes(),
+	m_buffers(),
+	m_registered(),
+	m_slots(),
+	m_current(-1),
+	m_previous(-1),
+	m_schedule(),
+	m_schedule_next(),
+	m_position(0xFFFFFFFFFFFFFFFFull)
+{
+}
+
+mk::data_source_uring_t mk::data_source_uring_t::make(char const* const file_path)
+{
+	data_source_uring_t source;
+
+	int const fd = open(file_path, O_RDONLY | O_CLOEXEC);
+	CHECK_RET(fd != detail::s_data_source_uring_invalid_fd, source);
+	source.m_fd = fd;
+
+	struct stat stat_buff;
+	int const stated = fstat(fd, &stat_buff);
+	CHECK_RET(stated == 0, source);
+	source.m_size = static_cast<std::uint64_t>(stat_buff.st_size);
+
+	source.m_buffers = mk::raw_buffer_t{false};
+	bool const reserved = source.m_buffers.reserve(std::size_t{detail::s_data_source_uring_slot_capacity} * s_slots_count);
+	CHECK_RET(reserved, source);
+
+	io_uring_params params{};
+	int const ring_fd = detail::io_uring_setup(detail::s_data_source_uring_entries, &params);
+	CHECK_RET(ring_fd >= 0, source);
+	source.m_ring_fd = ring_fd;
+
+	source.m_sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	source.m_cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+	bool const single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+	if(single_mmap)
+	{
+		source.m_sq_ring_size = std::max(source.m_sq_ring_size, source.m_cq_ring_size);
+	}
+	void* const sq_ring = mmap(nullptr, source.m_sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+	CHECK_RET(sq_ring != MAP_FAILED, source);
+	source.m_sq_ring = sq_ring;
+	if(single_mmap)
+	{
+		source.m_cq_ring_size = 0;
+	}
+	else
+	{
+		void* const cq_ring = mmap(nullptr, source.m_cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+		CHECK_RET(cq_ring != MAP_FAILED, source);
+		source.m_cq_ring = cq_ring;
+	}
+	unsigned char* const sq_base = static_cast<unsigned char*>(source.m_sq_ring);
+	unsigned char* const cq_base = single_mmap ? sq_base : static_cast<unsigned char*>(source.m_cq_ring);
+	source.m_sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+	void* const sqes = mmap(nullptr, source.m_sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+	CHECK_RET(sqes != MAP_FAILED, source);
+	source.m_sqes = sqes;
+	source.m_sq_tail = reinterpret_cast<unsigned*>(sq_base + params.sq_off.tail);
+	source.m_sq_mask = reinterpret_cast<unsigned*>(sq_base + params.sq_off.ring_mask);
+	source.m_sq_array = reinterpret_cast<unsigned*>(sq_base + params.sq_off.array);
+	source.m_cq_head = reinterpret_cast<unsigned*>(cq_base + params.cq_off.head);
+	source.m_cq_tail = reinterpret_cast<unsigned*>(cq_base + params.cq_off.tail);
+	source.m_cq_mask = reinterpret_cast<unsigned*>(cq_base + params.cq_off.ring_mask);
+	source.m_cqes = cq_base + params.cq_off.cqes;
+
+	// Registered buffers save the kernel from pinning pages on every read, but count against RLIMIT_MEMLOCK on older kernels. Plain reads work without them.
+	std::array<iovec, s_slots_count> iovecs;
+	for(int i = 0; i != s_slots_count; ++i)
+	{
+		iovecs[i].iov_base = source.m_buffers.get_data() + std::size_t{detail::s_data_source_uring_slot_capacity} * i;
+		iovecs[i].iov_len = detail::s_data_source_uring_slot_capacity;
+	}
+	int const registered = detail::io_uring_register(ring_fd, IORING_REGISTER_BUFFERS, iovecs.data(), s_slots_count);
+	source.m_registered = registered == 0;
+
+	return source;
+}
+
+mk::data_source_uring_t::data_source_uring_t(data_source_uring_t&& other) noexcept :
+	data_source_uring_t()
+{
+	swap(other);
+}
+
+mk::data_source_uring_t& mk::data_source_uring_t::operator=(data_source_uring_t&& other) noexcept
+{
+	swap(other);
+	return *this;
+}
+
+mk::data_source_uring_t::~data_source_uring_t() noexcept
+{
+	// Reads still in flight target m_buffers, they must land before the buffers go away.
+	if(m_ring_fd != detail::s_data_source_uring_invalid_fd && m_sqes != nullptr)
+	{
+		for(int i = 0; i != s_slots_count; ++i)
+		{
+			while(m_slots[i].m_state == static_cast<int>(detail::data_source_uring_slot_state_t::in_flight))
+			{
+				reap(true);
+			}
+		}
+	}
+	if(m_sqes != nullptr)
+	{
+		int const munmapped = munmap(m_sqes, m_sqes_size);
+		CHECK_RET_CRASH(munmapped == 0);
+	}
+	if(m_cq_ring != nullptr)
+	{
+		int const munmapped = munmap(m_cq_ring, m_cq_ring_size);
+		CHECK_RET_CRASH(munmapped == 0);
+	}
+	if(m_sq_ring != nullptr)
+	{
+		int const munmapped = munmap(m_sq_ring, m_sq_ring_size);
+		CHECK_RET_CRASH(munmapped == 0);
+	}
+	if(m_ring_fd != detail::s_data_source_uring_invalid_fd)
+	{
+		int const closed = close(m_ring_fd);
+		CHECK_RET_CRASH(closed == 0);
+	}
+	if(m_fd != detail::s_data_source_uring_invalid_fd)
+	{
+		int const closed = close(m_fd);
+		CHECK_RET_CRASH(closed == 0);
+	}
+}
+
+void mk::data_source_uring_t::swap(data_source_uring_t& other) noexcept
+{
+	using std::swap;
+	swap(m_fd, other.m_fd);
+	swap(m_size, other.m_size);
+	swap(m_ring_fd, other.m_ring_fd);
+	swap(m_sq_ring, other.m_sq_ring);
+	swap(m_sq_ring_size, other.m_sq_ring_size);
+	swap(m_cq_ring, other.m_cq_ring);
+	swap(m_cq_ring_size, other.m_cq_ring_size);
+	swap(m_sqes, other.m_sqes);
+	swap(m_sqes_size, other.m_sqes_size);
+	swap(m_sq_tail, other.m_sq_tail);
+	swap(m_sq_mask, other.m_sq_mask);
+	swap(m_sq_array, other.m_sq_array);
+	swap(m_cq_head, other.m_cq_head);
+	swap(m_cq_tail, other.m_cq_tail);
+	swap(m_cq_mask, other.m_cq_mask);
+	swap(m_cqes, other.m_cqes);
+	swap(m_buffers, other.m_buffers);
+	swap(m_registered, other.m_registered);
+	swap(m_slots, other.m_slots);
+	swap(m_current, other.m_current);
+	swap(m_previous, other.m_previous);
+	swap(m_schedule, other.m_schedule);
+	swap(m_schedule_next, other.m_schedule_next);
+	swap(m_position, other.m_position);
+}
+
+mk::data_source_uring_t::operator bool() const
+{
+	return m_sqes != nullptr;
+}
+
+void mk::data_source_uring_t::reset()
+{
+	*this = data_source_uring_t{};
+}
+
+
+std::uint64_t mk::data_source_uring_t::get_input_size() const
+{
+	return m_size;
+}
+
+std::uint64_t mk::data_source_uring_t::get_input_position() const
+{
+	return m_position;
+}
+
+std::uint64_t mk::data_source_uring_t::get_input_remaining_size() const
+{
+	return get_input_size() - get_input_position();
+}
+
+void const* mk::data_source_uring_t::get_view() const
+{
+	assert(m_current != -1);
+	slot_t const& slot = m_slots[m_current];
+	assert(m_position >= slot.m_begin && m_position < slot.m_begin + slot.m_len);
+	std::size_t const offset = static_cast<std::size_t>(m_position - slot.m_begin);
+	return m_buffers.get_data() + std::size_t{detail::s_data_source_uring_slot_capacity} * m_current + offset;
+}
+
+std::size_t mk::data_source_uring_t::get_view_remaining_size() const
+{
+	assert(m_current != -1);
+	slot_t const& slot = m_slots[m_current];
+	assert(m_position >= slot.m_begin && m_position < slot.m_begin + slot.m_len);
+	std::size_t const offset = static_cast<std::size_t>(m_position - slot.m_begin);
+	return slot.m_len - offset;
+}
+
+
+void mk::data_source_uring_t::consume(std::size_t const amount)
+{
+	assert(amount <= get_input_size());
+	m_position += amount;
+}
+
+void mk::data_source_uring_t::move_to(std::uint64_t const position, std::size_t const window_size)
+{
+	assert(position < get_input_size());
+	assert(window_size <= detail::s_data_source_uring_slot_capacity / 2);
+
+	if(m_current != -1 && covers(m_current, position, window_size))
+	{
+		m_position = position;
+		release_behind();
+		read_ahead();
+		return;
+	}
+
+	int found = -1;
+	for(int i = 0; i != s_slots_count; ++i)
+	{
+		if(i != m_current && m_slots[i].m_state != static_cast<int>(detail::data_source_uring_slot_state_t::free) && covers(i, position, window_size))
+		{
+			found = i;
+			break;
+		}
+	}
+	if(found == -1)
+	{
+		// Not read ahead, read it now. Into a free slot, or into one behind us, or over the current one. Slots read ahead are kept.
+		found = pick_sync_slot(position);
+		slot_t& slot = m_slots[found];
+		slot.m_begin = position;
+		slot.m_len = static_cast<std::uint32_t>(std::min<std::uint64_t>(detail::s_data_source_uring_slot_capacity, m_size - position));
+		slot.m_done = 0;
+		slot.m_whole = false;
+		submit(found);
+	}
+	wait(found);
+	CHECK_RET_CRASH(m_slots[found].m_state == static_cast<int>(detail::data_source_uring_slot_state_t::ready));
+	if(found != m_current)
+	{
+		m_previous = m_current;
+		m_current = found;
+	}
+	m_position = position;
+	release_behind();
+	read_ahead();
+}
+
+void mk::data_source_uring_t::set_schedule(std::vector<data_source_uring_range_t>&& schedule)
+{
+	assert(std::is_sorted(schedule.begin(), schedule.end(), [](data_source_uring_range_t const& a, data_source_uring_range_t const& b){ return a.m_begin < b.m_begin; }));
+	m_schedule = std::move(schedule);
+	m_schedule_next = 0;
+	read_ahead();
+}
+
+
+bool mk::data_source_uring_t::covers(int const slot_idx, std::uint64_t const position, std::size_t const window_size) const
+{
+	// parse_record asks for a window as big as the biggest record could be, far past a chunk read ahead on its own.
+	// Records inside of whole scheduled ranges end at the end of the slot at the latest, such slot is good for them.
+	slot_t const& slot = m_slots[slot_idx];
+	std::uint64_t const window_end = std::min<std::uint64_t>(position + window_size, m_size);
+	return position >= slot.m_begin && position < slot.m_begin + slot.m_len && (window_end <= slot.m_begin + slot.m_len || slot.m_whole);
+}
+
+void mk::data_source_uring_t::release_behind()
+{
+	// Whatever was scheduled or read ahead for positions already behind us is not going to be asked for.
+	// Neither are ranges the current slot has with room to spare for the biggest window there is.
+	reap(false);
+	slot_t const& current = m_slots[m_current];
+	while(m_schedule_next != m_schedule.size())
+	{
+		data_source_uring_range_t const& range = m_schedule[m_schedule_next];
+		bool const behind = range.m_end <= m_position;
+		bool const inside = range.m_begin >= current.m_begin && range.m_end + detail::s_data_source_uring_slot_capacity / 2 <= current.m_begin + current.m_len;
+		if(!(behind || inside))
+		{
+			break;
+		}
+		++m_schedule_next;
+	}
+	for(int i = 0; i != s_slots_count; ++i)
+	{
+		bool const is_done = m_slots[i].m_state == static_cast<int>(detail::data_source_uring_slot_state_t::ready) || m_slots[i].m_state == static_cast<int>(detail::data_source_uring_slot_state_t::failed);
+		if(i != m_current && i != m_previous && is_done && m_slots[i].m_begin + m_slots[i].m_len <= m_position)
+		{
+			m_slots[i].m_state = static_cast<int>(detail::data_source_uring_slot_state_t::free);
+		}
+	}
+}
+
+int mk::data_source_uring_t::pick_sync_slot(std::uint64_t const position) const
+{
+	int behind = -1;
+	for(int i = 0; i != s_slots_count; ++i)
+	{
+		if(i == m_current || m_slots[i].m_state == static_cast<int>(detail::data_source_uring_slot_state_t::in_flight))
+		{
+			continue;
+		}
+		if(m_slots[i].m_state == static_cast<int>(detail::data_source_uring_slot_state_t::free))
+		{
+			return i;
+		}
+		if(m_slots[i].m_begin < position && (behind == -1 || m_slots[i].m_begin < m_slots[behind].m_begin))
+		{
+			behind = i;
+		}
+	}
+	if(behind != -1)
+	{
+		return behind;
+	}
+	if(m_current != -1)
+	{
+		return m_current;
+	}
+	auto const it = std::find_if(m_slots.begin(), m_slots.end(), [](slot_t const& slot){ return slot.m_state != static_cast<int>(detail::data_source_uring_slot_state_t::in_flight); });
+	CHECK_RET_CRASH(it != m_slots.end());
+	return static_cast<int>(it - m_slots.begin());
+}
+
+void mk::data_source_uring_t::read_ahead()
+{
+	while(m_schedule_next != m_schedule.size())
+	{
+		int slot_idx = -1;
+		for(int i = 0; i != s_slots_count; ++i)
+		{
+			if(i != m_current && m_slots[i].m_state == static_cast<int>(detail::data_source_uring_slot_state_t::free))
+			{
+				slot_idx = i;
+				break;
+			}
+		}
+		if(slot_idx == -1)
+		{
+			return;
+		}
+		data_source_uring_range_t const& range = m_schedule[m_schedule_next];
+		++m_schedule_next;
+		assert(range.m_begin < range.m_end);
+		if(!(range.m_begin < m_size))
+		{
+			continue;
+		}
+		// Ranges following each other without a gap are read at once, as many as fit into the slot.
+		std::uint64_t const begin = range.m_begin;
+		std::uint64_t end = std::min(range.m_end, m_size);
+		while(m_schedule_next != m_schedule.size() && m_schedule[m_schedule_next].m_begin == end && std::min(m_schedule[m_schedule_next].m_end, m_size) - begin <= detail::s_data_source_uring_slot_capacity)
+		{
+			end = std::min(m_schedule[m_schedule_next].m_end, m_size);
+			++m_schedule_next;
+		}
+		slot_t& slot = m_slots[slot_idx];
+		slot.m_begin = begin;
+		slot.m_len = static_cast<std::uint32_t>(std::min<std::uint64_t>(end - begin, detail::s_data_source_uring_slot_capacity));
+		slot.m_done = 0;
+		slot.m_whole = slot.m_len == end - begin;
+		submit(slot_idx);
+	}
+}
+
+void mk::data_source_uring_t::submit(int const slot_idx)
+{
+	slot_t& slot = m_slots[slot_idx];
+	assert(slot.m_done < slot.m_len);
+
+	unsigned const tail = *m_sq_tail;
+	unsigned const idx = tail & *m_sq_mask;
+	io_uring_sqe& sqe = static_cast<io_uring_sqe*>(m_sqes)[idx];
+	sqe = io_uring_sqe{};
+	sqe.opcode = m_registered ? IORING_OP_READ_FIXED : IORING_OP_READ;
+	sqe.fd = m_fd;
+	sqe.off = slot.m_begin + slot.m_done;
+	sqe.addr = reinterpret_cast<std::uint64_t>(m_buffers.get_data() + std::size_t{detail::s_data_source_uring_slot_capacity} * slot_idx + slot.m_done);
+	sqe.len = slot.m_len - slot.m_done;
+	sqe.buf_index = static_cast<std::uint16_t>(slot_idx);
+	sqe.user_data = static_cast<std::uint64_t>(slot_idx);
+	m_sq_array[idx] = idx;
+	__atomic_store_n(m_sq_tail, tail + 1, __ATOMIC_RELEASE);
+	slot.m_state = static_cast<int>(detail::data_source_uring_slot_state_t::in_flight);
+
+	for(;;)
+	{
+		int const entered = detail::io_uring_enter(m_ring_fd, 1, 0, 0);
+		if(entered == -1 && errno == EINTR)
+		{
+			continue;
+		}
+		CHECK_RET_CRASH(entered == 1);
+		break;
+	}
+}
+
+void mk::data_source_uring_t::wait(int const slot_idx)
+{
+	while(m_slots[slot_idx].m_state == static_cast<int>(detail::data_source_uring_slot_state_t::in_flight))
+	{
+		reap(true);
+	}
+}
+
+void mk::data_source_uring_t::reap(bool const block)
+{
+	if(block)
+	{
+		int const entered = detail::io_uring_enter(m_ring_fd, 0, 1, IORING_ENTER_GETEVENTS);
+		CHECK_RET_CRASH(entered == 0 || (entered == -1 && errno == EINTR));
+	}
+
+	unsigned head = *m_cq_head;
+	unsigned const tail = __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE);
+	for(; head != tail; ++head)
+	{
+		io_uring_cqe const& cqe = static_cast<io_uring_cqe const*>(m_cqes)[head & *m_cq_mask];
+		int const slot_idx = static_cast<int>(cqe.user_data);
+		assert(slot_idx >= 0 && slot_idx < s_slots_count);
+		slot_t& slot = m_slots[slot_idx];
+		if(cqe.res <= 0)
+		{
+			slot.m_state = static_cast<int>(detail::data_source_uring_slot_state_t::failed);
+			continue;
+		}
+		slot.m_done += static_cast<std::uint32_t>(cqe.res);
+		slot.m_state = static_cast<int>(detail::data_source_uring_slot_state_t::ready);
+		if(slot.m_done != slot.m_len)
+		{
+			// Short read, ask for the rest. Submitting does not touch the completion queue, so this is safe mid loop.
+			__atomic_store_n(m_cq_head, head + 1, __ATOMIC_RELEASE);
+			submit(slot_idx);
+		}
+	}
+	__atomic_store_n(m_cq_head, head, __ATOMIC_RELEASE);
+}
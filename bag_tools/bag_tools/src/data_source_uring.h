@@ -0,0 +1,94 @@
+#pragma once
+
+
+#include "raw_buffer.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+namespace mk
+{
+
+
+	struct data_source_uring_range_t
+	{
+		std::uint64_t m_begin;
+		std::uint64_t m_end;
+	};
+
+
+	class data_source_uring_t
+	{
+	private:
+		static constexpr int const s_slots_count = 4;
+		struct slot_t
+		{
+			std::uint64_t m_begin;
+			std::uint32_t m_len;
+			std::uint32_t m_done;
+			int m_state;
+			bool m_whole; // holds whole scheduled ranges, every record starting inside of it ends inside of it too
+		};
+	public:
+		data_source_uring_t() noexcept;
+		static data_source_uring_t make(char const* const file_path);
+		data_source_uring_t(data_source_uring_t const&) = delete;
+		data_source_uring_t(data_source_uring_t&& other) noexcept;
+		data_source_uring_t& operator=(data_source_uring_t const&) = delete;
+		data_source_uring_t& operator=(data_source_uring_t&& other) noexcept;
+		~data_source_uring_t() noexcept;
+		void swap(data_source_uring_t& other) noexcept;
+		explicit operator bool() const;
+		void reset();
+	public:
+		std::uint64_t get_input_size() const;
+		std::uint64_t get_input_position() const;
+		std::uint64_t get_input_remaining_size() const;
+		void const* get_view() const;
+		std::size_t get_view_remaining_size() const;
+	public:
+		void consume(std::size_t const amount);
+		void move_to(std::uint64_t const position, std::size_t const window_size);
+		void set_schedule(std::vector<data_source_uring_range_t>&& schedule);
+	private:
+		bool covers(int const slot_idx, std::uint64_t const position, std::size_t const window_size) const;
+		void release_behind();
+		int pick_sync_slot(std::uint64_t const position) const;
+		void read_ahead();
+		void submit(int const slot_idx);
+		void wait(int const slot_idx);
+		void reap(bool const block);
+	private:
+		int m_fd;
+		std::uint64_t m_size;
+		int m_ring_fd;
+		void* m_sq_ring;
+		std::size_t m_sq_ring_size;
+		void* m_cq_ring;
+		std::size_t m_cq_ring_size;
+		void* m_sqes;
+		std::size_t m_sqes_size;
+		unsigned* m_sq_tail;
+		unsigned* m_sq_mask;
+		unsigned* m_sq_array;
+		unsigned* m_cq_head;
+		unsigned* m_cq_tail;
+		unsigned* m_cq_mask;
+		void* m_cqes;
+		mk::raw_buffer_t m_buffers;
+		bool m_registered;
+		std::array<slot_t, s_slots_count> m_slots;
+		int m_current;
+		int m_previous; // slot the current one took over from, the record following a chunk is peeked at and then the chunk is read again
+		std::vector<data_source_uring_range_t> m_schedule;
+		std::size_t m_schedule_next;
+		std::uint64_t m_position;
+	};
+
+	inline void swap(data_source_uring_t& a, data_source_uring_t& b) noexcept { a.swap(b); }
+
+
+}
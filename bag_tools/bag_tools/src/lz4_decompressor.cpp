@@ -0,0 +1,85 @@
+#include "lz4_decompressor.h"
+
+#include "utils.h"
+
+#include <cassert>
+#include <utility> // std::swap
+
+#include <lz4frame.h>
+
+
+mk::lz4_decompressor_t::lz4_decompressor_t() noexcept :
+	m_ctx()
+{
+}
+
+mk::lz4_decompressor_t mk::lz4_decompressor_t::make()
+{
+	lz4_decompressor_t decompressor;
+
+	LZ4F_decompressionContext_t ctx;
+	LZ4F_errorCode_t const context_created = LZ4F_createDecompressionContext(&ctx, LZ4F_VERSION);
+	CHECK_RET(!LZ4F_isError(context_created), decompressor);
+	decompressor.m_ctx = ctx;
+
+	return decompressor;
+}
+
+mk::lz4_decompressor_t::lz4_decompressor_t(lz4_decompressor_t&& other) noexcept :
+	lz4_decompressor_t()
+{
+	swap(other);
+}
+
+mk::lz4_decompressor_t& mk::lz4_decompressor_t::operator=(lz4_decompressor_t&& other) noexcept
+{
+	swap(other);
+	return *this;
+}
+
+mk::lz4_decompressor_t::~lz4_decompressor_t() noexcept
+{
+	if(m_ctx != nullptr)
+	{
+		LZ4F_errorCode_t const context_freed = LZ4F_freeDecompressionContext(static_cast<LZ4F_decompressionContext_t>(m_ctx));
+		CHECK_RET_CRASH(context_freed == 0);
+	}
+}
+
+void mk::lz4_decompressor_t::swap(lz4_decompressor_t& other) noexcept
+{
+	using std::swap;
+	swap(m_ctx, other.m_ctx);
+}
+
+mk::lz4_decompressor_t::operator bool() const
+{
+	return m_ctx != nullptr;
+}
+
+void mk::lz4_decompressor_t::reset()
+{
+	*this = lz4_decompressor_t{};
+}
+
+
+bool mk::lz4_decompressor_t::decompress(void const* const& input, std::size_t const& input_len, void* const& output, std::size_t const& output_len)
+{
+	assert(m_ctx != nullptr);
+	LZ4F_decompressionContext_t const ctx = static_cast<LZ4F_decompressionContext_t>(m_ctx);
+
+	// The whole output buffer stays valid for the whole call, so lz4 may use it as history instead of its own buffer.
+	LZ4F_decompressOptions_t options{};
+	options.stableDst = 1;
+
+	std::size_t output_len_ = output_len;
+	std::size_t input_len_ = input_len;
+	std::size_t const decompressed = LZ4F_decompress(ctx, output, &output_len_, input, &input_len_, &options);
+	if(!(decompressed == 0 && output_len_ == output_len && input_len_ == input_len))
+	{
+		LZ4F_resetDecompressionContext(ctx);
+		CHECK_RET_F(false);
+	}
+
+	return true;
+}
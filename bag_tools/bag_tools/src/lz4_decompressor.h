@@ -0,0 +1,33 @@
+#pragma once
+
+
+#include <cstddef> // std::size_t
+
+
+namespace mk
+{
+
+
+	class lz4_decompressor_t
+	{
+	public:
+		lz4_decompressor_t() noexcept;
+		static lz4_decompressor_t make();
+		lz4_decompressor_t(lz4_decompressor_t const&) = delete;
+		lz4_decompressor_t(lz4_decompressor_t&& other) noexcept;
+		lz4_decompressor_t& operator=(lz4_decompressor_t const&) = delete;
+		lz4_decompressor_t& operator=(lz4_decompressor_t&& other) noexcept;
+		~lz4_decompressor_t() noexcept;
+		void swap(lz4_decompressor_t& other) noexcept;
+		explicit operator bool() const;
+		void reset();
+	public:
+		bool decompress(void const* const& input, std::size_t const& input_len, void* const& output, std::size_t const& output_len);
+	private:
+		void* m_ctx;
+	};
+
+	inline void swap(lz4_decompressor_t& a, lz4_decompressor_t& b) noexcept { a.swap(b); }
+
+
+}
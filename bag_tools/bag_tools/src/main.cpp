@@ -1,10 +1,12 @@
 #include "bag_to_pcap.h"
+#include "bag_tool_extract.h"
 #include "bag_tool_info.h"
+#include "bag_tool_verify.h"
 #include "cross_platform.h"
 #include "scope_exit.h"
 #include "utils.h"
 
-#include <cstdio> // std::puts
+#include <cstdio> // std::puts, std::fputs
 #include <cstdlib> // EXIT_FAILURE, EXIT_SUCCESS
 #include <cstring> // std::memcmp
 #include <iterator> // std::size
@@ -14,6 +16,10 @@ static constexpr native_char_t const s_tool_info_name[] = MK_TEXT("/info");
 static constexpr int const s_tool_info_name_len = static_cast<int>(std::size(s_tool_info_name)) - 1;
 static constexpr native_char_t const s_tool_pcap_name[] = MK_TEXT("/pcap");
 static constexpr int const s_tool_pcap_name_len = static_cast<int>(std::size(s_tool_pcap_name)) - 1;
+static constexpr native_char_t const s_tool_extract_name[] = MK_TEXT("/extract");
+static constexpr int const s_tool_extract_name_len = static_cast<int>(std::size(s_tool_extract_name)) - 1;
+static constexpr native_char_t const s_tool_verify_name[] = MK_TEXT("/verify");
+static constexpr int const s_tool_verify_name_len = static_cast<int>(std::size(s_tool_verify_name)) - 1;
 
 
 bool do_bussiness(int const argc, native_char_t const* const* const argv);
@@ -21,13 +27,14 @@ bool do_bussiness(int const argc, native_char_t const* const* const argv);
 
 int main_function(int const argc, native_char_t const* const* const argv)
 {
-	auto something_wrong = mk::make_scope_exit([](){ std::puts("Oh no! Something went wrong!"); });
+	// Verdict goes to stderr, stdout of /info --format csv|jsonl is meant for other programs.
+	auto something_wrong = mk::make_scope_exit([](){ std::fputs("Oh no! Something went wrong!\n", stderr); });
 
 	bool const bussiness = do_bussiness(argc, argv);
 	CHECK_RET(bussiness, EXIT_FAILURE);
 
 	something_wrong.reset();
-	std::puts("We didn't crash. Great success!");
+	std::fputs("We didn't crash. Great success!\n", stderr);
 	return EXIT_SUCCESS;
 }
 
@@ -46,10 +53,69 @@ bool do_bussiness(int const argc, native_char_t const* const* const argv)
 			"Commands:\n"
 			"\t/info\t Prints info about bag file.\n"
 			"\t/pcap\t Converts Ouster LiDAR capture file from bag to pcap format.\n"
+			"\t/extract\t Writes raw messages of chosen topics to length prefixed binary files.\n"
+			"\t/verify\t Checks that index records of bag file agree with what its chunks hold.\n"
+			"\n"
+			"Options of /info:\n"
+			"\t--direct\t Reads input bypassing page cache (O_DIRECT).\n"
+			"\t--summary\t Prints per topic message counts, types, md5sums and time spans, chunk count and compression mix instead of every record.\n"
+			"\t\t Reads only the bag header, the index section and header of each chunk, nothing is decompressed. Topic spans are exact once input.bag.bagidx exists, bounds of chunks holding the topic otherwise.\n"
+			"\t--format F\t Prints records as text (default), csv (with a header row, one column per field) or jsonl (one JSON object per line). Times are in nanoseconds in csv and jsonl.\n"
+			"\t--deep\t Decompresses every chunk and prints per connection message count, bytes, min and max message size, first and last time, largest gap between messages and count of messages stamped earlier than their predecessor.\n"
+			"\t-j N\t Decompresses chunks for --deep on N threads. Defaults to all cores.\n"
+			"\t--sample P\t Reads and decompresses only P percent of chunks, picked at random, the same ones on every run. Prints exact per topic message counts and rates from the index section,\n"
+			"\t\t message size distribution of the sampled chunks and message data estimated from it with 95 % confidence bounds. Input has to be seekable.\n"
+			"\n"
+			"Options of /pcap:\n"
+			"\t-j N\t Decompresses and converts chunks on N threads. Defaults to all cores for bz2 bags, 1 otherwise.\n"
+			"\t--pwrite\t Threads write packets directly at precomputed offsets of preallocated output.\n"
+			"\t--huge-pages\t Backs decompression buffers with huge pages where available.\n"
+			"\t--copy-file-range\t Lets the kernel copy payloads of uncompressed chunks from input to output (Linux only, ignored elsewhere).\n"
+			"\t--stream\t Drops already processed pages of input and output from memory, keeps memory use flat on huge bags.\n"
+			"\t--uring\t Reads chunks ahead of time with io_uring, following chunks merged into reads of up to 32 MiB, two or three of them in flight (Linux only).\n"
+			"\t--direct\t Reads input and writes output bypassing page cache (O_DIRECT), for bulk conversion of cold archives. Uses sidecar index when there is one, does not make it.\n"
+			"\t--no-index\t Neither reads nor writes the sidecar index input.bag.bagidx, which otherwise makes repeated conversions of one bag start right away.\n"
+			"\t--start T\t Skips packets received before T, seconds since epoch such as 1690000000.25. Chunks wholly outside of the time window are not even read. Not together with --pwrite.\n"
+			"\t--end T\t Skips packets received after T. Not together with --pwrite.\n"
+			"\t--topic T\t Converts packets of topic T instead of the first Ouster LiDAR. Repeat it to convert several topics at once.\n"
+			"\t--all-lidars\t Converts every Ouster LiDAR of the bag at once.\n"
+			"\n"
+			"Input bag \"-\" is read from stdin as it flows in, without seeking. /pcap then runs on one thread and converts the first Ouster LiDAR found inside of chunks.\n"
+			"Input bag compressed by zstd, lz4 or gzip (.bag.zst, .bag.lz4, .bag.gz) is recognized by its magic bytes and unpacked on a background thread, the same way.\n"
+			"With several topics or --all-lidars each LiDAR is written to its own file named after its topic, output.os_node_lidar_packets.pcap for example. The bag is read and each chunk decompressed only once.\n"
+			"\n"
+			"Options of /extract:\n"
+			"\t--topic T\t Extracts messages of topic T. Repeat it to extract several topics at once, at least one is required.\n"
+			"\t--start T\t Skips messages received before T, seconds since epoch.\n"
+			"\t--end T\t Skips messages received after T.\n"
+			"\t--no-index\t Does not read the sidecar index input.bag.bagidx.\n"
+			"\n"
+			"Output of /extract is a sequence of messages in order of the bag, each one is 8 bytes receive time in nanoseconds since epoch, 4 bytes payload length, both little endian, followed by the serialized message as stored in the bag.\n"
+			"With several topics each one is written to its own file named after its topic, output.gnss_fix.bin for example. Input bag \"-\" and compressed bags are read the same way as by /pcap.\n"
+			"\n"
+			"Options of /verify:\n"
+			"\t--direct\t Reads input bypassing page cache (O_DIRECT).\n"
+			"\t-j N\t Decompresses chunks on N threads. Defaults to all cores.\n"
+			"\n"
+			"/verify decompresses every chunk and checks that message counts of index data and chunk info records match messages inside of the chunk, that message times lie within time span of the chunk info\n"
+			"\t and that every index data entry points to a message data record of its connection. Each problem found is printed on its own line, the command fails if there is any.\n"
+			"\t Bag cut short or missing its index section is checked up to the damage. Input bag \"-\" and compressed bags are read the same way as by /pcap.\n"
 			"\n"
 			"Example usage:\n"
 			"\tbag_tools.exe /info input.bag\n"
+			"\tbag_tools.exe /info input.bag --summary\n"
+			"\tbag_tools.exe /info input.bag --format csv > records.csv\n"
+			"\tbag_tools.exe /info input.bag --deep -j 8\n"
+			"\tbag_tools.exe /info input.bag --sample 5\n"
 			"\tbag_tools.exe /pcap input.bag output.pcap\n"
+			"\tbag_tools.exe /pcap input.bag output.pcap -j 8\n"
+			"\tbag_tools.exe /pcap input.bag output.pcap -j 8 --pwrite\n"
+			"\tbag_tools.exe /pcap input.bag output.pcap --start 1690000000 --end 1690000060.5\n"
+			"\tbag_tools.exe /pcap input.bag output.pcap --all-lidars -j 8\n"
+			"\tbag_tools.exe /pcap input.bag.zst output.pcap\n"
+			"\tbag_tools.exe /extract input.bag output.bin --topic /imu --topic /gnss/fix\n"
+			"\tbag_tools.exe /verify input.bag -j 8\n"
+			"\tzstd -dc input.bag.zst | bag_tools.exe /pcap - output.pcap\n"
 		);
 		return true;
 	}
@@ -66,6 +132,16 @@ bool do_bussiness(int const argc, native_char_t const* const* const argv)
 		bool const command_ret = mk::bag_tool::bag_to_pcap(argc, argv);
 		CHECK_RET_F(command_ret);
 	}
+	else if(command_len == s_tool_extract_name_len && std::memcmp(command, s_tool_extract_name, s_tool_extract_name_len * sizeof(native_char_t)) == 0)
+	{
+		bool const command_ret = mk::bag_tool::bag_extract(argc, argv);
+		CHECK_RET_F(command_ret);
+	}
+	else if(command_len == s_tool_verify_name_len && std::memcmp(command, s_tool_verify_name, s_tool_verify_name_len * sizeof(native_char_t)) == 0)
+	{
+		bool const command_ret = mk::bag_tool::bag_verify(argc, argv);
+		CHECK_RET_F(command_ret);
+	}
 	else
 	{
 		return false;
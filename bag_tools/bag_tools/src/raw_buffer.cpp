@@ -0,0 +1,146 @@
+#include "raw_buffer.h"
+
+#include "utils.h"
+
+#include <cassert>
+#include <utility> // std::swap
+
+#ifdef _MSC_VER
+	#include <windows.h>
+#else
+	#include <sys/mman.h> // mmap, munmap, madvise
+#endif
+
+
+namespace mk
+{
+	namespace detail
+	{
+		static constexpr std::size_t const s_raw_buffer_granularity = 2 * 1024 * 1024;
+		void* raw_buffer_allocate(std::size_t const& size, bool const& huge_pages);
+		void raw_buffer_free(void* const& data, std::size_t const& size);
+	}
+}
+
+
+void* mk::detail::raw_buffer_allocate(std::size_t const& size, bool const& huge_pages)
+{
+	#ifdef _MSC_VER
+	if(huge_pages)
+	{
+		SIZE_T const large_page_size = GetLargePageMinimum();
+		if(large_page_size != 0 && size % large_page_size == 0)
+		{
+			void* const data = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+			if(data != nullptr)
+			{
+				return data;
+			}
+		}
+	}
+	void* const data = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+	return data;
+	#else
+	void* const data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(data == MAP_FAILED)
+	{
+		return nullptr;
+	}
+	if(huge_pages)
+	{
+		int const advised = madvise(data, size, MADV_HUGEPAGE);
+		(void)advised; // Transparent huge pages are only a hint, the buffer works without them.
+	}
+	return data;
+	#endif
+}
+
+void mk::detail::raw_buffer_free(void* const& data, [[maybe_unused]] std::size_t const& size)
+{
+	#ifdef _MSC_VER
+	BOOL const freed = VirtualFree(data, 0, MEM_RELEASE);
+	CHECK_RET_V(freed != 0);
+	#else
+	int const munmapped = munmap(data, size);
+	CHECK_RET_V(munmapped == 0);
+	#endif
+}
+
+
+mk::raw_buffer_t::raw_buffer_t() noexcept :
+	m_data(),
+	m_capacity(),
+	m_huge_pages()
+{
+}
+
+mk::raw_buffer_t::raw_buffer_t(bool const& huge_pages) noexcept :
+	m_data(),
+	m_capacity(),
+	m_huge_pages(huge_pages)
+{
+}
+
+mk::raw_buffer_t::raw_buffer_t(raw_buffer_t&& other) noexcept :
+	raw_buffer_t()
+{
+	swap(other);
+}
+
+mk::raw_buffer_t& mk::raw_buffer_t::operator=(raw_buffer_t&& other) noexcept
+{
+	swap(other);
+	return *this;
+}
+
+mk::raw_buffer_t::~raw_buffer_t() noexcept
+{
+	if(m_data != nullptr)
+	{
+		detail::raw_buffer_free(m_data, m_capacity);
+	}
+}
+
+void mk::raw_buffer_t::swap(raw_buffer_t& other) noexcept
+{
+	using std::swap;
+	swap(m_data, other.m_data);
+	swap(m_capacity, other.m_capacity);
+	swap(m_huge_pages, other.m_huge_pages);
+}
+
+void mk::raw_buffer_t::reset()
+{
+	*this = raw_buffer_t{};
+}
+
+
+bool mk::raw_buffer_t::reserve(std::size_t const& size)
+{
+	if(size <= m_capacity)
+	{
+		return true;
+	}
+
+	std::size_t const capacity = (size + (detail::s_raw_buffer_granularity - 1)) &~ (detail::s_raw_buffer_granularity - 1);
+	void* const data = detail::raw_buffer_allocate(capacity, m_huge_pages);
+	CHECK_RET_F(data != nullptr);
+	if(m_data != nullptr)
+	{
+		detail::raw_buffer_free(m_data, m_capacity);
+	}
+	m_data = data;
+	m_capacity = capacity;
+
+	return true;
+}
+
+unsigned char* mk::raw_buffer_t::get_data() const
+{
+	return static_cast<unsigned char*>(m_data);
+}
+
+std::size_t mk::raw_buffer_t::get_capacity() const
+{
+	return m_capacity;
+}
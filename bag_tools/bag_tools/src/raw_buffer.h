@@ -0,0 +1,36 @@
+#pragma once
+
+
+#include <cstddef> // std::size_t
+
+
+namespace mk
+{
+
+
+	class raw_buffer_t
+	{
+	public:
+		raw_buffer_t() noexcept;
+		explicit raw_buffer_t(bool const& huge_pages) noexcept;
+		raw_buffer_t(raw_buffer_t const&) = delete;
+		raw_buffer_t(raw_buffer_t&& other) noexcept;
+		raw_buffer_t& operator=(raw_buffer_t const&) = delete;
+		raw_buffer_t& operator=(raw_buffer_t&& other) noexcept;
+		~raw_buffer_t() noexcept;
+		void swap(raw_buffer_t& other) noexcept;
+		void reset();
+	public:
+		bool reserve(std::size_t const& size);
+		unsigned char* get_data() const;
+		std::size_t get_capacity() const;
+	private:
+		void* m_data;
+		std::size_t m_capacity;
+		bool m_huge_pages;
+	};
+
+	inline void swap(raw_buffer_t& a, raw_buffer_t& b) noexcept { a.swap(b); }
+
+
+}
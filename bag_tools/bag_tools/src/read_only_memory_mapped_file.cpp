@@ -57,3 +57,18 @@ std::uint64_t mk::read_only_memory_mapped_file_t::get_size() const
 {
 	return m_native_file.get_size();
 }
+
+mk::read_only_memory_mapped_file_native_t const& mk::read_only_memory_mapped_file_t::get_native() const
+{
+	return m_native_file;
+}
+
+bool mk::read_only_memory_mapped_file_t::advise_sequential() const
+{
+	return m_native_file.advise_sequential();
+}
+
+bool mk::read_only_memory_mapped_file_t::drop(std::uint64_t const& offset, std::uint64_t const& size) const
+{
+	return m_native_file.drop(offset, size);
+}
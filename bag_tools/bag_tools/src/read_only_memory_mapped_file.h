@@ -33,6 +33,9 @@ namespace mk
 	public:
 		void const* get_data() const;
 		std::uint64_t get_size() const;
+		bool advise_sequential() const;
+		bool drop(std::uint64_t const& offset, std::uint64_t const& size) const;
+		read_only_memory_mapped_file_native_t const& get_native() const;
 	private:
 		read_only_memory_mapped_file_native_t m_native_file;
 	};
@@ -1,8 +1,14 @@
+// 64 bit off_t and file offsets on 32 bit Linux too, bags are way over 2 GiB. Has to come before any system header.
+#if !defined(_MSC_VER) && !defined(_FILE_OFFSET_BITS)
+	#define _FILE_OFFSET_BITS 64
+#endif
+
 #include "read_only_memory_mapped_file_linux.h"
 
 #include "utils.h"
 
 #include <cassert>
+#include <limits>
 #include <utility> // std::swap
 
 // open
@@ -16,7 +22,11 @@
 #include <unistd.h>
 
 #include <unistd.h> // close
-#include <sys/mman.h> // map, munmap
+#include <sys/mman.h> // map, munmap, madvise
+#include <unistd.h> // sysconf
+#include <fcntl.h> // posix_fadvise
+
+static_assert(sizeof(off_t) == sizeof(std::uint64_t));
 
 
 static constexpr int const s_invalid_fd = -1;
@@ -48,6 +58,11 @@ mk::read_only_memory_mapped_file_linux_t::read_only_memory_mapped_file_linux_t(c
 		return;
 	}
 	m_size = static_cast<std::uint64_t>(stat_buff.st_size);
+	// Whole bag does not fit into address space of 32 bit process, callers fall back to mapping it view by view.
+	if(!(m_size <= std::numeric_limits<std::size_t>::max()))
+	{
+		return;
+	}
 
 	void* const mapping = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
 	if(!(mapping != MAP_FAILED && mapping != s_invalid_mapping))
@@ -110,3 +125,41 @@ std::uint64_t mk::read_only_memory_mapped_file_linux_t::get_size() const
 {
 	return m_size;
 }
+
+int mk::read_only_memory_mapped_file_linux_t::get_fd() const
+{
+	return m_fd;
+}
+
+bool mk::read_only_memory_mapped_file_linux_t::advise_sequential() const
+{
+	assert(m_mapping != s_invalid_mapping);
+
+	int const advised = madvise(m_mapping, m_size, MADV_SEQUENTIAL);
+	CHECK_RET_F(advised == 0);
+	int const fadvised = posix_fadvise(m_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+	CHECK_RET_F(fadvised == 0);
+
+	return true;
+}
+
+bool mk::read_only_memory_mapped_file_linux_t::drop(std::uint64_t const& offset, std::uint64_t const& size) const
+{
+	assert(m_mapping != s_invalid_mapping);
+	assert(offset + size <= m_size);
+
+	// Only whole pages can go, the partial ones at both ends stay until the next call.
+	std::uint64_t const page_size = static_cast<std::uint64_t>(sysconf(_SC_PAGESIZE));
+	std::uint64_t const begin = (offset + (page_size - 1)) &~ (page_size - 1);
+	std::uint64_t const end = (offset + size) &~ (page_size - 1);
+	if(!(begin < end))
+	{
+		return true;
+	}
+	int const advised = madvise(static_cast<unsigned char*>(m_mapping) + begin, end - begin, MADV_DONTNEED);
+	CHECK_RET_F(advised == 0);
+	int const fadvised = posix_fadvise(m_fd, static_cast<off_t>(begin), static_cast<off_t>(end - begin), POSIX_FADV_DONTNEED);
+	CHECK_RET_F(fadvised == 0);
+
+	return true;
+}
@@ -24,6 +24,9 @@ namespace mk
 	public:
 		void const* get_data() const;
 		std::uint64_t get_size() const;
+		bool advise_sequential() const;
+		bool drop(std::uint64_t const& offset, std::uint64_t const& size) const;
+		int get_fd() const;
 	private:
 		int m_fd;
 		void* m_mapping;
@@ -2,6 +2,7 @@
 
 #include "utils.h"
 
+#include <cassert>
 #include <utility> // std::swap
 
 #include <windows.h>
@@ -112,3 +113,25 @@ std::uint64_t mk::read_only_memory_mapped_file_windows_t::get_size() const
 {
 	return m_size;
 }
+
+bool mk::read_only_memory_mapped_file_windows_t::advise_sequential() const
+{
+	// The memory manager reads ahead on its own for sequential faults, nothing to tell it.
+	return true;
+}
+
+bool mk::read_only_memory_mapped_file_windows_t::drop(std::uint64_t const& offset, std::uint64_t const& size) const
+{
+	assert(m_view != s_invalid_view);
+	assert(offset + size <= m_size);
+
+	if(size == 0)
+	{
+		return true;
+	}
+	// Unlocking pages that were never locked removes them from the working set, that is the documented way to trim it.
+	BOOL const unlocked = VirtualUnlock(const_cast<unsigned char*>(static_cast<unsigned char const*>(m_view) + offset), static_cast<SIZE_T>(size));
+	CHECK_RET_F(unlocked != 0 || GetLastError() == ERROR_NOT_LOCKED);
+
+	return true;
+}
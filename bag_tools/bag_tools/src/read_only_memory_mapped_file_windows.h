@@ -24,6 +24,8 @@ namespace mk
 	public:
 		void const* get_data() const;
 		std::uint64_t get_size() const;
+		bool advise_sequential() const;
+		bool drop(std::uint64_t const& offset, std::uint64_t const& size) const;
 	private:
 		void* m_file;
 		void* m_mapping;
@@ -0,0 +1,232 @@
+#include "stream_decompressor.h"
+
+#include "utils.h"
+
+#include <cassert>
+#include <climits> // UINT_MAX
+#include <cstring> // std::memcmp
+#include <new> // std::nothrow
+#include <utility> // std::swap
+
+#include <lz4frame.h>
+#include <zlib.h>
+#include <zstd.h>
+
+
+namespace mk
+{
+	namespace detail
+	{
+		static constexpr unsigned char const s_stream_zstd_magic[] = {0x28, 0xB5, 0x2F, 0xFD};
+		static constexpr unsigned char const s_stream_lz4_magic[] = {0x04, 0x22, 0x4D, 0x18};
+		static constexpr unsigned char const s_stream_gzip_magic[] = {0x1F, 0x8B};
+		static constexpr int const s_stream_gzip_window_bits = 15 + 16; // biggest window, gzip wrapper only
+	}
+}
+
+
+mk::stream_decompressor_t::stream_decompressor_t() noexcept :
+	m_compression(stream_compression_e::none),
+	m_ctx()
+{
+}
+
+mk::stream_decompressor_t mk::stream_decompressor_t::make(stream_compression_e const& compression)
+{
+	stream_decompressor_t decompressor;
+	decompressor.m_compression = compression;
+
+	switch(compression)
+	{
+		case stream_compression_e::none:
+		{
+		}
+		break;
+		case stream_compression_e::zstd:
+		{
+			ZSTD_DStream* const ctx = ZSTD_createDStream();
+			CHECK_RET(ctx != nullptr, decompressor);
+			decompressor.m_ctx = ctx;
+		}
+		break;
+		case stream_compression_e::lz4:
+		{
+			LZ4F_decompressionContext_t ctx;
+			LZ4F_errorCode_t const context_created = LZ4F_createDecompressionContext(&ctx, LZ4F_VERSION);
+			CHECK_RET(!LZ4F_isError(context_created), decompressor);
+			decompressor.m_ctx = ctx;
+		}
+		break;
+		case stream_compression_e::gzip:
+		{
+			z_stream* const ctx = new(std::nothrow) z_stream{};
+			CHECK_RET(ctx != nullptr, decompressor);
+			int const inited = inflateInit2(ctx, detail::s_stream_gzip_window_bits);
+			if(inited != Z_OK)
+			{
+				delete ctx;
+				CHECK_RET(false, decompressor);
+			}
+			decompressor.m_ctx = ctx;
+		}
+		break;
+	}
+
+	return decompressor;
+}
+
+mk::stream_decompressor_t::stream_decompressor_t(stream_decompressor_t&& other) noexcept :
+	stream_decompressor_t()
+{
+	swap(other);
+}
+
+mk::stream_decompressor_t& mk::stream_decompressor_t::operator=(stream_decompressor_t&& other) noexcept
+{
+	swap(other);
+	return *this;
+}
+
+mk::stream_decompressor_t::~stream_decompressor_t() noexcept
+{
+	if(m_ctx == nullptr)
+	{
+		return;
+	}
+	switch(m_compression)
+	{
+		case stream_compression_e::none:
+		{
+		}
+		break;
+		case stream_compression_e::zstd:
+		{
+			std::size_t const freed = ZSTD_freeDStream(static_cast<ZSTD_DStream*>(m_ctx));
+			CHECK_RET_CRASH(!ZSTD_isError(freed));
+		}
+		break;
+		case stream_compression_e::lz4:
+		{
+			LZ4F_errorCode_t const context_freed = LZ4F_freeDecompressionContext(static_cast<LZ4F_decompressionContext_t>(m_ctx));
+			CHECK_RET_CRASH(!LZ4F_isError(context_freed));
+		}
+		break;
+		case stream_compression_e::gzip:
+		{
+			z_stream* const ctx = static_cast<z_stream*>(m_ctx);
+			int const ended = inflateEnd(ctx);
+			delete ctx;
+			CHECK_RET_CRASH(ended == Z_OK);
+		}
+		break;
+	}
+}
+
+void mk::stream_decompressor_t::swap(stream_decompressor_t& other) noexcept
+{
+	using std::swap;
+	swap(m_compression, other.m_compression);
+	swap(m_ctx, other.m_ctx);
+}
+
+mk::stream_decompressor_t::operator bool() const
+{
+	return m_compression == stream_compression_e::none || m_ctx != nullptr;
+}
+
+void mk::stream_decompressor_t::reset()
+{
+	*this = stream_decompressor_t{};
+}
+
+
+mk::stream_compression_e mk::stream_decompressor_t::detect(void const* const& data, std::size_t const& size)
+{
+	assert(data || size == 0);
+
+	if(size >= sizeof(detail::s_stream_zstd_magic) && std::memcmp(data, detail::s_stream_zstd_magic, sizeof(detail::s_stream_zstd_magic)) == 0)
+	{
+		return stream_compression_e::zstd;
+	}
+	if(size >= sizeof(detail::s_stream_lz4_magic) && std::memcmp(data, detail::s_stream_lz4_magic, sizeof(detail::s_stream_lz4_magic)) == 0)
+	{
+		return stream_compression_e::lz4;
+	}
+	if(size >= sizeof(detail::s_stream_gzip_magic) && std::memcmp(data, detail::s_stream_gzip_magic, sizeof(detail::s_stream_gzip_magic)) == 0)
+	{
+		return stream_compression_e::gzip;
+	}
+	return stream_compression_e::none;
+}
+
+mk::stream_compression_e mk::stream_decompressor_t::get_compression() const
+{
+	return m_compression;
+}
+
+bool mk::stream_decompressor_t::decompress(void const* const& input, std::size_t const& input_len, std::size_t* const& out_consumed, void* const& output, std::size_t const& output_len, std::size_t* const& out_produced, bool* const& out_frame_end)
+{
+	assert(m_compression != stream_compression_e::none);
+	assert(m_ctx != nullptr);
+	assert(out_consumed);
+	assert(out_produced);
+	assert(out_frame_end);
+	std::size_t& consumed = *out_consumed;
+	std::size_t& produced = *out_produced;
+	bool& frame_end = *out_frame_end;
+
+	switch(m_compression)
+	{
+		case stream_compression_e::none:
+		{
+			return false;
+		}
+		break;
+		case stream_compression_e::zstd:
+		{
+			ZSTD_inBuffer in_buffer{input, input_len, 0};
+			ZSTD_outBuffer out_buffer{output, output_len, 0};
+			std::size_t const hint = ZSTD_decompressStream(static_cast<ZSTD_DStream*>(m_ctx), &out_buffer, &in_buffer);
+			CHECK_RET_F(!ZSTD_isError(hint));
+			consumed = in_buffer.pos;
+			produced = out_buffer.pos;
+			frame_end = hint == 0;
+		}
+		break;
+		case stream_compression_e::lz4:
+		{
+			std::size_t output_len_ = output_len;
+			std::size_t input_len_ = input_len;
+			std::size_t const hint = LZ4F_decompress(static_cast<LZ4F_decompressionContext_t>(m_ctx), output, &output_len_, input, &input_len_, nullptr);
+			CHECK_RET_F(!LZ4F_isError(hint));
+			consumed = input_len_;
+			produced = output_len_;
+			frame_end = hint == 0;
+		}
+		break;
+		case stream_compression_e::gzip:
+		{
+			z_stream* const ctx = static_cast<z_stream*>(m_ctx);
+			ctx->next_in = static_cast<Bytef*>(const_cast<void*>(input));
+			ctx->avail_in = static_cast<uInt>(input_len < UINT_MAX ? input_len : UINT_MAX);
+			ctx->next_out = static_cast<Bytef*>(output);
+			ctx->avail_out = static_cast<uInt>(output_len < UINT_MAX ? output_len : UINT_MAX);
+			uInt const avail_in = ctx->avail_in;
+			uInt const avail_out = ctx->avail_out;
+			int const inflated = inflate(ctx, Z_NO_FLUSH);
+			CHECK_RET_F(inflated == Z_OK || inflated == Z_STREAM_END || inflated == Z_BUF_ERROR);
+			consumed = avail_in - ctx->avail_in;
+			produced = avail_out - ctx->avail_out;
+			frame_end = inflated == Z_STREAM_END;
+			if(frame_end)
+			{
+				// Concatenated members (pigz, cat a.gz b.gz) follow, start over for the next one.
+				int const reset = inflateReset(ctx);
+				CHECK_RET_F(reset == Z_OK);
+			}
+		}
+		break;
+	}
+
+	return true;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+
+#include <cstddef> // std::size_t
+
+
+namespace mk
+{
+
+
+	enum class stream_compression_e
+	{
+		none,
+		zstd,
+		lz4,
+		gzip,
+	};
+
+
+	class stream_decompressor_t
+	{
+	public:
+		static constexpr int const s_magic_len = 4;
+	public:
+		stream_decompressor_t() noexcept;
+		static stream_decompressor_t make(stream_compression_e const& compression);
+		stream_decompressor_t(stream_decompressor_t const&) = delete;
+		stream_decompressor_t(stream_decompressor_t&& other) noexcept;
+		stream_decompressor_t& operator=(stream_decompressor_t const&) = delete;
+		stream_decompressor_t& operator=(stream_decompressor_t&& other) noexcept;
+		~stream_decompressor_t() noexcept;
+		void swap(stream_decompressor_t& other) noexcept;
+		explicit operator bool() const;
+		void reset();
+	public:
+		static stream_compression_e detect(void const* const& data, std::size_t const& size);
+		stream_compression_e get_compression() const;
+		bool decompress(void const* const& input, std::size_t const& input_len, std::size_t* const& out_consumed, void* const& output, std::size_t const& output_len, std::size_t* const& out_produced, bool* const& out_frame_end);
+	private:
+		stream_compression_e m_compression;
+		void* m_ctx;
+	};
+
+	inline void swap(stream_decompressor_t& a, stream_decompressor_t& b) noexcept { a.swap(b); }
+
+
+}
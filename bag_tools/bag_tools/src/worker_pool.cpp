@@ -0,0 +1,100 @@
+#include "worker_pool.h"
+
+#include <cassert>
+
+
+mk::worker_pool_t::worker_pool_t(int const& threads_count, task_t const& task, void* const& task_ctx) :
+	m_task(task),
+	m_task_ctx(task_ctx),
+	m_mutex(),
+	m_job_pushed(),
+	m_job_done(),
+	m_jobs(),
+	m_jobs_begin(),
+	m_jobs_next(),
+	m_stop(false),
+	m_threads()
+{
+	assert(threads_count >= 1);
+	assert(task);
+	m_threads.reserve(threads_count);
+	for(int i = 0; i != threads_count; ++i)
+	{
+		m_threads.emplace_back([this, i](){ thread_proc(i); });
+	}
+}
+
+mk::worker_pool_t::~worker_pool_t() noexcept
+{
+	{
+		std::lock_guard<std::mutex> const lock{m_mutex};
+		m_stop = true;
+	}
+	m_job_pushed.notify_all();
+	for(std::thread& thread : m_threads)
+	{
+		thread.join();
+	}
+}
+
+
+int mk::worker_pool_t::get_threads_count() const
+{
+	return static_cast<int>(m_threads.size());
+}
+
+int mk::worker_pool_t::get_jobs_count() const
+{
+	return static_cast<int>(m_jobs.size());
+}
+
+void mk::worker_pool_t::push(void* const& job)
+{
+	{
+		std::lock_guard<std::mutex> const lock{m_mutex};
+		m_jobs.push_back(job_entry_t{job, false, false});
+	}
+	m_job_pushed.notify_one();
+}
+
+bool mk::worker_pool_t::pop(void** const& out_job)
+{
+	assert(out_job);
+	void*& job = *out_job;
+
+	std::unique_lock<std::mutex> lock{m_mutex};
+	assert(!m_jobs.empty());
+	m_job_done.wait(lock, [&](){ return m_jobs.front().m_done; });
+	job_entry_t const entry = m_jobs.front();
+	m_jobs.pop_front();
+	++m_jobs_begin;
+
+	job = entry.m_job;
+	return entry.m_succeeded;
+}
+
+
+void mk::worker_pool_t::thread_proc(int const thread_idx)
+{
+	std::unique_lock<std::mutex> lock{m_mutex};
+	for(;;)
+	{
+		m_job_pushed.wait(lock, [&](){ return m_stop || m_jobs_next != m_jobs_begin + m_jobs.size(); });
+		if(m_stop)
+		{
+			return;
+		}
+		std::uint64_t const job_idx = m_jobs_next;
+		++m_jobs_next;
+		void* const job = m_jobs[static_cast<std::size_t>(job_idx - m_jobs_begin)].m_job;
+
+		lock.unlock();
+		bool const succeeded = m_task(m_task_ctx, thread_idx, job);
+		lock.lock();
+
+		job_entry_t& entry = m_jobs[static_cast<std::size_t>(job_idx - m_jobs_begin)];
+		entry.m_done = true;
+		entry.m_succeeded = succeeded;
+		m_job_done.notify_one();
+	}
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace mk
+{
+
+
+	class worker_pool_t
+	{
+	public:
+		typedef bool(*task_t)(void* const ctx, int const thread_idx, void* const job);
+	private:
+		struct job_entry_t
+		{
+			void* m_job;
+			bool m_done;
+			bool m_succeeded;
+		};
+	public:
+		worker_pool_t(int const& threads_count, task_t const& task, void* const& task_ctx);
+		worker_pool_t(worker_pool_t const&) = delete;
+		worker_pool_t(worker_pool_t&&) = delete;
+		worker_pool_t& operator=(worker_pool_t const&) = delete;
+		worker_pool_t& operator=(worker_pool_t&&) = delete;
+		~worker_pool_t() noexcept;
+	public:
+		int get_threads_count() const;
+		int get_jobs_count() const;
+		void push(void* const& job);
+		bool pop(void** const& out_job);
+	private:
+		void thread_proc(int const thread_idx);
+	private:
+		task_t m_task;
+		void* m_task_ctx;
+		std::mutex m_mutex;
+		std::condition_variable m_job_pushed;
+		std::condition_variable m_job_done;
+		std::deque<job_entry_t> m_jobs;
+		std::uint64_t m_jobs_begin;
+		std::uint64_t m_jobs_next;
+		bool m_stop;
+		std::vector<std::thread> m_threads;
+	};
+
+
+}
@@ -0,0 +1,89 @@
+#include "write_only_file.h"
+
+#include "utils.h"
+
+#include <cassert>
+#include <utility> // std::swap
+
+
+mk::write_only_file_t::write_only_file_t() noexcept :
+	m_native_file()
+{
+}
+
+mk::write_only_file_t::write_only_file_t(native_char_t const* const& file_path) :
+	m_native_file(file_path)
+{
+}
+
+mk::write_only_file_t::write_only_file_t(native_char_t const* const& file_path, bool const& direct) :
+	m_native_file(file_path, direct)
+{
+}
+
+mk::write_only_file_t::write_only_file_t(write_only_file_t&& other) noexcept :
+	write_only_file_t()
+{
+	swap(other);
+}
+
+mk::write_only_file_t& mk::write_only_file_t::operator=(write_only_file_t&& other) noexcept
+{
+	swap(other);
+	return *this;
+}
+
+mk::write_only_file_t::~write_only_file_t() noexcept
+{
+}
+
+void mk::write_only_file_t::swap(write_only_file_t& other) noexcept
+{
+	using std::swap;
+	swap(m_native_file, other.m_native_file);
+}
+
+mk::write_only_file_t::operator bool() const
+{
+	return m_native_file.operator bool();
+}
+
+void mk::write_only_file_t::reset()
+{
+	*this = write_only_file_t{};
+}
+
+bool mk::write_only_file_t::preallocate(std::uint64_t const& size)
+{
+	return m_native_file.preallocate(size);
+}
+
+bool mk::write_only_file_t::truncate(std::uint64_t const& size)
+{
+	return m_native_file.truncate(size);
+}
+
+bool mk::write_only_file_t::start_writeback(std::uint64_t const& offset, std::uint64_t const& size)
+{
+	return m_native_file.start_writeback(offset, size);
+}
+
+bool mk::write_only_file_t::drop(std::uint64_t const& offset, std::uint64_t const& size)
+{
+	return m_native_file.drop(offset, size);
+}
+
+bool mk::write_only_file_t::write_at(std::uint64_t const& offset, void const* const& data, std::size_t const& size)
+{
+	return m_native_file.write_at(offset, data, size);
+}
+
+bool mk::write_only_file_t::write_at(std::uint64_t const& offset, write_only_file_buffer_t const* const& buffers, int const& buffers_count)
+{
+	return m_native_file.write_at(offset, buffers, buffers_count);
+}
+
+bool mk::write_only_file_t::copy_at(std::uint64_t const& offset, read_only_memory_mapped_file_t const& source, std::uint64_t const& source_offset, std::size_t const& size)
+{
+	return m_native_file.copy_at(offset, source.get_native(), source_offset, size);
+}
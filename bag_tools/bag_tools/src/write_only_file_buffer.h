@@ -0,0 +1,18 @@
+#pragma once
+
+
+#include <cstddef> // std::size_t
+
+
+namespace mk
+{
+
+
+	struct write_only_file_buffer_t
+	{
+		void const* m_data;
+		std::size_t m_size;
+	};
+
+
+}
@@ -0,0 +1,233 @@
+// 64 bit off_t and file offsets on 32 bit Linux too, bags are way over 2 GiB. Has to come before any system header.
+#if !defined(_MSC_VER) && !defined(_FILE_OFFSET_BITS)
+	#define _FILE_OFFSET_BITS 64
+#endif
+
+#include "write_only_file_linux.h"
+
+#include "utils.h"
+
+#include <cassert>
+#include <algorithm> // std::min
+#include <cerrno> // errno, EINTR, EOPNOTSUPP, EXDEV, ENOSYS, EINVAL
+#include <utility> // std::swap
+
+// open, O_DIRECT, fallocate, sync_file_range, posix_fadvise
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+#include <unistd.h> // close, pwrite, ftruncate, copy_file_range
+#include <sys/uio.h> // pwritev, iovec
+#include <climits> // IOV_MAX
+
+static_assert(sizeof(off_t) == sizeof(std::uint64_t));
+
+
+static constexpr int const s_write_only_file_invalid_fd = -1;
+
+
+mk::write_only_file_linux_t::write_only_file_linux_t() noexcept :
+	m_fd(s_write_only_file_invalid_fd)
+{
+}
+
+mk::write_only_file_linux_t::write_only_file_linux_t(char const* const& file_path) :
+	write_only_file_linux_t(file_path, false)
+{
+}
+
+mk::write_only_file_linux_t::write_only_file_linux_t(char const* const& file_path, bool const& direct) :
+	write_only_file_linux_t()
+{
+	int fd = open(file_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC | (direct ? O_DIRECT : 0), 0644);
+	if(fd == s_write_only_file_invalid_fd && direct && errno == EINVAL)
+	{
+		// File system does not do direct I/O (tmpfs for example), go through page cache after all.
+		fd = open(file_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	}
+	if(!(fd != s_write_only_file_invalid_fd))
+	{
+		return;
+	}
+	assert(fd >= 0);
+	m_fd = fd;
+}
+
+mk::write_only_file_linux_t::write_only_file_linux_t(write_only_file_linux_t&& other) noexcept :
+	write_only_file_linux_t()
+{
+	swap(other);
+}
+
+mk::write_only_file_linux_t& mk::write_only_file_linux_t::operator=(write_only_file_linux_t&& other) noexcept
+{
+	swap(other);
+	return *this;
+}
+
+mk::write_only_file_linux_t::~write_only_file_linux_t() noexcept
+{
+	if(m_fd != s_write_only_file_invalid_fd)
+	{
+		int const closed = close(m_fd);
+		CHECK_RET_V(closed == 0);
+	}
+}
+
+void mk::write_only_file_linux_t::swap(write_only_file_linux_t& other) noexcept
+{
+	using std::swap;
+	swap(m_fd, other.m_fd);
+}
+
+mk::write_only_file_linux_t::operator bool() const
+{
+	return m_fd != s_write_only_file_invalid_fd;
+}
+
+void mk::write_only_file_linux_t::reset()
+{
+	*this = write_only_file_linux_t{};
+}
+
+bool mk::write_only_file_linux_t::preallocate(std::uint64_t const& size)
+{
+	assert(m_fd != s_write_only_file_invalid_fd);
+
+	int const allocated = fallocate(m_fd, 0, 0, static_cast<off_t>(size));
+	if(allocated == 0)
+	{
+		return true;
+	}
+	CHECK_RET_F(errno == EOPNOTSUPP);
+	int const truncated = ftruncate(m_fd, static_cast<off_t>(size));
+	CHECK_RET_F(truncated == 0);
+
+	return true;
+}
+
+bool mk::write_only_file_linux_t::truncate(std::uint64_t const& size)
+{
+	assert(m_fd != s_write_only_file_invalid_fd);
+
+	int const truncated = ftruncate(m_fd, static_cast<off_t>(size));
+	CHECK_RET_F(truncated == 0);
+
+	return true;
+}
+
+bool mk::write_only_file_linux_t::start_writeback(std::uint64_t const& offset, std::uint64_t const& size)
+{
+	assert(m_fd != s_write_only_file_invalid_fd);
+
+	int const synced = sync_file_range(m_fd, static_cast<off_t>(offset), static_cast<off_t>(size), SYNC_FILE_RANGE_WRITE);
+	CHECK_RET_F(synced == 0);
+
+	return true;
+}
+
+bool mk::write_only_file_linux_t::drop(std::uint64_t const& offset, std::uint64_t const& size)
+{
+	assert(m_fd != s_write_only_file_invalid_fd);
+
+	// Dirty pages can not be dropped, wait for their writeback first.
+	int const synced = sync_file_range(m_fd, static_cast<off_t>(offset), static_cast<off_t>(size), SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+	CHECK_RET_F(synced == 0);
+	int const fadvised = posix_fadvise(m_fd, static_cast<off_t>(offset), static_cast<off_t>(size), POSIX_FADV_DONTNEED);
+	CHECK_RET_F(fadvised == 0);
+
+	return true;
+}
+
+bool mk::write_only_file_linux_t::write_at(std::uint64_t const& offset, void const* const& data, std::size_t const& size)
+{
+	assert(m_fd != s_write_only_file_invalid_fd);
+
+	std::size_t written_total = 0;
+	while(written_total != size)
+	{
+		ssize_t const written = pwrite(m_fd, static_cast<unsigned char const*>(data) + written_total, size - written_total, static_cast<off_t>(offset + written_total));
+		if(written == -1 && errno == EINTR)
+		{
+			continue;
+		}
+		CHECK_RET_F(written > 0);
+		written_total += static_cast<std::size_t>(written);
+	}
+
+	return true;
+}
+
+bool mk::write_only_file_linux_t::write_at(std::uint64_t const& offset, write_only_file_buffer_t const* const& buffers, int const& buffers_count)
+{
+	static constexpr int const s_max_iovecs_count = IOV_MAX < 1024 ? IOV_MAX : 1024;
+
+	assert(m_fd != s_write_only_file_invalid_fd);
+	assert(buffers || buffers_count == 0);
+
+	iovec iovecs[s_max_iovecs_count];
+	std::uint64_t position = offset;
+	int buffer_idx = 0;
+	std::size_t buffer_offset = 0;
+	while(buffer_idx != buffers_count)
+	{
+		int const iovecs_count = std::min(buffers_count - buffer_idx, s_max_iovecs_count);
+		for(int i = 0; i != iovecs_count; ++i)
+		{
+			write_only_file_buffer_t const& buffer = buffers[buffer_idx + i];
+			std::size_t const skip = i == 0 ? buffer_offset : 0;
+			iovecs[i].iov_base = const_cast<unsigned char*>(static_cast<unsigned char const*>(buffer.m_data) + skip);
+			iovecs[i].iov_len = buffer.m_size - skip;
+		}
+		ssize_t const written = pwritev(m_fd, iovecs, iovecs_count, static_cast<off_t>(position));
+		if(written == -1 && errno == EINTR)
+		{
+			continue;
+		}
+		CHECK_RET_F(written > 0);
+		position += static_cast<std::uint64_t>(written);
+
+		// Short write, resume in the middle of whichever buffer the kernel stopped at.
+		std::size_t remaining = static_cast<std::size_t>(written);
+		while(buffer_idx != buffers_count && remaining >= buffers[buffer_idx].m_size - buffer_offset)
+		{
+			remaining -= buffers[buffer_idx].m_size - buffer_offset;
+			buffer_offset = 0;
+			++buffer_idx;
+		}
+		buffer_offset += remaining;
+	}
+
+	return true;
+}
+
+bool mk::write_only_file_linux_t::copy_at(std::uint64_t const& offset, read_only_memory_mapped_file_linux_t const& source, std::uint64_t const& source_offset, std::size_t const& size)
+{
+	assert(m_fd != s_write_only_file_invalid_fd);
+	assert(source);
+	assert(source_offset + size <= source.get_size());
+
+	std::size_t copied_total = 0;
+	while(copied_total != size)
+	{
+		off_t source_position = static_cast<off_t>(source_offset + copied_total);
+		off_t position = static_cast<off_t>(offset + copied_total);
+		ssize_t const copied = copy_file_range(source.get_fd(), &source_position, m_fd, &position, size - copied_total, 0);
+		if(copied == -1 && errno == EINTR)
+		{
+			continue;
+		}
+		if(copied == -1 && (errno == EXDEV || errno == ENOSYS || errno == EINVAL || errno == EOPNOTSUPP))
+		{
+			// Kernel or file system can not do it, copy the rest from the mapping instead.
+			bool const written = write_at(offset + copied_total, static_cast<unsigned char const*>(source.get_data()) + source_offset + copied_total, size - copied_total);
+			CHECK_RET_F(written);
+			return true;
+		}
+		CHECK_RET_F(copied > 0);
+		copied_total += static_cast<std::size_t>(copied);
+	}
+
+	return true;
+}
@@ -0,0 +1,203 @@
+#include "write_only_file_windows.h"
+
+#include "raw_buffer.h"
+#include "utils.h"
+
+#include <algorithm> // std::min
+#include <cassert>
+#include <cstring> // std::memcpy
+#include <utility> // std::swap
+
+#include <windows.h>
+
+
+static HANDLE const s_write_only_file_invalid_file = INVALID_HANDLE_VALUE;
+static constexpr std::size_t const s_write_only_file_staging_size = 4 * 1024 * 1024;
+
+
+mk::write_only_file_windows_t::write_only_file_windows_t() noexcept :
+	m_file(s_write_only_file_invalid_file)
+{
+}
+
+mk::write_only_file_windows_t::write_only_file_windows_t(wchar_t const* const& file_path) :
+	write_only_file_windows_t(file_path, false)
+{
+}
+
+mk::write_only_file_windows_t::write_only_file_windows_t(wchar_t const* const& file_path, bool const& direct) :
+	write_only_file_windows_t()
+{
+	DWORD const flags = direct ? (FILE_FLAG_NO_BUFFERING | FILE_FLAG_WRITE_THROUGH) : FILE_ATTRIBUTE_NORMAL;
+	HANDLE const file = CreateFileW(file_path, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, flags, nullptr);
+	if(!(file != INVALID_HANDLE_VALUE))
+	{
+		return;
+	}
+	m_file = file;
+}
+
+mk::write_only_file_windows_t::write_only_file_windows_t(write_only_file_windows_t&& other) noexcept :
+	write_only_file_windows_t()
+{
+	swap(other);
+}
+
+mk::write_only_file_windows_t& mk::write_only_file_windows_t::operator=(write_only_file_windows_t&& other) noexcept
+{
+	swap(other);
+	return *this;
+}
+
+mk::write_only_file_windows_t::~write_only_file_windows_t() noexcept
+{
+	if(m_file != s_write_only_file_invalid_file)
+	{
+		BOOL const closed = CloseHandle(m_file);
+		CHECK_RET_V(closed != 0);
+	}
+}
+
+void mk::write_only_file_windows_t::swap(write_only_file_windows_t& other) noexcept
+{
+	using std::swap;
+	swap(m_file, other.m_file);
+}
+
+mk::write_only_file_windows_t::operator bool() const
+{
+	return m_file != s_write_only_file_invalid_file;
+}
+
+void mk::write_only_file_windows_t::reset()
+{
+	*this = write_only_file_windows_t{};
+}
+
+bool mk::write_only_file_windows_t::preallocate(std::uint64_t const& size)
+{
+	assert(m_file != s_write_only_file_invalid_file);
+
+	FILE_ALLOCATION_INFO allocation_info;
+	allocation_info.AllocationSize.QuadPart = static_cast<LONGLONG>(size);
+	BOOL const allocated = SetFileInformationByHandle(m_file, FileAllocationInfo, &allocation_info, sizeof(allocation_info));
+	CHECK_RET_F(allocated != 0);
+
+	FILE_END_OF_FILE_INFO end_of_file_info;
+	end_of_file_info.EndOfFile.QuadPart = static_cast<LONGLONG>(size);
+	BOOL const resized = SetFileInformationByHandle(m_file, FileEndOfFileInfo, &end_of_file_info, sizeof(end_of_file_info));
+	CHECK_RET_F(resized != 0);
+
+	return true;
+}
+
+bool mk::write_only_file_windows_t::truncate(std::uint64_t const& size)
+{
+	assert(m_file != s_write_only_file_invalid_file);
+
+	FILE_END_OF_FILE_INFO end_of_file_info;
+	end_of_file_info.EndOfFile.QuadPart = static_cast<LONGLONG>(size);
+	BOOL const resized = SetFileInformationByHandle(m_file, FileEndOfFileInfo, &end_of_file_info, sizeof(end_of_file_info));
+	CHECK_RET_F(resized != 0);
+
+	return true;
+}
+
+bool mk::write_only_file_windows_t::start_writeback([[maybe_unused]] std::uint64_t const& offset, [[maybe_unused]] std::uint64_t const& size)
+{
+	assert(m_file != s_write_only_file_invalid_file);
+
+	// The lazy writer flushes on its own, there is no per range hint.
+	return true;
+}
+
+bool mk::write_only_file_windows_t::drop([[maybe_unused]] std::uint64_t const& offset, [[maybe_unused]] std::uint64_t const& size)
+{
+	assert(m_file != s_write_only_file_invalid_file);
+
+	// System cache can not be trimmed per file range, leave it to the memory manager.
+	return true;
+}
+
+bool mk::write_only_file_windows_t::write_at(std::uint64_t const& offset, void const* const& data, std::size_t const& size)
+{
+	static constexpr std::size_t const s_max_write_size = 1 * 1024 * 1024 * 1024;
+
+	assert(m_file != s_write_only_file_invalid_file);
+
+	std::size_t written_total = 0;
+	while(written_total != size)
+	{
+		std::uint64_t const position = offset + written_total;
+		std::size_t const remaining = size - written_total;
+		DWORD const to_write = static_cast<DWORD>(remaining < s_max_write_size ? remaining : s_max_write_size);
+		OVERLAPPED overlapped{};
+		overlapped.Offset = static_cast<DWORD>((position >> (0 * 32)) & 0xFFFFFFFFull);
+		overlapped.OffsetHigh = static_cast<DWORD>((position >> (1 * 32)) & 0xFFFFFFFFull);
+		DWORD written;
+		BOOL const wrote = WriteFile(m_file, static_cast<unsigned char const*>(data) + written_total, to_write, &written, &overlapped);
+		CHECK_RET_F(wrote != 0 && written != 0);
+		written_total += written;
+	}
+
+	return true;
+}
+
+bool mk::write_only_file_windows_t::write_at(std::uint64_t const& offset, write_only_file_buffer_t const* const& buffers, int const& buffers_count)
+{
+	assert(m_file != s_write_only_file_invalid_file);
+	assert(buffers || buffers_count == 0);
+
+	// WriteFileGather wants page sized and page aligned buffers, packets are neither. They are copied one after another into staging buffer, which is written each time it fills up.
+	// Threads of --pwrite write into one file at once, each of them has staging buffer of its own.
+	thread_local mk::raw_buffer_t t_staging;
+	if(t_staging.get_capacity() < s_write_only_file_staging_size)
+	{
+		bool const reserved = t_staging.reserve(s_write_only_file_staging_size);
+		CHECK_RET_F(reserved);
+	}
+	unsigned char* const staging = t_staging.get_data();
+
+	std::uint64_t position = offset;
+	std::size_t staged = 0;
+	for(int i = 0; i != buffers_count; ++i)
+	{
+		unsigned char const* data = static_cast<unsigned char const*>(buffers[i].m_data);
+		std::size_t remaining = buffers[i].m_size;
+		while(remaining != 0)
+		{
+			std::size_t const amount = std::min(remaining, s_write_only_file_staging_size - staged);
+			std::memcpy(staging + staged, data, amount);
+			staged += amount;
+			data += amount;
+			remaining -= amount;
+			if(staged == s_write_only_file_staging_size)
+			{
+				bool const written = write_at(position, staging, staged);
+				CHECK_RET_F(written);
+				position += staged;
+				staged = 0;
+			}
+		}
+	}
+	if(staged != 0)
+	{
+		bool const written = write_at(position, staging, staged);
+		CHECK_RET_F(written);
+	}
+
+	return true;
+}
+
+bool mk::write_only_file_windows_t::copy_at(std::uint64_t const& offset, read_only_memory_mapped_file_windows_t const& source, std::uint64_t const& source_offset, std::size_t const& size)
+{
+	assert(m_file != s_write_only_file_invalid_file);
+	assert(source);
+	assert(source_offset + size <= source.get_size());
+
+	// There is no copy_file_range counterpart for arbitrary ranges, write from the mapping.
+	bool const written = write_at(offset, static_cast<unsigned char const*>(source.get_data()) + source_offset, size);
+	CHECK_RET_F(written);
+
+	return true;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+
+#include "read_only_memory_mapped_file_windows.h"
+#include "write_only_file_buffer.h"
+
+#include <cstddef> // std::size_t
+#include <cstdint> // std::uint64_t
+
+
+namespace mk
+{
+
+
+	class write_only_file_windows_t
+	{
+	public:
+		write_only_file_windows_t() noexcept;
+		explicit write_only_file_windows_t(wchar_t const* const& file_path);
+		write_only_file_windows_t(wchar_t const* const& file_path, bool const& direct);
+		write_only_file_windows_t(write_only_file_windows_t const&) = delete;
+		write_only_file_windows_t(write_only_file_windows_t&& other) noexcept;
+		write_only_file_windows_t& operator=(write_only_file_windows_t const&) = delete;
+		write_only_file_windows_t& operator=(write_only_file_windows_t&& other) noexcept;
+		~write_only_file_windows_t() noexcept;
+		void swap(write_only_file_windows_t& other) noexcept;
+		explicit operator bool() const;
+		void reset();
+	public:
+		bool preallocate(std::uint64_t const& size);
+		bool truncate(std::uint64_t const& size);
+		bool start_writeback(std::uint64_t const& offset, std::uint64_t const& size);
+		bool drop(std::uint64_t const& offset, std::uint64_t const& size);
+		bool write_at(std::uint64_t const& offset, void const* const& data, std::size_t const& size);
+		bool write_at(std::uint64_t const& offset, write_only_file_buffer_t const* const& buffers, int const& buffers_count);
+		bool copy_at(std::uint64_t const& offset, read_only_memory_mapped_file_windows_t const& source, std::uint64_t const& source_offset, std::size_t const& size);
+	private:
+		void* m_file;
+	};
+
+	inline void swap(write_only_file_windows_t& a, write_only_file_windows_t& b) noexcept { a.swap(b); }
+
+	typedef write_only_file_windows_t write_only_file_native_t;
+
+
+}
@@ -1,7 +1,13 @@
 CALL "c:\Program Files\Microsoft Visual Studio\2019\BuildTools\VC\Auxiliary\Build\vcvars32.bat"
 
 SET "INCLUDE=%INCLUDE%;%~dp0..\..\..\..\lz4-1.9.3\lib"
+SET "INCLUDE=%INCLUDE%;%~dp0..\..\..\..\bzip2-1.0.8"
+SET "INCLUDE=%INCLUDE%;%~dp0..\..\..\..\zlib-1.2.11"
+SET "INCLUDE=%INCLUDE%;%~dp0..\..\..\..\zstd-1.5.0\lib"
 SET "LIB=%LIB%;%~dp0..\..\..\..\lz4-1.9.3\build\VS2019\bin\Win32_Release"
+SET "LIB=%LIB%;%~dp0..\..\..\..\bzip2-1.0.8\build\Win32_Release"
+SET "LIB=%LIB%;%~dp0..\..\..\..\zlib-1.2.11\build\Win32_Release"
+SET "LIB=%LIB%;%~dp0..\..\..\..\zstd-1.5.0\build\VS2010\bin\Win32_Release"
 SET UseEnv=true
 
 cd "%~dp0"